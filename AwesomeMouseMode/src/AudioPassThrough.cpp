@@ -0,0 +1,234 @@
+#include "AudioPassThrough.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AMM_PASS_THROUGH_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+
+// SSE2 is part of x64 and what 32-bit builds target anyway, so it needs no check. AVX is picked at
+// runtime; MSVC compiles its intrinsics anywhere, GCC and Clang need the function marked for it.
+#if AMM_PASS_THROUGH_X86 && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define AMM_PASS_THROUGH_SSE2 1
+#if defined(_MSC_VER)
+#define AMM_TARGET_AVX
+#else
+#define AMM_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+
+namespace amm {
+
+namespace {
+
+template <typename T>
+struct SampleTraits;
+template <>
+struct SampleTraits<float> {
+	static constexpr float kMin = FLT_MIN;
+};
+template <>
+struct SampleTraits<double> {
+	static constexpr double kMin = DBL_MIN;
+};
+
+template <typename T>
+inline T FlushDenormal(T sample) {
+	// NaN fails the comparison too, so it doesn't get passed on either.
+	return std::fabs(sample) >= SampleTraits<T>::kMin ? sample : T(0);
+}
+
+template <typename T>
+void CopyScalar(const T* in, T* out, int frames) {
+	for (int i = 0; i < frames; ++i) {
+		out[i] = FlushDenormal(in[i]);
+	}
+}
+
+// Frames to handle one at a time before out is aligned to bytes.
+template <typename T>
+inline int HeadFrames(const T* out, int frames, uintptr_t bytes) {
+	uintptr_t misalignment = (uintptr_t) out & (bytes - 1);
+	int head = misalignment ? (int) ((bytes - misalignment) / sizeof(T)) : 0;
+	if ((uintptr_t) out % sizeof(T) != 0 || head > frames) {
+		return frames;
+	}
+	return head;
+}
+
+#if AMM_PASS_THROUGH_SSE2
+
+void CopySse2(const float* in, float* out, int frames) {
+	int i = HeadFrames(out, frames, 16);
+	CopyScalar(in, out, i);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 minimum = _mm_set1_ps(FLT_MIN);
+	for (; i + 8 <= frames; i += 8) {
+		__m128 a = _mm_loadu_ps(in + i);
+		__m128 b = _mm_loadu_ps(in + i + 4);
+		a = _mm_and_ps(a, _mm_cmpge_ps(_mm_andnot_ps(signMask, a), minimum));
+		b = _mm_and_ps(b, _mm_cmpge_ps(_mm_andnot_ps(signMask, b), minimum));
+		_mm_store_ps(out + i, a);
+		_mm_store_ps(out + i + 4, b);
+	}
+	CopyScalar(in + i, out + i, frames - i);
+}
+
+void CopySse2(const double* in, double* out, int frames) {
+	int i = HeadFrames(out, frames, 16);
+	CopyScalar(in, out, i);
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	const __m128d minimum = _mm_set1_pd(DBL_MIN);
+	for (; i + 4 <= frames; i += 4) {
+		__m128d a = _mm_loadu_pd(in + i);
+		__m128d b = _mm_loadu_pd(in + i + 2);
+		a = _mm_and_pd(a, _mm_cmpge_pd(_mm_andnot_pd(signMask, a), minimum));
+		b = _mm_and_pd(b, _mm_cmpge_pd(_mm_andnot_pd(signMask, b), minimum));
+		_mm_store_pd(out + i, a);
+		_mm_store_pd(out + i + 2, b);
+	}
+	CopyScalar(in + i, out + i, frames - i);
+}
+
+AMM_TARGET_AVX void CopyAvx(const float* in, float* out, int frames) {
+	int i = HeadFrames(out, frames, 32);
+	CopyScalar(in, out, i);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	const __m256 minimum = _mm256_set1_ps(FLT_MIN);
+	for (; i + 16 <= frames; i += 16) {
+		__m256 a = _mm256_loadu_ps(in + i);
+		__m256 b = _mm256_loadu_ps(in + i + 8);
+		a = _mm256_and_ps(a, _mm256_cmp_ps(_mm256_andnot_ps(signMask, a), minimum, _CMP_GE_OQ));
+		b = _mm256_and_ps(b, _mm256_cmp_ps(_mm256_andnot_ps(signMask, b), minimum, _CMP_GE_OQ));
+		_mm256_store_ps(out + i, a);
+		_mm256_store_ps(out + i + 8, b);
+	}
+	// Avoid the AVX-SSE transition penalty in whatever the host runs next.
+	_mm256_zeroupper();
+	CopyScalar(in + i, out + i, frames - i);
+}
+
+AMM_TARGET_AVX void CopyAvx(const double* in, double* out, int frames) {
+	int i = HeadFrames(out, frames, 32);
+	CopyScalar(in, out, i);
+	const __m256d signMask = _mm256_set1_pd(-0.0);
+	const __m256d minimum = _mm256_set1_pd(DBL_MIN);
+	for (; i + 8 <= frames; i += 8) {
+		__m256d a = _mm256_loadu_pd(in + i);
+		__m256d b = _mm256_loadu_pd(in + i + 4);
+		a = _mm256_and_pd(a, _mm256_cmp_pd(_mm256_andnot_pd(signMask, a), minimum, _CMP_GE_OQ));
+		b = _mm256_and_pd(b, _mm256_cmp_pd(_mm256_andnot_pd(signMask, b), minimum, _CMP_GE_OQ));
+		_mm256_store_pd(out + i, a);
+		_mm256_store_pd(out + i + 4, b);
+	}
+	_mm256_zeroupper();
+	CopyScalar(in + i, out + i, frames - i);
+}
+
+bool CpuHasAvx() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	// AVX, and the OS saving the YMM registers (OSXSAVE, then XCR0 bits 1 and 2).
+	if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 27)) == 0) {
+		return false;
+	}
+	return (_xgetbv(0) & 0x6) == 0x6;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif
+
+template <typename T>
+void Copy(PassThroughKernel kernel, const T* in, T* out, int frames) {
+	switch (kernel) {
+#if AMM_PASS_THROUGH_SSE2
+	case PassThroughKernel::kAvx:
+		CopyAvx(in, out, frames);
+		break;
+	case PassThroughKernel::kSse2:
+		CopySse2(in, out, frames);
+		break;
+#endif
+	default:
+		CopyScalar(in, out, frames);
+		break;
+	}
+}
+
+template <typename T>
+void PassThroughChannels(PassThroughKernel kernel, const T* const* inputs, T* const* outputs, int channels, int frames) {
+	if (frames <= 0) {
+		return;
+	}
+	for (int c = 0; c < channels; ++c) {
+		const T* in = inputs ? inputs[c] : nullptr;
+		T* out = outputs[c];
+		if (!out) {
+			continue;
+		}
+		if (!in) {
+			::memset(out, 0, sizeof(T) * frames);
+			continue;
+		}
+		Copy(kernel, in, out, frames);
+	}
+}
+
+PassThroughKernel DetectKernel() {
+#if AMM_PASS_THROUGH_SSE2
+	return CpuHasAvx() ? PassThroughKernel::kAvx : PassThroughKernel::kSse2;
+#else
+	return PassThroughKernel::kScalar;
+#endif
+}
+
+} // namespace
+
+PassThroughKernel BestPassThroughKernel() {
+	static const PassThroughKernel kernel = DetectKernel();
+	return kernel;
+}
+
+bool PassThroughKernelSupported(PassThroughKernel kernel) {
+	return kernel >= PassThroughKernel::kScalar && kernel <= BestPassThroughKernel();
+}
+
+const char* PassThroughKernelName(PassThroughKernel kernel) {
+	switch (kernel) {
+	case PassThroughKernel::kScalar: return "scalar";
+	case PassThroughKernel::kSse2: return "sse2";
+	case PassThroughKernel::kAvx: return "avx";
+	default: return "?";
+	}
+}
+
+void PassThrough(const float* const* inputs, float* const* outputs, int channels, int frames) {
+	PassThroughChannels(BestPassThroughKernel(), inputs, outputs, channels, frames);
+}
+
+void PassThrough(const double* const* inputs, double* const* outputs, int channels, int frames) {
+	PassThroughChannels(BestPassThroughKernel(), inputs, outputs, channels, frames);
+}
+
+void PassThroughWith(PassThroughKernel kernel, const float* const* inputs, float* const* outputs, int channels, int frames) {
+	PassThroughChannels(kernel, inputs, outputs, channels, frames);
+}
+
+void PassThroughWith(PassThroughKernel kernel, const double* const* inputs, double* const* outputs, int channels, int frames) {
+	PassThroughChannels(kernel, inputs, outputs, channels, frames);
+}
+
+} // namespace amm
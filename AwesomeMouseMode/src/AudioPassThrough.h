@@ -0,0 +1,28 @@
+#pragma once
+
+namespace amm {
+
+// The audio side of the plugin, which only exists to keep the hook loaded: hands its input back
+// untouched. Each channel is copied with the widest vector unit the CPU has, flushing denormals to
+// zero on the way so nothing downstream slows down on them; buffers the host processes in place are
+// flushed where they are. A missing input is treated as silence.
+enum class PassThroughKernel {
+	kScalar,
+	kSse2,
+	kAvx,
+	kCount,
+};
+
+// The fastest kernel this CPU supports, decided once.
+PassThroughKernel BestPassThroughKernel();
+bool PassThroughKernelSupported(PassThroughKernel kernel);
+const char* PassThroughKernelName(PassThroughKernel kernel);
+
+void PassThrough(const float* const* inputs, float* const* outputs, int channels, int frames);
+void PassThrough(const double* const* inputs, double* const* outputs, int channels, int frames);
+
+// The same with a particular kernel, for benchmarks. The kernel must be supported.
+void PassThroughWith(PassThroughKernel kernel, const float* const* inputs, float* const* outputs, int channels, int frames);
+void PassThroughWith(PassThroughKernel kernel, const double* const* inputs, double* const* outputs, int channels, int frames);
+
+} // namespace amm
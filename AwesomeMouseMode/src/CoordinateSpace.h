@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace amm {
+
+// Where a hooked window is, as far as converting coordinates goes. Filled in from user32 by the
+// hook; see CoordinateSpace.
+struct WindowGeometry {
+	POINT clientOrigin;  // Client (0, 0) in screen coordinates.
+	bool mirrored;       // WS_EX_LAYOUTRTL: client x runs right to left from clientOrigin.
+	int dpi;             // The DPI the window works in: 96 or the system's if Windows scales it for us.
+	int monitorDpi;      // The DPI of the monitor it is on.
+	RECT monitor;        // That monitor's bounds, in screen coordinates.
+};
+
+// A window's client origin, DPI scale and monitor, cached so that converting between its client
+// space, screen space and the monitor's physical pixels is a few integer operations rather than a
+// system call each. The hook invalidates it when the window (or the window it sits in) moves,
+// resizes or changes DPI, and refills it on next use.
+//
+// Screen and client coordinates are the window's own, which Windows scales for windows that
+// aren't per-monitor DPI aware. Physical coordinates are the monitor's pixels, scaled from the
+// monitor's top-left corner, which is where Windows anchors the two. Converting between them picks
+// the coarser space's pixel holding the point, so a round trip from the coarser space lands back
+// where it started, and one from the finer space within a coarse pixel of it.
+class CoordinateSpace {
+public:
+	// Safe from any thread. The rest is for the thread that uses the conversions.
+	void Invalidate() { generation_.fetch_add(1, std::memory_order_acq_rel); }
+
+	bool Valid() const { return updatedGeneration_ == generation_.load(std::memory_order_acquire); }
+
+	// Take Generation() before querying the geometry and pass it to Update, so an invalidation that
+	// lands in between isn't lost.
+	uint32_t Generation() const { return generation_.load(std::memory_order_acquire); }
+	void Update(const WindowGeometry& geometry, uint32_t generation) {
+		geometry_ = geometry;
+		if (geometry_.dpi <= 0) {
+			geometry_.dpi = 96;
+		}
+		if (geometry_.monitorDpi <= 0) {
+			geometry_.monitorDpi = geometry_.dpi;
+		}
+		updatedGeneration_ = generation;
+	}
+
+	const WindowGeometry& Geometry() const { return geometry_; }
+
+	POINT ClientToScreen(POINT client) const {
+		POINT screen = {
+			geometry_.mirrored ? geometry_.clientOrigin.x - client.x : geometry_.clientOrigin.x + client.x,
+			geometry_.clientOrigin.y + client.y,
+		};
+		return screen;
+	}
+
+	POINT ScreenToClient(POINT screen) const {
+		POINT client = {
+			geometry_.mirrored ? geometry_.clientOrigin.x - screen.x : screen.x - geometry_.clientOrigin.x,
+			screen.y - geometry_.clientOrigin.y,
+		};
+		return client;
+	}
+
+	POINT PhysicalToScreen(POINT physical) const {
+		POINT screen = {
+			Scale(physical.x, geometry_.monitor.left, geometry_.dpi, geometry_.monitorDpi),
+			Scale(physical.y, geometry_.monitor.top, geometry_.dpi, geometry_.monitorDpi),
+		};
+		return screen;
+	}
+
+	POINT ScreenToPhysical(POINT screen) const {
+		POINT physical = {
+			Scale(screen.x, geometry_.monitor.left, geometry_.monitorDpi, geometry_.dpi),
+			Scale(screen.y, geometry_.monitor.top, geometry_.monitorDpi, geometry_.dpi),
+		};
+		return physical;
+	}
+
+	POINT PhysicalToClient(POINT physical) const { return ScreenToClient(PhysicalToScreen(physical)); }
+	POINT ClientToPhysical(POINT client) const { return ScreenToPhysical(ClientToScreen(client)); }
+
+	// Keeps a cursor warp on the window's own monitor, so it can't land on a neighbour at another
+	// scale.
+	POINT ClampToMonitor(POINT screen) const {
+		const RECT& monitor = geometry_.monitor;
+		if (monitor.right <= monitor.left || monitor.bottom <= monitor.top) {
+			return screen;
+		}
+		POINT clamped = {
+			screen.x < monitor.left ? monitor.left : (screen.x >= monitor.right ? monitor.right - 1 : screen.x),
+			screen.y < monitor.top ? monitor.top : (screen.y >= monitor.bottom ? monitor.bottom - 1 : screen.y),
+		};
+		return clamped;
+	}
+
+private:
+	// Scales value's distance from origin by to / from. Going to the coarser space rounds down, to
+	// the pixel holding the point; going to the finer one rounds up, to the first pixel inside it.
+	static LONG Scale(LONG value, LONG origin, int to, int from) {
+		if (to == from) {
+			return value;
+		}
+		int64_t scaled = (int64_t) (value - origin) * to;
+		int64_t quotient = scaled / from;
+		int64_t remainder = scaled % from;
+		if (remainder != 0 && ((remainder < 0) == (to < from))) {
+			quotient += to < from ? -1 : 1;
+		}
+		return (LONG) (origin + quotient);
+	}
+
+	WindowGeometry geometry_ = {};
+	uint32_t updatedGeneration_ = 0;
+	std::atomic<uint32_t> generation_{ 1 };
+};
+
+} // namespace amm
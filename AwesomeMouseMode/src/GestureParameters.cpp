@@ -0,0 +1,112 @@
+#include "GestureParameters.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace amm {
+
+namespace {
+
+struct ParameterInfo {
+	const char* name;
+	const char* label;
+	float maximum;
+	float initial;  // In its own units.
+};
+
+const ParameterInfo kParameters[kGestureParameters] = {
+	{ "PanSpeed", "px/s", kMaxPanSpeed, 0.0f },
+	{ "Pinch", "x", kMaxPinchScale, 1.0f },
+	{ "Pressure", "", 1.0f, 0.0f },
+	{ "Scroll", "/s", kMaxScrollRate, 0.0f },
+};
+
+} // namespace
+
+GestureParameterBridge gGestureParameters;
+
+const char* GestureParameterName(GestureParameter parameter) {
+	return kParameters[(int) parameter].name;
+}
+
+const char* GestureParameterLabel(GestureParameter parameter) {
+	return kParameters[(int) parameter].label;
+}
+
+float NormalizeGestureParameter(GestureParameter parameter, float value) {
+	return std::max(0.0f, std::min(value / kParameters[(int) parameter].maximum, 1.0f));
+}
+
+float DenormalizeGestureParameter(GestureParameter parameter, float normalized) {
+	return normalized * kParameters[(int) parameter].maximum;
+}
+
+uint64_t GestureClockNanos() {
+	return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+GestureParameterBridge::GestureParameterBridge() {
+	for (int i = 0; i < kGestureParameters; ++i) {
+		GestureParameter parameter = (GestureParameter) i;
+		values_[i].store(NormalizeGestureParameter(parameter, kParameters[i].initial), std::memory_order_relaxed);
+	}
+}
+
+bool GestureParameterBridge::Publish(GestureParameter parameter, float normalized, uint64_t nanos) {
+	GestureParameterUpdate update;
+	update.nanos = nanos;
+	update.parameter = (uint8_t) parameter;
+	update.value = normalized;
+	if (!queue_.Push(update)) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	published_.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool GestureParameterBridge::Claim(const void* consumer) {
+	const void* expected = nullptr;
+	if (!consumer_.compare_exchange_strong(expected, consumer, std::memory_order_acq_rel)) {
+		return expected == consumer;
+	}
+	return true;
+}
+
+void GestureParameterBridge::Release(const void* consumer) {
+	if (consumer_.load(std::memory_order_acquire) != consumer) {
+		return;
+	}
+	GestureParameterUpdate update;
+	while (queue_.Pop(&update)) {
+	}
+	consumer_.store(nullptr, std::memory_order_release);
+}
+
+int GestureParameterBridge::TakeBlock(uint64_t blockNanos, GestureParameterEvent* events, int maxEvents) {
+	int count = 0;
+	uint64_t taken = 0;
+	while (const GestureParameterUpdate* update = queue_.Peek()) {
+		if (update->nanos >= blockNanos) {
+			// Published while we were getting here; it belongs to the next block.
+			break;
+		}
+		if (update->parameter < kGestureParameters) {
+			values_[update->parameter].store(update->value, std::memory_order_relaxed);
+			if (count < maxEvents) {
+				events[count].parameter = (GestureParameter) update->parameter;
+				events[count].value = update->value;
+				++count;
+			}
+		}
+		GestureParameterUpdate discard;
+		queue_.Pop(&discard);
+		++taken;
+	}
+	if (taken) {
+		taken_.fetch_add(taken, std::memory_order_relaxed);
+	}
+	return count;
+}
+
+} // namespace amm
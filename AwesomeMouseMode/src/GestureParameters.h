@@ -0,0 +1,95 @@
+#pragma once
+
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace amm {
+
+// Gesture state the plugin exposes as automatable parameters, so touch, pen and trackpad can drive
+// anything in Live that can be mapped to a parameter.
+enum class GestureParameter : uint8_t {
+	kPanSpeed,     // Two-finger or GID_PAN pan speed, 0 to kMaxPanSpeed pixels per second.
+	kPinchScale,   // Pinch spread relative to where it began, 0 to kMaxPinchScale; 1 when not pinching.
+	kPenPressure,  // 0 to 1.
+	kScrollRate,   // Wheel and trackpad scrolling, 0 to kMaxScrollRate wheel units per second.
+	kCount,
+};
+constexpr int kGestureParameters = (int) GestureParameter::kCount;
+
+constexpr float kMaxPanSpeed = 4000.0f;
+constexpr float kMaxPinchScale = 4.0f;
+constexpr float kMaxScrollRate = 4800.0f;
+
+// For the host: short enough for kVstMaxParamStrLen.
+const char* GestureParameterName(GestureParameter parameter);
+const char* GestureParameterLabel(GestureParameter parameter);
+
+// Between the parameter's own units and the 0 to 1 the host automates.
+float NormalizeGestureParameter(GestureParameter parameter, float value);
+float DenormalizeGestureParameter(GestureParameter parameter, float normalized);
+
+// The clock both sides timestamp with.
+uint64_t GestureClockNanos();
+
+// A new value, as the UI thread saw it.
+struct GestureParameterUpdate {
+	uint64_t nanos;     // GestureClockNanos() when it happened.
+	uint8_t parameter;  // GestureParameter.
+	float value;        // Normalized.
+};
+
+// An update taken for an audio block.
+struct GestureParameterEvent {
+	GestureParameter parameter;
+	float value;
+};
+
+// Carries parameter updates from the UI thread, where gestures are seen, to the audio thread, where
+// the plugin hands them to the host. A wait-free ring: neither side ever blocks, locks or
+// allocates. One thread may publish and one plugin instance may consume at a time.
+//
+// VST 2 automation carries no sample offset, so updates are only ordered within a block, not placed.
+class GestureParameterBridge {
+public:
+	static constexpr size_t kCapacity = 1024;
+
+	// Producer. Only worth calling while someone is Listening(). Returns false, and counts a drop, if
+	// the ring is full.
+	bool Publish(GestureParameter parameter, float normalized, uint64_t nanos);
+	bool Listening() const { return consumer_.load(std::memory_order_acquire) != nullptr; }
+
+	// Consumer. Claim returns false if another instance already consumes; Release gives it up and
+	// discards whatever was queued.
+	bool Claim(const void* consumer);
+	void Release(const void* consumer);
+
+	// Consumer. Takes every update that happened before blockNanos, the time the block is being
+	// processed, as events, oldest first. Updates past maxEvents only update the current values.
+	// Returns the number of events.
+	int TakeBlock(uint64_t blockNanos, GestureParameterEvent* events, int maxEvents);
+
+	// The latest value of each parameter the consumer has taken, normalized.
+	float Value(GestureParameter parameter) const { return values_[(int) parameter].load(std::memory_order_relaxed); }
+
+	uint64_t Published() const { return published_.load(std::memory_order_relaxed); }
+	uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+	uint64_t Taken() const { return taken_.load(std::memory_order_relaxed); }
+
+	GestureParameterBridge();
+
+private:
+	SpscQueue<GestureParameterUpdate, kCapacity> queue_;
+	std::atomic<const void*> consumer_{ nullptr };
+	std::atomic<float> values_[kGestureParameters];
+	std::atomic<uint64_t> published_{ 0 };
+	std::atomic<uint64_t> dropped_{ 0 };
+	std::atomic<uint64_t> taken_{ 0 };
+};
+
+// The one bridge between the hook and the plugin, which share the DLL.
+extern GestureParameterBridge gGestureParameters;
+
+} // namespace amm
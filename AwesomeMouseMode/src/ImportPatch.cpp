@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "ImportPatch.h"
+
+namespace amm {
+
+namespace {
+
+// Calls fn(slot) for every import address table entry in module, until it returns true.
+template <typename Fn>
+bool ForEachImportSlot(HMODULE module, Fn fn) {
+	BYTE* base = reinterpret_cast<BYTE*>(module);
+	PIMAGE_DOS_HEADER dos = reinterpret_cast<PIMAGE_DOS_HEADER>(base);
+	if (!base || dos->e_magic != IMAGE_DOS_SIGNATURE) {
+		return false;
+	}
+	PIMAGE_NT_HEADERS nt = reinterpret_cast<PIMAGE_NT_HEADERS>(base + dos->e_lfanew);
+	if (nt->Signature != IMAGE_NT_SIGNATURE) {
+		return false;
+	}
+	const IMAGE_DATA_DIRECTORY& directory = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+	if (directory.VirtualAddress == 0) {
+		return false;
+	}
+	PIMAGE_IMPORT_DESCRIPTOR descriptor = reinterpret_cast<PIMAGE_IMPORT_DESCRIPTOR>(base + directory.VirtualAddress);
+	for (; descriptor->Name != 0; ++descriptor) {
+		PIMAGE_THUNK_DATA thunk = reinterpret_cast<PIMAGE_THUNK_DATA>(base + descriptor->FirstThunk);
+		for (; thunk->u1.Function != 0; ++thunk) {
+			if (fn(reinterpret_cast<void**>(&thunk->u1.Function))) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Swaps one import address table entry, which lives in read-only memory once the loader is done.
+void WriteSlot(void** slot, void* value) {
+	DWORD oldProtect = 0;
+	if (!::VirtualProtect(slot, sizeof(void*), PAGE_READWRITE, &oldProtect)) {
+		return;
+	}
+	::InterlockedExchangePointer(slot, value);
+	::VirtualProtect(slot, sizeof(void*), oldProtect, &oldProtect);
+}
+
+} // namespace
+
+void* PatchImport(HMODULE module, const char* dllName, const char* functionName, void* replacement) {
+	// Match on the resolved address rather than the import name, which also finds imports bound
+	// by ordinal or through a forwarder.
+	HMODULE dll = ::GetModuleHandleA(dllName);
+	void* target = dll ? reinterpret_cast<void*>(::GetProcAddress(dll, functionName)) : nullptr;
+	if (!target) {
+		return nullptr;
+	}
+	void* original = nullptr;
+	ForEachImportSlot(module, [&](void** slot) {
+		if (*slot != target) {
+			return false;
+		}
+		original = target;
+		WriteSlot(slot, replacement);
+		return true;
+	});
+	return original;
+}
+
+void RestoreImport(HMODULE module, void* replacement, void* original) {
+	if (!original) {
+		return;
+	}
+	ForEachImportSlot(module, [&](void** slot) {
+		if (*slot != replacement) {
+			return false;
+		}
+		WriteSlot(slot, original);
+		return true;
+	});
+}
+
+} // namespace amm
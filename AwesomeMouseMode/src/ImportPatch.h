@@ -0,0 +1,13 @@
+#pragma once
+
+namespace amm {
+
+// Redirects one of module's imports to replacement by rewriting its import address table, so calls
+// module makes to that function reach us first. Other modules are unaffected. Returns the original
+// function, for passing calls through and for RestoreImport, or nullptr if module doesn't import it.
+void* PatchImport(HMODULE module, const char* dllName, const char* functionName, void* replacement);
+
+// Undoes PatchImport.
+void RestoreImport(HMODULE module, void* replacement, void* original);
+
+} // namespace amm
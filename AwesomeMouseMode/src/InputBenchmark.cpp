@@ -0,0 +1,571 @@
+#include "InputBenchmark.h"
+
+#include "InputTranslator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace amm {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// What the hook would have found out from user32 at the time of a message.
+struct SyntheticState {
+	DWORD extraInfo;
+	bool cursorShown;
+	BYTE keyState;
+	POINT cursorPos;
+	bool textEntry;
+};
+
+struct SyntheticMessage {
+	UINT msg;
+	WPARAM wParam;
+	LPARAM lParam;
+	DWORD time;
+	SyntheticState state;
+	bool hasGesture;
+	DWORD gestureFlags;
+	POINT gestureLocation;
+};
+
+// The pen and touch bits Windows sets alongside the signature.
+constexpr DWORD kPenExtraInfo = MI_WP_SIGNATURE | 0x80;
+constexpr DWORD kLoadTimers = 3;
+const WPARAM kTimerIds[kLoadTimers] = { kZoomFrameTimerId, kScrollFrameTimerId, kPanInertiaTimerId };
+// Where hooked windows sit on screen, for cursor positions.
+constexpr LONG kWindowX = 100;
+constexpr LONG kWindowY = 80;
+
+// What the user's own remap file might hold, on top of the built-in rules.
+const char kUserRemaps[] =
+	"key Ctrl+D notext consume => Ctrl+Shift+D\n"
+	"key Ctrl+Alt+Left consume => Ctrl+Left Ctrl+Left\n"
+	"char ; text => :\n";
+
+// xorshift32, so every run sees the same load.
+class Random {
+public:
+	explicit Random(uint32_t seed) : state_(seed) {}
+
+	uint32_t Next() {
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 17;
+		state_ ^= state_ << 5;
+		return state_;
+	}
+	int Between(int low, int high) { return low + (int) (Next() % (uint32_t) (high - low + 1)); }
+	bool OneIn(int n) { return Next() % (uint32_t) n == 0; }
+
+private:
+	uint32_t state_;
+};
+
+class LoadBuilder {
+public:
+	explicit LoadBuilder(std::vector<SyntheticMessage>* messages) : messages_(messages) {
+		::memset(&state_, 0, sizeof(state_));
+		state_.cursorShown = true;
+	}
+
+	SyntheticState& State() { return state_; }
+
+	void Add(DWORD time, UINT msg, WPARAM wParam, LPARAM lParam) {
+		SyntheticMessage message;
+		::memset(&message, 0, sizeof(message));
+		message.msg = msg;
+		message.wParam = wParam;
+		message.lParam = lParam;
+		message.time = time;
+		message.state = state_;
+		messages_->push_back(message);
+	}
+
+	// A move in client space, with the cursor following on screen.
+	void Move(DWORD time, WPARAM keys, POINT point) {
+		state_.cursorPos.x = kWindowX + point.x;
+		state_.cursorPos.y = kWindowY + point.y;
+		Add(time, WM_MOUSEMOVE, keys, MAKELPARAM(point.x, point.y));
+	}
+
+	void Gesture(DWORD time, DWORD flags, POINT location) {
+		Add(time, WM_GESTURE, GID_PAN, 0);
+		SyntheticMessage& message = messages_->back();
+		message.hasGesture = true;
+		message.gestureFlags = flags;
+		message.gestureLocation = location;
+	}
+
+private:
+	std::vector<SyntheticMessage>* messages_;
+	SyntheticState state_;
+};
+
+POINT Clamped(double x, double y) {
+	POINT point = { (LONG) std::min(std::max(x, 0.0), 1900.0), (LONG) std::min(std::max(y, 0.0), 1000.0) };
+	return point;
+}
+
+// Hover, press, drag at 1 kHz with Live hiding the cursor and warping it back to the press about
+// once a frame, release. Some strokes hold Shift for Live's fine adjustment.
+void BuildPenDrags(DWORD duration, Random* random, LoadBuilder* load) {
+	SyntheticState& state = load->State();
+	POINT pen = { 600, 400 };
+	DWORD time = 0;
+	while (time < duration) {
+		state.extraInfo = kPenExtraInfo;
+		state.cursorShown = true;
+		state.keyState = 0;
+		for (int i = 0; i < 40; ++i) {
+			pen = Clamped(pen.x + random->Between(-2, 2), pen.y + random->Between(-2, 2));
+			load->Move(time++, 0, pen);
+		}
+		POINT down = pen;
+		load->Add(time, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(down.x, down.y));
+		WPARAM keys = MK_LBUTTON;
+		if (random->OneIn(4)) {
+			keys |= MK_SHIFT;
+			state.keyState = kKeyStateShift;
+		}
+		state.cursorShown = false;
+		int length = random->Between(200, 600);
+		double angle = random->Between(0, 628) / 100.0;
+		double x = pen.x;
+		double y = pen.y;
+		for (int i = 0; i < length; ++i) {
+			// Speeding up and slowing down along a gentle curve, as a fader or knob drag does.
+			double speed = 1.5 * std::sin(3.14159 * i / length) + 0.05;
+			angle += 0.004;
+			x += speed * std::cos(angle);
+			y += speed * std::sin(angle);
+			pen = Clamped(x, y);
+			state.extraInfo = kPenExtraInfo;
+			load->Move(++time, keys, pen);
+			if (i % 8 == 7) {
+				// Live's SetCursorPos back to the press, which arrives as a plain move.
+				state.extraInfo = 0;
+				load->Move(time, keys, down);
+			}
+		}
+		state.extraInfo = kPenExtraInfo;
+		state.cursorShown = true;
+		state.keyState = 0;
+		load->Add(++time, WM_LBUTTONUP, 0, MAKELPARAM(pen.x, pen.y));
+		time += random->Between(20, 60);
+	}
+}
+
+// Flicks on a precision trackpad: a burst of small deltas at 240 Hz that decay as the finger
+// lifts, then a pause. One in four goes sideways.
+void BuildTrackpadScrolls(DWORD duration, Random* random, LoadBuilder* load) {
+	DWORD time = 0;
+	POINT cursor = { 800, 500 };
+	while (time < duration) {
+		bool horizontal = random->OneIn(4);
+		double velocity = random->Between(20, 70) * (random->OneIn(2) ? 1 : -1);
+		double decay = random->Between(970, 992) / 1000.0;
+		int frames = random->Between(60, 150);
+		for (int i = 0; i < frames; ++i) {
+			int delta = (int) std::lround(velocity);
+			velocity *= decay;
+			if (delta == 0) {
+				break;
+			}
+			load->Add(time + (DWORD) (i * 1000 / 240), horizontal ? WM_MOUSEHWHEEL : WM_MOUSEWHEEL,
+				MAKEWPARAM(0, (short) delta), MAKELPARAM(cursor.x, cursor.y));
+		}
+		time += frames * 1000 / 240 + random->Between(100, 400);
+	}
+}
+
+// Pinches the trackpad driver turns into Ctrl+wheel: a storm of deltas at 500 Hz, in and out.
+void BuildPinchStorms(DWORD duration, Random* random, LoadBuilder* load) {
+	SyntheticState& state = load->State();
+	DWORD time = 0;
+	POINT cursor = { 900, 450 };
+	while (time < duration) {
+		state.keyState = kKeyStateControl;
+		int frames = random->Between(250, 500);
+		int direction = random->OneIn(2) ? 1 : -1;
+		int untilReversal = random->Between(30, 100);
+		for (int i = 0; i < frames; ++i) {
+			if (--untilReversal == 0) {
+				direction = -direction;
+				untilReversal = random->Between(30, 100);
+			}
+			int delta = direction * random->Between(10, 120);
+			load->Add(time, WM_MOUSEWHEEL, MAKEWPARAM(MK_CONTROL, (short) delta), MAKELPARAM(cursor.x, cursor.y));
+			time += 2;
+		}
+		state.keyState = 0;
+		time += random->Between(100, 300);
+	}
+}
+
+// Touchscreen pans: WM_GESTURENOTIFY, GF_BEGIN and the move Windows sends with it, moves at 120 Hz,
+// GF_INERTIA frames slowing down, GF_END.
+void BuildPanGestures(DWORD duration, Random* random, LoadBuilder* load) {
+	DWORD time = 0;
+	while (time < duration) {
+		double x = random->Between(200, 1600);
+		double y = random->Between(200, 800);
+		double vx = random->Between(-20, 20);
+		double vy = random->Between(-12, 12);
+		load->Add(time, WM_GESTURENOTIFY, 0, 0);
+		POINT location = Clamped(x, y);
+		load->Gesture(time, GF_BEGIN, location);
+		load->Move(time, 0, location);
+		int moves = random->Between(20, 60);
+		for (int i = 0; i < moves; ++i) {
+			time += 8;
+			x += vx;
+			y += vy;
+			load->Gesture(time, 0, Clamped(x, y));
+		}
+		for (int i = 0; i < 40; ++i) {
+			time += 8;
+			vx *= 0.92;
+			vy *= 0.92;
+			x += vx;
+			y += vy;
+			load->Gesture(time, GF_INERTIA, Clamped(x, y));
+		}
+		load->Gesture(time, GF_END, Clamped(x, y));
+		time += random->Between(150, 500);
+	}
+}
+
+// A performer naming a clip and working the set: typing in text fields, undo and redo, zooming
+// with '=', and the user's own shortcuts.
+void BuildKeyRemaps(DWORD duration, Random* random, LoadBuilder* load) {
+	SyntheticState& state = load->State();
+	DWORD time = 0;
+	while (time < duration) {
+		state.keyState = 0;
+		state.textEntry = random->OneIn(3);
+		switch (random->Between(0, 5)) {
+		case 0:
+			state.keyState = kKeyStateControl | kKeyStateShift;
+			load->Add(time, WM_KEYDOWN, 'Z', 0);
+			load->Add(time + 60, WM_KEYUP, 'Z', 0);
+			break;
+		case 1:
+			load->Add(time, WM_KEYDOWN, VK_OEM_PLUS, 0);
+			load->Add(time, WM_CHAR, '=', 0);
+			load->Add(time + 60, WM_KEYUP, VK_OEM_PLUS, 0);
+			break;
+		case 2:
+			state.keyState = kKeyStateControl;
+			load->Add(time, WM_KEYDOWN, 'D', 0);
+			load->Add(time + 60, WM_KEYUP, 'D', 0);
+			break;
+		case 3:
+			state.keyState = kKeyStateControl | kKeyStateAlt;
+			load->Add(time, WM_SYSKEYDOWN, 0x25, 0);
+			load->Add(time + 60, WM_KEYUP, 0x25, 0);
+			break;
+		default:
+			{
+				// Plain typing, which has no rules and should cost next to nothing.
+				WPARAM key = 'A' + random->Between(0, 25);
+				load->Add(time, WM_KEYDOWN, key, 0);
+				load->Add(time, WM_CHAR, random->OneIn(8) ? ';' : key + 'a' - 'A', 0);
+				load->Add(time + 40, WM_KEYUP, key, 0);
+			}
+			break;
+		}
+		time += random->Between(20, 80);
+	}
+}
+
+void BuildLoad(SyntheticLoad load, DWORD duration, std::vector<SyntheticMessage>* messages) {
+	Random random(0x414D4D00u + (uint32_t) load);
+	LoadBuilder builder(messages);
+	switch (load) {
+	case SyntheticLoad::kPenDrag:
+		BuildPenDrags(duration, &random, &builder);
+		break;
+	case SyntheticLoad::kTrackpadScroll:
+		BuildTrackpadScrolls(duration, &random, &builder);
+		break;
+	case SyntheticLoad::kPinchZoom:
+		BuildPinchStorms(duration, &random, &builder);
+		break;
+	case SyntheticLoad::kPanGesture:
+		BuildPanGestures(duration, &random, &builder);
+		break;
+	case SyntheticLoad::kKeyRemap:
+		BuildKeyRemaps(duration, &random, &builder);
+		break;
+	default:
+		break;
+	}
+	// Messages added out of order (key ups) go back in time order; the sort is stable so
+	// simultaneous ones keep theirs.
+	std::stable_sort(messages->begin(), messages->end(),
+		[](const SyntheticMessage& a, const SyntheticMessage& b) { return a.time < b.time; });
+}
+
+// Stands in for user32 on both sides of the handler: answers the lazy queries from the load, and
+// carries out actions by counting them and running the timers the handler sets.
+class User32StandIn : public InputSource {
+public:
+	User32StandIn() {
+		::memset(&state_, 0, sizeof(state_));
+		for (DWORD i = 0; i < kLoadTimers; ++i) {
+			timerPeriod_[i] = 0;
+			timerDue_[i] = 0;
+		}
+	}
+
+	void SetState(const SyntheticState& state) { state_ = state; }
+
+	void Fetch(const InputMessage& in, BYTE fields) const override {
+		if (fields & kInputExtraInfo) {
+			in.extraInfo = state_.extraInfo;
+			++queries_;
+		}
+		if (fields & kInputCursorShown) {
+			in.cursorShown = state_.cursorShown;
+			++queries_;
+		}
+		if (fields & kInputKeyState) {
+			in.keyState = state_.keyState;
+			queries_ += 3;
+		}
+		if (fields & kInputCursorPos) {
+			in.cursorPos = state_.cursorPos;
+			++queries_;
+		}
+		if (fields & kInputTextEntry) {
+			in.textEntry = state_.textEntry;
+			++queries_;
+		}
+		in.present |= fields;
+	}
+
+	void Emit(DWORD time, const TranslatedInput& out, LoadBenchmark* totals) {
+		for (int i = 0; i < out.actionCount; ++i) {
+			const OutputAction& action = out.actions[i];
+			switch (action.type) {
+			case ActionType::kForward:
+				++totals->forwards;
+				break;
+			case ActionType::kSendInput:
+				++totals->sendInputCalls;
+				totals->syntheticKeys += action.keyCount;
+				break;
+			case ActionType::kSetCursorPos:
+			case ActionType::kSetCursorPosClient:
+				++totals->cursorMoves;
+				break;
+			case ActionType::kSetTimer:
+				for (DWORD t = 0; t < kLoadTimers; ++t) {
+					if (kTimerIds[t] == action.wParam) {
+						// Windows never fires timers faster than its own minimum.
+						timerPeriod_[t] = std::max<DWORD>((DWORD) action.lParam, 10);
+						timerDue_[t] = time + timerPeriod_[t];
+					}
+				}
+				break;
+			case ActionType::kKillTimer:
+				for (DWORD t = 0; t < kLoadTimers; ++t) {
+					if (kTimerIds[t] == action.wParam) {
+						timerPeriod_[t] = 0;
+					}
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	// The earliest timer due by time, if any. Like WM_TIMER, a late timer fires once, not once per
+	// period missed.
+	bool NextTimer(DWORD time, WPARAM* timerId, DWORD* due) {
+		int next = -1;
+		for (DWORD t = 0; t < kLoadTimers; ++t) {
+			if (timerPeriod_[t] && (int32_t) (timerDue_[t] - time) <= 0 &&
+					(next < 0 || (int32_t) (timerDue_[t] - timerDue_[next]) < 0)) {
+				next = (int) t;
+			}
+		}
+		if (next < 0) {
+			return false;
+		}
+		*timerId = kTimerIds[next];
+		*due = timerDue_[next];
+		timerDue_[next] += timerPeriod_[next];
+		if ((int32_t) (timerDue_[next] - time) <= 0) {
+			timerDue_[next] = time + timerPeriod_[next];
+		}
+		return true;
+	}
+
+	bool AnyTimer() const {
+		for (DWORD t = 0; t < kLoadTimers; ++t) {
+			if (timerPeriod_[t]) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint64_t Queries() const { return queries_; }
+
+private:
+	SyntheticState state_;
+	DWORD timerPeriod_[kLoadTimers];
+	DWORD timerDue_[kLoadTimers];
+	mutable uint64_t queries_ = 0;
+};
+
+// Runs the whole load through a fresh translator, as OurWndProc would see it. If nanos is set,
+// each message's handling time goes there.
+template <bool Timed>
+void RunLoad(const std::vector<SyntheticMessage>& messages, uint32_t features, LoadBenchmark* totals,
+		std::vector<uint32_t>* nanos) {
+	std::unique_ptr<InputTranslator> translator(new InputTranslator());
+	translator->SetFeatures(features);
+	KeyRemapTable remap;
+	CompileBuiltinKeyRemaps(&remap);
+	remap.Compile(kUserRemaps, 0);
+	translator->SetKeyRemap(remap);
+	User32StandIn user32;
+	*totals = LoadBenchmark();
+
+	auto handle = [&](UINT msg, WPARAM wParam, LPARAM lParam, DWORD time, const SyntheticMessage* source) {
+		InputMessage in;
+		::memset(&in, 0, sizeof(in));
+		in.msg = msg;
+		in.wParam = wParam;
+		in.lParam = lParam;
+		in.time = time;
+		in.source = &user32;
+		if (source && source->hasGesture) {
+			in.hasGesture = true;
+			in.gestureId = GID_PAN;
+			in.gestureFlags = source->gestureFlags;
+			in.gestureLocation = source->gestureLocation;
+		}
+		Clock::time_point start;
+		if (Timed) {
+			start = Clock::now();
+		}
+		TranslatedInput out;
+		translator->Translate(in, &out);
+		user32.Emit(time, out, totals);
+		if (Timed) {
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+			nanos->push_back((uint32_t) std::min<int64_t>(elapsed, UINT32_MAX));
+		}
+		++totals->messages;
+	};
+
+	WPARAM timerId = 0;
+	DWORD due = 0;
+	for (const SyntheticMessage& message : messages) {
+		while (user32.NextTimer(message.time, &timerId, &due)) {
+			handle(WM_TIMER, timerId, 0, due, nullptr);
+			++totals->timerMessages;
+		}
+		user32.SetState(message.state);
+		handle(message.msg, message.wParam, message.lParam, message.time, &message);
+	}
+	// Let whatever is still scrolling, zooming or coasting run out, within reason.
+	DWORD time = messages.empty() ? 0 : messages.back().time;
+	for (DWORD end = time + 2000; user32.AnyTimer() && time < end; ++time) {
+		while (user32.NextTimer(time, &timerId, &due)) {
+			handle(WM_TIMER, timerId, 0, due, nullptr);
+			++totals->timerMessages;
+		}
+	}
+	totals->queries = user32.Queries();
+}
+
+// The least the clock costs to read, taken off every timed message.
+double ClockOverheadNanos() {
+	int64_t best = INT64_MAX;
+	for (int i = 0; i < 1000; ++i) {
+		Clock::time_point a = Clock::now();
+		Clock::time_point b = Clock::now();
+		best = std::min<int64_t>(best, std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count());
+	}
+	return (double) best;
+}
+
+double Median(std::vector<double>* values) {
+	std::sort(values->begin(), values->end());
+	return (*values)[values->size() / 2];
+}
+
+double Best(const std::vector<double>& values, bool highest) {
+	return highest ? *std::max_element(values.begin(), values.end()) : *std::min_element(values.begin(), values.end());
+}
+
+} // namespace
+
+const char* SyntheticLoadName(SyntheticLoad load) {
+	switch (load) {
+	case SyntheticLoad::kPenDrag: return "pen-drag";
+	case SyntheticLoad::kTrackpadScroll: return "trackpad-scroll";
+	case SyntheticLoad::kPinchZoom: return "pinch-zoom";
+	case SyntheticLoad::kPanGesture: return "pan-gesture";
+	case SyntheticLoad::kKeyRemap: return "key-remap";
+	default: return "?";
+	}
+}
+
+bool BenchmarkSyntheticLoad(SyntheticLoad load, uint32_t features, int seconds, int repetitions,
+		LoadBenchmark* result) {
+	if (load < SyntheticLoad::kPenDrag || load >= SyntheticLoad::kCount || seconds <= 0 || repetitions <= 0) {
+		return false;
+	}
+	std::vector<SyntheticMessage> messages;
+	BuildLoad(load, (DWORD) seconds * 1000, &messages);
+	double overhead = ClockOverheadNanos();
+
+	std::vector<double> p50;
+	std::vector<double> p99;
+	std::vector<double> p999;
+	std::vector<double> maximum;
+	std::vector<double> throughput;
+	std::vector<uint32_t> nanos;
+	nanos.reserve(messages.size() * 2);
+	for (int r = 0; r < repetitions; ++r) {
+		nanos.clear();
+		RunLoad<true>(messages, features, result, &nanos);
+		std::sort(nanos.begin(), nanos.end());
+		auto at = [&](double fraction) {
+			size_t index = std::min(nanos.size() - 1, (size_t) (fraction * (double) nanos.size()));
+			return std::max(0.0, nanos[index] - overhead);
+		};
+		p50.push_back(at(0.5));
+		p99.push_back(at(0.99));
+		p999.push_back(at(0.999));
+		maximum.push_back(std::max(0.0, nanos.back() - overhead));
+
+		LoadBenchmark untimed;
+		Clock::time_point start = Clock::now();
+		RunLoad<false>(messages, features, &untimed, nullptr);
+		double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		throughput.push_back(elapsed > 0 ? untimed.messages / elapsed : 0);
+	}
+	// Anything else on the machine only ever makes a run slower, so the best run is the one to
+	// compare. The tails are mostly the scheduler's doing either way.
+	result->p50Nanos = Best(p50, false);
+	result->p99Nanos = Best(p99, false);
+	result->p999Nanos = Median(&p999);
+	result->maxNanos = Median(&maximum);
+	result->messagesPerSecond = Best(throughput, true);
+	return true;
+}
+
+} // namespace amm
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+namespace amm {
+
+// Synthetic-load benchmark of the message handler, for tools/InputBench. Built into the tools, not
+// the hook.
+
+// Generated input for benchmarking the message handler, each load shaped like the hardware that
+// produces it: rates, pauses, reversals and the messages Windows and Live interleave.
+enum class SyntheticLoad {
+	kPenDrag,         // 1 kHz pen drags (IS_PEN_EVENT) under Live's hidden cursor, with its warps back.
+	kTrackpadScroll,  // 240 Hz precision trackpad wheel bursts, mostly vertical, decaying like a flick.
+	kPinchZoom,       // Ctrl+wheel pinch storms at 500 Hz, reversing direction every few frames.
+	kPanGesture,      // GID_PAN begin, moves, GF_INERTIA frames and GF_END, as a touchscreen sends them.
+	kKeyRemap,        // Typing, Ctrl+Shift+Z, '=' in and out of text fields, and user remaps.
+	kCount,
+};
+
+// Short and without spaces, for tables and baseline files.
+const char* SyntheticLoadName(SyntheticLoad load);
+
+struct LoadBenchmark {
+	// Per pass over the load. Messages include the WM_TIMER frames the handler asked for.
+	uint64_t messages = 0;
+	uint64_t timerMessages = 0;
+	uint64_t queries = 0;         // Lazily fetched InputMessage fields, each a user32 call in the hook.
+	uint64_t forwards = 0;        // Messages handed on to Live.
+	uint64_t sendInputCalls = 0;
+	uint64_t syntheticKeys = 0;
+	uint64_t cursorMoves = 0;
+
+	// Time to handle one message: translation plus carrying out its actions against stand-ins for
+	// user32, with the clock's own cost taken out. p50, p99 and throughput are the best of the
+	// repetitions; p99.9 and the maximum their median.
+	double p50Nanos = 0;
+	double p99Nanos = 0;
+	double p999Nanos = 0;
+	double maxNanos = 0;
+	double messagesPerSecond = 0;  // Back to back, untimed per message.
+};
+
+// Runs seconds' worth (in message time) of load through a fresh InputTranslator set up with
+// features, repetitions times. The load is the same every run. Returns false if the arguments
+// make no sense.
+bool BenchmarkSyntheticLoad(SyntheticLoad load, uint32_t features, int seconds, int repetitions,
+	LoadBenchmark* result);
+
+} // namespace amm
@@ -0,0 +1,191 @@
+#include "InputRecording.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace amm {
+
+namespace {
+
+// FNV-1a.
+inline uint32_t HashBytes(uint32_t hash, const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+template <typename T>
+inline uint32_t HashValue(uint32_t hash, T value) {
+	return HashBytes(hash, &value, sizeof(value));
+}
+
+} // namespace
+
+uint32_t HashTranslatedInput(const TranslatedInput& out) {
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < out.actionCount; ++i) {
+		const OutputAction& action = out.actions[i];
+		hash = HashValue(hash, (uint8_t) action.type);
+		hash = HashValue(hash, (uint8_t) ((action.isResult ? 1 : 0) | (action.trackpadScroll ? 2 : 0)));
+		hash = HashValue(hash, (uint32_t) action.msg);
+		hash = HashValue(hash, (uint64_t) action.wParam);
+		hash = HashValue(hash, (int64_t) action.lParam);
+		hash = HashValue(hash, (int32_t) action.point.x);
+		hash = HashValue(hash, (int32_t) action.point.y);
+		for (int k = 0; k < action.keyCount; ++k) {
+			const SyntheticKey& key = out.keys[action.keyBegin + k];
+			hash = HashValue(hash, (uint16_t) key.vk);
+			hash = HashValue(hash, (uint8_t) key.keyUp);
+		}
+	}
+	return hash;
+}
+
+void EncodeRecordedMessage(const InputMessage& in, const TranslatedInput& out, RecordedMessage* record) {
+	::memset(record, 0, sizeof(*record));
+	// Recording needs the full snapshot, including anything the translator didn't look at.
+	in.Need(kInputAll);
+	record->msg = in.msg;
+	record->time = in.time;
+	record->wParam = in.wParam;
+	record->lParam = in.lParam;
+	record->extraInfo = in.extraInfo;
+	record->flags = (in.cursorShown ? kRecordedCursorShown : 0) |
+		(in.inTrackpadScroll ? kRecordedInTrackpadScroll : 0) |
+		(in.hasGesture ? kRecordedHasGesture : 0) |
+		(IS_PEN_EVENT(in.extraInfo) ? kRecordedPenEvent : 0) |
+		(in.textEntry ? kRecordedTextEntry : 0);
+	record->keyState = in.keyState;
+	record->cursorX = in.cursorPos.x;
+	record->cursorY = in.cursorPos.y;
+	record->gestureId = in.gestureId;
+	record->gestureFlags = in.gestureFlags;
+	record->gestureX = in.gestureLocation.x;
+	record->gestureY = in.gestureLocation.y;
+	record->gestureArguments = in.gestureArguments;
+
+	record->actionCount = (uint8_t) out.actionCount;
+	record->keyCount = (uint8_t) out.keyCount;
+	record->outputHash = HashTranslatedInput(out);
+	for (int i = 0; i < out.actionCount; ++i) {
+		const OutputAction& action = out.actions[i];
+		if (action.type == ActionType::kForward && action.isResult) {
+			record->resultMsg = action.msg;
+			record->resultWParam = action.wParam;
+			record->resultLParam = action.lParam;
+		}
+	}
+}
+
+void DecodeRecordedMessage(const RecordedMessage& record, InputMessage* in) {
+	::memset(in, 0, sizeof(*in));
+	in->msg = record.msg;
+	in->time = record.time;
+	in->wParam = (WPARAM) record.wParam;
+	in->lParam = (LPARAM) record.lParam;
+	in->present = kInputAll;
+	in->extraInfo = record.extraInfo;
+	in->cursorShown = (record.flags & kRecordedCursorShown) != 0;
+	in->inTrackpadScroll = (record.flags & kRecordedInTrackpadScroll) != 0;
+	in->hasGesture = (record.flags & kRecordedHasGesture) != 0;
+	in->textEntry = (record.flags & kRecordedTextEntry) != 0;
+	in->keyState = record.keyState;
+	in->cursorPos.x = record.cursorX;
+	in->cursorPos.y = record.cursorY;
+	in->gestureId = record.gestureId;
+	in->gestureFlags = record.gestureFlags;
+	in->gestureLocation.x = record.gestureX;
+	in->gestureLocation.y = record.gestureY;
+	in->gestureArguments = record.gestureArguments;
+}
+
+void ApplyRecordedSettings(const RecordedSettings& settings, InputTranslator* translator) {
+	translator->SetInertiaFriction(settings.inertiaFriction);
+	translator->SetZoomBudget(settings.zoomStepsPerFrame);
+	translator->SetPenFilter(settings.pen);
+	translator->SetPredictionLead(settings.predictionLeadMs);
+	translator->SetKeyRemap(settings.remap);
+	translator->SetFeatures(settings.features);
+}
+
+bool WriteRecordingHeader(FILE* file, const RecordedSettings& settings) {
+	struct {
+		RecordingHeader header;
+		RecordedSettings settings;
+	} start;
+	::memset(&start.header, 0, sizeof(start.header));
+	start.header.magic = RecordingHeader::kMagic;
+	start.header.version = RecordingHeader::kVersion;
+	start.header.recordSize = sizeof(RecordedMessage);
+	start.header.settingsSize = sizeof(RecordedSettings);
+	start.header.features = settings.features;
+	start.settings = settings;
+	static_assert(sizeof(start) == sizeof(RecordingHeader) + sizeof(RecordedSettings), "The settings follow the header");
+	return ::fwrite(&start, sizeof(start), 1, file) == 1;
+}
+
+void WriteSettingsChange(FILE* file, int window, const RecordedSettings& settings) {
+	RecordedMessage records[1 + RecordsForPayload(sizeof(RecordedSettings))];
+	::memset(records, 0, sizeof(records));
+	records[0].msg = kRecordedSettingsChange;
+	records[0].window = (uint16_t) window;
+	records[0].wParam = sizeof(RecordedSettings);
+	::memcpy(&records[1], &settings, sizeof(settings));
+	::fwrite(records, sizeof(records), 1, file);
+}
+
+void WriteRecordedMessage(FILE* file, const InputMessage& in, const RecordedMessage& record) {
+	constexpr size_t kMaxPayloadRecords = RecordsForPayload(kMaxTouchHistory * sizeof(TouchFrame));
+	RecordedMessage records[1 + kMaxPayloadRecords + 1];
+	size_t count = 0;
+	int frames = in.touchFrames && in.touchFrameCount > 0 ? std::min(in.touchFrameCount, kMaxTouchHistory) : 0;
+	if (frames > 0) {
+		size_t bytes = frames * sizeof(TouchFrame);
+		size_t payloadRecords = RecordsForPayload(bytes);
+		::memset(records, 0, (1 + payloadRecords) * sizeof(RecordedMessage));
+		records[0].msg = kRecordedTouchFrames;
+		records[0].window = record.window;
+		records[0].wParam = bytes;
+		::memcpy(&records[1], in.touchFrames, bytes);
+		count = 1 + payloadRecords;
+	}
+	records[count++] = record;
+	::fwrite(records, sizeof(RecordedMessage), count, file);
+}
+
+InputRecorder::~InputRecorder() {
+	if (file_) {
+		::fclose(file_);
+	}
+}
+
+bool InputRecorder::Open(const char* path, const RecordedSettings& settings) {
+	if (file_) {
+		::fclose(file_);
+	}
+	file_ = ::fopen(path, "wb");
+	if (!file_) {
+		return false;
+	}
+	return WriteRecordingHeader(file_, settings);
+}
+
+void InputRecorder::AppendSettings(int window, const RecordedSettings& settings) {
+	if (file_) {
+		WriteSettingsChange(file_, window, settings);
+	}
+}
+
+void InputRecorder::Append(const InputMessage& in, const TranslatedInput& out, int window) {
+	if (!file_) {
+		return;
+	}
+	RecordedMessage record;
+	EncodeRecordedMessage(in, out, &record);
+	record.window = (uint16_t) window;
+	WriteRecordedMessage(file_, in, record);
+}
+
+} // namespace amm
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "InputTranslator.h"
+#include "WindowRegistry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+
+namespace amm {
+
+// Input recording file: a RecordingHeader and, from version 3, the RecordedSettings in effect when
+// recording started, followed by fixed-size records appended as they happen. Fixed sizes keep the
+// file trivially memory-mappable, and the record count is simply whatever fits, so a recording cut
+// short by a crash is still readable.
+struct RecordingHeader {
+	static constexpr uint32_t kMagic = 0x524d4d41;  // "AMMR".
+	static constexpr uint16_t kVersion = 3;
+	// Version 1 files didn't store features; they were recorded with everything that existed then.
+	static constexpr uint32_t kVersion1Features = 0x3F;
+
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	// From version 3, sizeof(RecordedSettings). Before, once the seed for the digitizer's random
+	// hold; ignored.
+	uint32_t settingsSize;
+	uint32_t features;  // InputTranslator::Features() in effect when recording started.
+};
+
+// Everything a translator is set up with, as the hook applied it. The key remaps are stored as
+// compiled, so a replay doesn't need the .remap file they came from.
+struct RecordedSettings {
+	uint32_t features;
+	int32_t predictionLeadMs;
+	int32_t inertiaFriction;
+	int32_t zoomStepsPerFrame;
+	PenFilter::Config pen;
+	KeyRemapTable remap;
+};
+
+static_assert(std::is_trivially_copyable<RecordedSettings>::value, "RecordedSettings is part of the file format");
+
+void ApplyRecordedSettings(const RecordedSettings& settings, InputTranslator* translator);
+
+// Bits for RecordedMessage::flags.
+constexpr uint8_t kRecordedCursorShown = 0x01;
+constexpr uint8_t kRecordedInTrackpadScroll = 0x02;
+constexpr uint8_t kRecordedHasGesture = 0x04;
+constexpr uint8_t kRecordedPenEvent = 0x08;  // IS_PEN_EVENT(extraInfo), for readers' convenience.
+constexpr uint8_t kRecordedTextEntry = 0x10;
+
+// One incoming message and what the translator decided to do with it.
+struct RecordedMessage {
+	// Input.
+	uint32_t msg;
+	uint32_t time;
+	uint64_t wParam;
+	int64_t lParam;
+	uint32_t extraInfo;
+	uint8_t flags;
+	uint8_t keyState;
+	uint16_t window;  // Which hooked window it went to, by registry slot. Each has its own state.
+	int32_t cursorX;
+	int32_t cursorY;
+	uint32_t gestureId;
+	uint32_t gestureFlags;
+	int32_t gestureX;
+	int32_t gestureY;
+	uint64_t gestureArguments;
+
+	// Decision.
+	uint8_t actionCount;
+	uint8_t keyCount;
+	uint16_t reserved1;
+	uint32_t outputHash;  // HashTranslatedInput() of everything emitted.
+	uint32_t resultMsg;   // The message forwarded as OurWndProc's result, or 0 if consumed.
+	uint32_t reserved2;
+	uint64_t resultWParam;
+	int64_t resultLParam;
+};
+
+static_assert(sizeof(RecordedMessage) == 96, "RecordedMessage is part of the file format");
+
+// Records that aren't messages: a RecordedMessage whose msg is one of these, well clear of any
+// window message, whose window says which window it belongs to and whose wParam is the size in
+// bytes of the payload filling as many records after it as it needs. Each goes with the window's
+// next message.
+constexpr uint32_t kRecordedSettingsChange = 0x414d0001;  // Payload: the RecordedSettings now applied.
+constexpr uint32_t kRecordedTouchFrames = 0x414d0002;     // Payload: the message's TouchFrames.
+
+inline bool IsRecordedExtension(uint32_t msg) { return msg > 0xffff; }
+
+// Records taken up by a payload of the given size.
+constexpr size_t RecordsForPayload(size_t bytes) {
+	return (bytes + sizeof(RecordedMessage) - 1) / sizeof(RecordedMessage);
+}
+
+// Stable hash of every action and key in a translation, for cheap golden comparisons.
+uint32_t HashTranslatedInput(const TranslatedInput& out);
+
+void EncodeRecordedMessage(const InputMessage& in, const TranslatedInput& out, RecordedMessage* record);
+// Leaves in's touch frames empty; they are recorded separately.
+void DecodeRecordedMessage(const RecordedMessage& record, InputMessage* in);
+
+// Writers for each part of a recording, one fwrite apiece so that writers on several threads don't
+// interleave within a part.
+bool WriteRecordingHeader(FILE* file, const RecordedSettings& settings);
+void WriteSettingsChange(FILE* file, int window, const RecordedSettings& settings);
+// record is in, encoded; any touch frames in carries are written ahead of it.
+void WriteRecordedMessage(FILE* file, const InputMessage& in, const RecordedMessage& record);
+
+// Appends messages to a recording file. One fwrite per message; safe to leave on in a session.
+class InputRecorder {
+public:
+	~InputRecorder();
+
+	bool Open(const char* path, const RecordedSettings& settings);
+	// A window's translator has been given new settings, which apply from its next message.
+	void AppendSettings(int window, const RecordedSettings& settings);
+	void Append(const InputMessage& in, const TranslatedInput& out, int window);
+
+private:
+	FILE* file_ = nullptr;
+};
+
+} // namespace amm
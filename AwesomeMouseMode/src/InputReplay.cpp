@@ -0,0 +1,368 @@
+#include "InputReplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace amm {
+
+namespace {
+
+bool SameDecision(const RecordedMessage& a, const RecordedMessage& b) {
+	return a.actionCount == b.actionCount && a.keyCount == b.keyCount && a.outputHash == b.outputHash &&
+		a.resultMsg == b.resultMsg && a.resultWParam == b.resultWParam && a.resultLParam == b.resultLParam;
+}
+
+bool ForwardsWheel(const TranslatedInput& out) {
+	for (int i = 0; i < out.actionCount; ++i) {
+		if (out.actions[i].type == ActionType::kForward && out.actions[i].msg == WM_MOUSEWHEEL) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// A pause this long between moves starts a new stroke.
+constexpr DWORD kStrokeGapMs = 100;
+// Lag is only meaningful while the pen is moving at least this fast, in pixels per millisecond.
+constexpr double kPenMovingSpeed = 0.1;
+// Timing passes repeat the stream until at least this many samples have been filtered.
+constexpr uint64_t kPenTimingSamples = 1000000;
+// Predictions are only scored while the drag covers at least this many pixels over the lead.
+constexpr double kPredictionMinTravelPx = 1.0;
+
+struct MoveSample {
+	POINT position;
+	DWORD time;
+	bool strokeStart;
+};
+
+enum class StrokeKind {
+	kPen,   // Pen moves, button or not.
+	kDrag,  // Left-button drags, from any device.
+};
+
+// Pulls the moves of one kind out of a recording, marking where each stroke starts: at clicks,
+// releases and pauses.
+void CollectStrokes(const Recording& recording, StrokeKind kind, std::vector<MoveSample>* samples) {
+	bool strokeStart = true;
+	DWORD lastTime = 0;
+	for (const Recording::Message& message : recording.messages) {
+		const RecordedMessage& record = message.record;
+		if (record.msg == WM_LBUTTONDOWN || record.msg == WM_LBUTTONUP) {
+			strokeStart = true;
+			continue;
+		}
+		if (record.msg != WM_MOUSEMOVE) {
+			continue;
+		}
+		bool wanted = kind == StrokeKind::kPen ? (record.flags & kRecordedPenEvent) != 0 : (record.wParam & MK_LBUTTON) != 0;
+		if (!wanted) {
+			strokeStart = true;
+			continue;
+		}
+		MoveSample sample;
+		sample.position.x = GET_X_LPARAM(record.lParam);
+		sample.position.y = GET_Y_LPARAM(record.lParam);
+		sample.time = record.time;
+		sample.strokeStart = strokeStart || samples->empty() || record.time - lastTime > kStrokeGapMs;
+		samples->push_back(sample);
+		strokeStart = false;
+		lastTime = record.time;
+	}
+}
+
+} // namespace
+
+bool ReadRecording(const void* data, size_t size, Recording* recording) {
+	const char* bytes = static_cast<const char*>(data);
+	RecordingHeader& header = recording->header;
+	if (!data || size < sizeof(header)) {
+		return false;
+	}
+	::memcpy(&header, bytes, sizeof(header));
+	if (header.magic != RecordingHeader::kMagic || header.version < 1 || header.version > RecordingHeader::kVersion ||
+			header.recordSize != sizeof(RecordedMessage)) {
+		return false;
+	}
+	if (header.version == 1) {
+		header.features = RecordingHeader::kVersion1Features;
+	}
+	size_t offset = sizeof(header);
+	recording->hasSettings = header.version >= 3;
+	if (recording->hasSettings) {
+		if (header.settingsSize != sizeof(RecordedSettings) || size - offset < sizeof(RecordedSettings)) {
+			return false;
+		}
+		::memcpy(&recording->settings, bytes + offset, sizeof(RecordedSettings));
+		offset += sizeof(RecordedSettings);
+	}
+	recording->messages.clear();
+	recording->settingsChanges.clear();
+	recording->touchFrames.clear();
+
+	// Extensions wait here for their window's next message.
+	struct Pending {
+		int settingsChange = -1;
+		size_t touchBegin = 0;
+		int touchCount = 0;
+	};
+	std::vector<Pending> pending;
+	size_t count = (size - offset) / sizeof(RecordedMessage);
+	for (size_t i = 0; i < count; ++i) {
+		Recording::Message message;
+		::memcpy(&message.record, bytes + offset + i * sizeof(RecordedMessage), sizeof(RecordedMessage));
+		const RecordedMessage& record = message.record;
+		if (record.window >= pending.size()) {
+			pending.resize(record.window + 1);
+		}
+		Pending& window = pending[record.window];
+		if (!IsRecordedExtension(record.msg)) {
+			message.settingsChange = window.settingsChange;
+			message.touchBegin = window.touchBegin;
+			message.touchCount = window.touchCount;
+			window = Pending();
+			recording->messages.push_back(message);
+			continue;
+		}
+		size_t payloadRecords = RecordsForPayload((size_t) record.wParam);
+		if (payloadRecords > count - i - 1) {
+			break;  // Cut short.
+		}
+		const char* payload = bytes + offset + (i + 1) * sizeof(RecordedMessage);
+		if (record.msg == kRecordedSettingsChange && record.wParam == sizeof(RecordedSettings)) {
+			window.settingsChange = (int) recording->settingsChanges.size();
+			recording->settingsChanges.emplace_back();
+			::memcpy(&recording->settingsChanges.back(), payload, sizeof(RecordedSettings));
+		} else if (record.msg == kRecordedTouchFrames && record.wParam % sizeof(TouchFrame) == 0) {
+			window.touchBegin = recording->touchFrames.size();
+			window.touchCount = (int) (record.wParam / sizeof(TouchFrame));
+			recording->touchFrames.resize(window.touchBegin + window.touchCount);
+			::memcpy(&recording->touchFrames[window.touchBegin], payload, (size_t) record.wParam);
+		}
+		i += payloadRecords;
+	}
+	return true;
+}
+
+bool ReplayRecording(const void* recording, size_t recordingSize, const void* golden, size_t goldenSize,
+		FILE* out, ReplayResult* result) {
+	std::unique_ptr<Recording> source(new Recording());
+	if (!ReadRecording(recording, recordingSize, source.get())) {
+		return false;
+	}
+	const Recording* expected = source.get();
+	std::unique_ptr<Recording> goldenRecording;
+	if (golden) {
+		goldenRecording.reset(new Recording());
+		if (!ReadRecording(golden, goldenSize, goldenRecording.get())) {
+			return false;
+		}
+		expected = goldenRecording.get();
+	}
+	if (out) {
+		if (source->hasSettings) {
+			WriteRecordingHeader(out, source->settings);
+		} else {
+			// Nothing more to carry over than the features, which version 2 holds.
+			RecordingHeader header = source->header;
+			header.version = 2;
+			header.settingsSize = 0;
+			::fwrite(&header, sizeof(header), 1, out);
+		}
+	}
+
+	*result = ReplayResult();
+	// Created as windows first appear. Slots past the registry's capacity can't have been recorded.
+	std::unique_ptr<InputTranslator> translators[WindowRegistry::kCapacity];
+	bool scrollPending = false;
+	DWORD scrollPendingSince = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < source->messages.size(); ++i) {
+		const Recording::Message& message = source->messages[i];
+		int window = message.record.window % WindowRegistry::kCapacity;
+		std::unique_ptr<InputTranslator>& translator = translators[window];
+		if (!translator) {
+			translator.reset(new InputTranslator());
+			if (source->hasSettings) {
+				ApplyRecordedSettings(source->settings, translator.get());
+			} else {
+				translator->SetFeatures(source->header.features);
+			}
+		}
+		if (message.settingsChange >= 0) {
+			const RecordedSettings& settings = source->settingsChanges[message.settingsChange];
+			ApplyRecordedSettings(settings, translator.get());
+			if (out) {
+				WriteSettingsChange(out, message.record.window, settings);
+			}
+		}
+		InputMessage in;
+		DecodeRecordedMessage(message.record, &in);
+		if (message.touchCount > 0) {
+			in.touchFrames = &source->touchFrames[message.touchBegin];
+			in.touchFrameCount = message.touchCount;
+		}
+		TranslatedInput translated;
+		translator->Translate(in, &translated);
+
+		RecordedMessage replayed;
+		EncodeRecordedMessage(in, translated, &replayed);
+		replayed.window = message.record.window;
+		if (out) {
+			WriteRecordedMessage(out, in, replayed);
+		}
+		++result->messages;
+		if (!scrollPending && (in.msg == WM_MOUSEHWHEEL || (in.msg == WM_MOUSEWHEEL && LOWORD(in.wParam) != MK_CONTROL))) {
+			scrollPending = true;
+			scrollPendingSince = in.time;
+		}
+		if (scrollPending && ForwardsWheel(translated)) {
+			uint32_t latency = in.time - scrollPendingSince;
+			scrollPending = false;
+			++result->scrollResponses;
+			result->scrollLatencyTotalMs += latency;
+			result->scrollLatencyMaxMs = std::max(result->scrollLatencyMaxMs, latency);
+		}
+		if (i >= expected->messages.size() || !SameDecision(replayed, expected->messages[i].record)) {
+			++result->mismatches;
+			if (result->firstMismatch < 0) {
+				result->firstMismatch = (int64_t) i;
+			}
+		}
+	}
+	if (expected->messages.size() > source->messages.size()) {
+		result->mismatches += expected->messages.size() - source->messages.size();
+	}
+	result->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+bool BenchmarkPenFilter(const void* recording, size_t recordingSize, const PenFilter::Config& config,
+		PenFilterBenchmark* result) {
+	std::unique_ptr<Recording> source(new Recording());
+	if (!ReadRecording(recording, recordingSize, source.get())) {
+		return false;
+	}
+	*result = PenFilterBenchmark();
+
+	std::vector<MoveSample> samples;
+	CollectStrokes(*source, StrokeKind::kPen, &samples);
+	if (samples.empty()) {
+		return true;
+	}
+
+	// Accuracy pass: compare where the output has got to against where the pen is.
+	PenFilter filter;
+	filter.Configure(config);
+	double gain = filter.GetConfig().gainPercent / 100.0;
+	POINT origin = { 0, };
+	POINT output = { 0, };
+	const MoveSample* previous = nullptr;
+	for (const MoveSample& sample : samples) {
+		if (sample.strokeStart) {
+			filter.Reset(sample.position, sample.time);
+			origin = output = sample.position;
+			previous = &sample;
+			++result->strokes;
+			continue;
+		}
+		POINT delta = filter.Next(sample.position, sample.time);
+		output.x += delta.x;
+		output.y += delta.y;
+		double targetX = origin.x + (sample.position.x - origin.x) * gain;
+		double targetY = origin.y + (sample.position.y - origin.y) * gain;
+		DWORD elapsed = sample.time - previous->time;
+		double moved = std::hypot((double) (sample.position.x - previous->position.x),
+			(double) (sample.position.y - previous->position.y)) * gain;
+		double speed = moved / (elapsed > 0 ? elapsed : 1);
+		previous = &sample;
+		if (speed < kPenMovingSpeed) {
+			continue;
+		}
+		double error = std::hypot(targetX - output.x, targetY - output.y);
+		double lag = error / speed;
+		++result->lagSamples;
+		result->errorTotalPx += error;
+		result->lagTotalMs += lag;
+		result->lagMaxMs = std::max(result->lagMaxMs, lag);
+	}
+	result->samples = samples.size();
+
+	// Timing pass, repeated so short recordings still give a stable figure.
+	uint64_t filtered = 0;
+	int64_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (filtered < kPenTimingSamples) {
+		for (const MoveSample& sample : samples) {
+			if (sample.strokeStart) {
+				filter.Reset(sample.position, sample.time);
+			} else {
+				POINT delta = filter.Next(sample.position, sample.time);
+				sink += delta.x + delta.y;
+			}
+		}
+		filtered += samples.size();
+	}
+	double nanos = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	// Keep the timed work observable.
+	result->nanosPerSample = sink == INT64_MIN ? 0 : nanos / filtered;
+	return true;
+}
+
+bool BenchmarkMotionPredictor(const void* recording, size_t recordingSize, int leadMs,
+		MotionPredictionBenchmark* result) {
+	std::unique_ptr<Recording> source(new Recording());
+	if (!ReadRecording(recording, recordingSize, source.get())) {
+		return false;
+	}
+	*result = MotionPredictionBenchmark();
+	std::vector<MoveSample> samples;
+	CollectStrokes(*source, StrokeKind::kDrag, &samples);
+
+	MotionPredictor predictor;
+	predictor.SetLead(leadMs);
+	leadMs = predictor.Lead();
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const MoveSample& sample = samples[i];
+		if (sample.strokeStart) {
+			predictor.Reset();
+		}
+		predictor.AddSample(sample.position, sample.time);
+		POINT predicted = predictor.Predict();
+
+		// Where the drag really was leadMs later, between the two moves either side of then.
+		DWORD target = sample.time + (DWORD) leadMs;
+		size_t next = i + 1;
+		while (next < samples.size() && !samples[next].strokeStart && (int32_t) (samples[next].time - target) < 0) {
+			++next;
+		}
+		if (next >= samples.size() || samples[next].strokeStart) {
+			continue;
+		}
+		const MoveSample& before = samples[next - 1];
+		const MoveSample& after = samples[next];
+		DWORD span = after.time - before.time;
+		double t = span > 0 ? (double) (target - before.time) / span : 1.0;
+		double actualX = before.position.x + (after.position.x - before.position.x) * t;
+		double actualY = before.position.y + (after.position.y - before.position.y) * t;
+
+		double unpredicted = std::hypot(actualX - sample.position.x, actualY - sample.position.y);
+		if (unpredicted < kPredictionMinTravelPx) {
+			continue;
+		}
+		double error = std::hypot(actualX - predicted.x, actualY - predicted.y);
+		++result->samples;
+		result->predictedErrorTotalPx += error;
+		result->predictedErrorMaxPx = std::max(result->predictedErrorMaxPx, error);
+		result->unpredictedErrorTotalPx += unpredicted;
+		// The drag covered unpredicted pixels in leadMs; each pixel of error saved is that much time.
+		result->latencySavedTotalMs += (unpredicted - error) * leadMs / unpredicted;
+	}
+	return true;
+}
+
+} // namespace amm
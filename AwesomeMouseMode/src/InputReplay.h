@@ -0,0 +1,92 @@
+#pragma once
+
+#include "InputRecording.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace amm {
+
+// Offline analysis of input recordings: replay against golden decisions, and the filter and
+// predictor benchmarks. Built into the tools, not the hook.
+
+// A recording read back: its messages, each with the settings change and touch frames that went
+// with it.
+struct Recording {
+	struct Message {
+		RecordedMessage record;
+		int settingsChange = -1;  // Index into settingsChanges to apply to the window first, if any.
+		size_t touchBegin = 0;    // The message's frames in touchFrames.
+		int touchCount = 0;
+	};
+
+	RecordingHeader header;
+	bool hasSettings = false;   // From version 3. Before, only header.features is known.
+	RecordedSettings settings;  // If hasSettings, in effect for every window from the start.
+	std::vector<Message> messages;
+	std::vector<RecordedSettings> settingsChanges;
+	std::vector<TouchFrame> touchFrames;
+};
+
+// Returns false if the buffer isn't a recording this build understands. Records of kinds it doesn't
+// know are skipped.
+bool ReadRecording(const void* data, size_t size, Recording* recording);
+
+struct ReplayResult {
+	uint64_t messages = 0;
+	uint64_t mismatches = 0;
+	int64_t firstMismatch = -1;  // Index of the first message whose output differed.
+	double seconds = 0;          // Wall time for the whole replay, for throughput.
+
+	// Input-to-output latency of scrolling, in message time: from a wheel message Live hasn't yet
+	// seen any scroll for, to the first wheel message forwarded after it.
+	uint64_t scrollResponses = 0;
+	uint64_t scrollLatencyTotalMs = 0;
+	uint32_t scrollLatencyMaxMs = 0;
+};
+
+// Pushes a recording (typically a memory-mapped file) back through fresh InputTranslators, one per
+// window and set up with the recording's settings, changing them as the recording did, and compares each decision against golden,
+// which has the same format. Pass golden = nullptr to compare against the decisions stored in the
+// recording itself. If out is set, the replayed decisions are written there as a new recording,
+// ready to become the next golden file. Returns false if either buffer isn't a valid recording.
+bool ReplayRecording(const void* recording, size_t recordingSize, const void* golden, size_t goldenSize,
+	FILE* out, ReplayResult* result);
+
+struct PenFilterBenchmark {
+	uint64_t samples = 0;        // Pen moves filtered.
+	uint64_t strokes = 0;        // Runs of pen moves, split at clicks and pauses.
+	double nanosPerSample = 0;   // Cost of PenFilter::Next alone.
+
+	// How far the motion handed on trails the pen, while it is moving: the distance between them
+	// divided by the pen's speed.
+	uint64_t lagSamples = 0;
+	double lagTotalMs = 0;
+	double lagMaxMs = 0;
+	double errorTotalPx = 0;     // Distance between them, summed over lagSamples.
+};
+
+// Runs the pen moves in a recording through a PenFilter set up with config, timing it and measuring
+// how far its output lags the raw pen. Returns false if the buffer isn't a valid recording.
+bool BenchmarkPenFilter(const void* recording, size_t recordingSize, const PenFilter::Config& config,
+	PenFilterBenchmark* result);
+
+struct MotionPredictionBenchmark {
+	uint64_t samples = 0;          // Left-button drag moves whose future position the recording shows.
+	double predictedErrorTotalPx = 0;  // From each prediction to where the drag really was by then.
+	double predictedErrorMaxPx = 0;
+	double unpredictedErrorTotalPx = 0;  // The same, for the unpredicted position.
+	// Latency the prediction hid: the error it saved, divided by the drag's speed. Ideally close to
+	// the lead for smooth drags.
+	double latencySavedTotalMs = 0;
+};
+
+// Runs the left-button drags in a recording through a MotionPredictor leading by leadMs, and scores
+// each prediction against where the recording shows the drag was leadMs later. Returns false if
+// the buffer isn't a valid recording.
+bool BenchmarkMotionPredictor(const void* recording, size_t recordingSize, int leadMs,
+	MotionPredictionBenchmark* result);
+
+} // namespace amm
@@ -0,0 +1,847 @@
+#include "InputTranslator.h"
+
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace amm {
+
+namespace {
+
+// Constants affecting plugin behaviour. The on/off switches are kFeature* bits, so they can be
+// changed at runtime; see InputTranslator::SetFeatures.
+constexpr int kWheelXScaleNumerator = 2;
+constexpr int kWheelXScaleDenominator = 1;
+constexpr int kWheelYScaleNumerator = 4;
+constexpr int kWheelYScaleDenominator = 3;
+constexpr int kMinWheelDelta = 120; // Happens to be equal to WHEEL_DELTA, probably not by accident.
+
+// Gesture speeds in Signals() drop to zero after this long without input.
+constexpr DWORD kSignalIdleMs = 100;
+
+// The most zoom steps that fit in one TranslatedInput.
+constexpr int kMaxZoomSteps = (TranslatedInput::kMaxKeys - 2) / 2;
+
+inline SyntheticKey KeyEvent(int vk, bool keyUp) {
+	SyntheticKey key = { (WORD) vk, keyUp };
+	return key;
+}
+
+// What kFeatureCtrlShiftZ and kFeaturePlusKeyWithoutShift stand for.
+const char kCtrlShiftZRemap[] = "key Ctrl+Shift+Z => Shift:up Y Shift:down";
+// Allow zooming without needing to hold shift. Typing equals in a text field is left alone.
+const char kPlusKeyWithoutShiftRemap[] = "char = notext => +";
+
+template <uint32_t Features, uint32_t Feature>
+struct IsEnabled {
+	static constexpr bool value = (Features & Feature) != 0;
+};
+
+} // namespace
+
+OutputAction* TranslatedInput::Push(ActionType type) {
+	if (actionCount >= kMaxActions) {
+		return nullptr;
+	}
+	OutputAction& action = actions[actionCount++];
+	action = OutputAction();
+	action.type = type;
+	return &action;
+}
+
+OutputAction* TranslatedInput::Forward(UINT msg, WPARAM wParam, LPARAM lParam, bool isResult) {
+	OutputAction* action = Push(ActionType::kForward);
+	if (action) {
+		action->isResult = isResult;
+		action->msg = msg;
+		action->wParam = wParam;
+		action->lParam = lParam;
+	}
+	return action;
+}
+
+void TranslatedInput::SendKeys(const SyntheticKey* newKeys, int count) {
+	if (keyCount + count > kMaxKeys) {
+		return;
+	}
+	if (actionCount > 0 && actions[actionCount - 1].type == ActionType::kSendInput) {
+		std::copy(newKeys, newKeys + count, keys + keyCount);
+		keyCount += count;
+		actions[actionCount - 1].keyCount += count;
+		++mergedSendInputs;
+		return;
+	}
+	OutputAction* action = Push(ActionType::kSendInput);
+	if (!action) {
+		return;
+	}
+	action->keyBegin = keyCount;
+	action->keyCount = count;
+	std::copy(newKeys, newKeys + count, keys + keyCount);
+	keyCount += count;
+}
+
+void TranslatedInput::SetCursorPos(POINT point, bool clientSpace) {
+	OutputAction* action = Push(clientSpace ? ActionType::kSetCursorPosClient : ActionType::kSetCursorPos);
+	if (action) {
+		action->point = point;
+	}
+}
+
+void TranslatedInput::SetVirtualInput(BYTE keyState, POINT clientPoint) {
+	OutputAction* action = Push(ActionType::kSetVirtualInput);
+	if (action) {
+		action->wParam = keyState;
+		action->point = clientPoint;
+	}
+}
+
+void TranslatedInput::SetTimer(WPARAM timerId, int milliseconds) {
+	OutputAction* action = Push(ActionType::kSetTimer);
+	if (action) {
+		action->wParam = timerId;
+		action->lParam = milliseconds;
+	}
+}
+
+void TranslatedInput::KillTimer(WPARAM timerId) {
+	OutputAction* action = Push(ActionType::kKillTimer);
+	if (action) {
+		action->wParam = timerId;
+	}
+}
+
+// Every specialization of the message handler, indexed by feature bits.
+#define AMM_TRANSLATE_FN(n) &InputTranslator::TranslateWith<n>
+#define AMM_TRANSLATE_FN4(n) AMM_TRANSLATE_FN(n), AMM_TRANSLATE_FN(n + 1), AMM_TRANSLATE_FN(n + 2), AMM_TRANSLATE_FN(n + 3)
+#define AMM_TRANSLATE_FN16(n) AMM_TRANSLATE_FN4(n), AMM_TRANSLATE_FN4(n + 4), AMM_TRANSLATE_FN4(n + 8), AMM_TRANSLATE_FN4(n + 12)
+const InputTranslator::TranslateFn InputTranslator::kTranslateFns[kFeatureCombinations] = {
+	AMM_TRANSLATE_FN16(0), AMM_TRANSLATE_FN16(16), AMM_TRANSLATE_FN16(32), AMM_TRANSLATE_FN16(48),
+	AMM_TRANSLATE_FN16(64), AMM_TRANSLATE_FN16(80), AMM_TRANSLATE_FN16(96), AMM_TRANSLATE_FN16(112),
+};
+#undef AMM_TRANSLATE_FN16
+#undef AMM_TRANSLATE_FN4
+#undef AMM_TRANSLATE_FN
+static_assert(kFeatureCombinations == 128, "Update kTranslateFns to cover every feature combination");
+
+void CompileBuiltinKeyRemaps(KeyRemapTable* table) {
+	table->Compile(kCtrlShiftZRemap, kFeatureCtrlShiftZ);
+	table->Compile(kPlusKeyWithoutShiftRemap, kFeaturePlusKeyWithoutShift);
+}
+
+InputTranslator::InputTranslator()
+	: translate_(kTranslateFns[kDefaultFeatures & kSpecializedFeatures]),
+	  features_(kDefaultFeatures) {
+	CompileBuiltinKeyRemaps(&remap_);
+}
+
+void InputTranslator::SetFeatures(uint32_t features) {
+	features &= kAllFeatures;
+	features_.store(features, std::memory_order_relaxed);
+	translate_.store(kTranslateFns[features & kSpecializedFeatures], std::memory_order_release);
+}
+
+template <uint32_t Features>
+void InputTranslator::TranslateWith(InputTranslator& self, const InputMessage& in, TranslatedInput* out) {
+	self.TranslateMessage<Features>(in, out);
+}
+
+void InputTranslator::Translate(const InputMessage& in, TranslatedInput* out) {
+	translate_.load(std::memory_order_acquire)(*this, in, out);
+	for (int i = 0; i < out->actionCount; ++i) {
+		if (out->actions[i].type == ActionType::kSendInput) {
+			++stats_.sendInputCalls;
+		}
+	}
+	stats_.syntheticEvents += out->keyCount;
+	stats_.sendInputCallsSaved += out->mergedSendInputs;
+}
+
+// Handle one message forwarded from a window we're hooked into. This lets us override what Live
+// sees and change behaviour.
+template <uint32_t Features>
+void InputTranslator::TranslateMessage(const InputMessage& in, TranslatedInput* out) {
+	constexpr bool kEnableDigitizerFix = IsEnabled<Features, kFeatureDigitizerFix>::value;
+	constexpr bool kEnableTouchPanGesture = IsEnabled<Features, kFeatureTouchPanGesture>::value;
+	UINT msg = in.msg;
+	WPARAM wParam = in.wParam;
+	LPARAM lParam = in.lParam;
+
+	switch (msg) {
+	case WM_LBUTTONDOWN:
+		// Any click stops a coasting pan dead.
+		CancelPanInertia(out);
+		// Clicks land exactly where they happened; prediction starts afresh with the drag.
+		predictor_.Reset();
+		if (kEnableDigitizerFix) {
+			POINT mpos = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
+			bool isPenEvent = IS_PEN_EVENT(in.ExtraInfo());
+			if (isPenEvent) {
+				Trace(TraceEvent::kButtonDown, mpos.x, mpos.y);
+				hadDigitizerClick_ = true;
+				hadDigitizerEvent_ = true;
+				dragPenDown_ = true;
+				// The stroke starts from the last hover position, like the raw deltas always have.
+				penFilter_.Reset(dragPrevDigitizerPoint_, in.time);
+			} else {
+				dragPenDown_ = false;
+			}
+			dragDown_ = true;
+			dragDownPoint_ = mpos;
+			wasDigitizerClick_ = false;
+			dragDigitizerDelta_.x = 0;
+			dragDigitizerDelta_.y = 0;
+		}
+		break;
+	case WM_LBUTTONUP:
+		predictor_.Reset();
+		dragDown_ = false;
+		dragPenDown_ = false;
+		break;
+	case WM_LBUTTONDBLCLK:
+		if (kEnableDigitizerFix) {
+			bool isPenEvent = IS_PEN_EVENT(in.ExtraInfo());
+			if (isPenEvent) {
+				// _TODO_ Initial fix for jumping around when Windows thinks we double clicked (but still broken).
+				Trace(TraceEvent::kDoubleClickReset, dragPrevDigitizerPoint_.x, dragPrevDigitizerPoint_.y);
+				lParam = MAKELONG((short) dragPrevDigitizerPoint_.x, (short) dragPrevDigitizerPoint_.y);
+				hadDoubleClick_ = 3;
+			}
+		}
+		break;
+	case WM_MOUSEMOVE:
+		if (!HandleMouseMove<Features>(in, &lParam, out)) {
+			return;
+		}
+		if (this->Features() & kFeatureMotionPrediction) {
+			PredictMove(in, &lParam);
+		}
+		break;
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:
+		if (remap_.HasKeyRules((WORD) wParam) && HandleKeyDown(in, out)) {
+			return;
+		}
+		break;
+
+	case WM_CHAR:
+		if (remap_.HasCharRules(wParam) && HandleChar(in, &wParam)) {
+			return;
+		}
+		break;
+
+	case WM_GESTURENOTIFY:
+		if (kEnableTouchPanGesture) {
+			out->Push(ActionType::kConfigurePanGesture);
+		}
+		break;
+
+	case WM_GESTURE:
+		if (HandleGesture<Features>(in, out)) {
+			return;
+		}
+		break;
+
+	case WM_POINTERDOWN:
+	case WM_POINTERUPDATE:
+	case WM_POINTERUP:
+		if (msg == WM_POINTERDOWN) {
+			// As does a new touch, before Windows has decided what it is.
+			CancelPanInertia(out);
+		}
+		if (HandlePointer(in, out)) {
+			return;
+		}
+		break;
+
+	case WM_MOUSEWHEEL:
+		TrackScrollRate(GET_WHEEL_DELTA_WPARAM(wParam), in.time);
+		if (!HandleMouseWheel<Features>(in, &wParam, out)) {
+			return;
+		}
+		break;
+	case WM_MOUSEHWHEEL:
+		TrackScrollRate(GET_WHEEL_DELTA_WPARAM(wParam), in.time);
+		if (HandleMouseHWheel<Features>(in, out)) {
+			return;
+		}
+		break;
+
+	case WM_TIMER:
+		if (wParam == kZoomFrameTimerId) {
+			// Our own timer; Live never needs to see it.
+			TickZoomFrame(in, out);
+			return;
+		}
+		if (wParam == kScrollFrameTimerId) {
+			TickScrollFrame(in, out);
+			return;
+		}
+		if (wParam == kPanInertiaTimerId) {
+			TickPanInertia(in, out);
+			return;
+		}
+		break;
+	}
+
+	// Forward the message.
+	OutputAction* forward = out->Forward(msg, wParam, lParam, true);
+	if (forward && msg == WM_MOUSEMOVE) {
+		// Moves we rewrote, and moves while Live hides the cursor (it measures drags from each one,
+		// then warps the cursor back), must all be seen. Anything else only matters as the latest
+		// position. Our own state has already been updated either way.
+		forward->coalescable = out->actionCount == 1 && lParam == in.lParam && in.CursorShown();
+	}
+}
+
+// Returns false if the move was consumed.
+template <uint32_t Features>
+bool InputTranslator::HandleMouseMove(const InputMessage& in, LPARAM* lParamInOut, TranslatedInput* out) {
+	constexpr bool kEnableDigitizerFix = IsEnabled<Features, kFeatureDigitizerFix>::value;
+	constexpr bool kEnableTouchPanGesture = IsEnabled<Features, kFeatureTouchPanGesture>::value;
+	WPARAM wParam = in.wParam;
+	LPARAM lParam = *lParamInOut;
+	if (kEnableTouchPanGesture) {
+		if (!inPanGesture_ && panGestureDown_) {
+			// Cancel pan because the mouse is moving.
+			panGestureDown_ = false;
+			Trace(TraceEvent::kPanForceUp);
+			EmitPanGestureUp(panGestureLastPos_, out);
+			return false;
+		} else if (panGestureDown_ && !panGestureInInertia_ && !(panGestureLastPos_.x == GET_X_LPARAM(lParam) && panGestureLastPos_.y == GET_Y_LPARAM(lParam))) {
+			// The mouse moved while panning. Ignore it.
+			return false;
+		} else {
+			// We get one WM_MOUSEMOVE event just after the gesture begins. We need to treat it as a
+			// non-mouse event, and skip canceling the pan.
+			inPanGesture_ = false;
+			if (!panGestureDown_) {
+				panGestureBestRealPos_ = in.CursorPos();
+			}
+		}
+	}
+	if (kEnableDigitizerFix) {
+		bool cursorShown = in.CursorShown();
+		int mx = GET_X_LPARAM(lParam);
+		int my = GET_Y_LPARAM(lParam);
+		bool isPenEvent = IS_PEN_EVENT(in.ExtraInfo());
+		bool isDoubleClick = hadDoubleClick_ > 0;
+		if (isDoubleClick) {
+			hadDoubleClick_--;
+		}
+		Trace(TraceEvent::kMouseMove, mx, my, cursorShown, isPenEvent);
+		if (!cursorShown) {
+			bool isCtrlOrShift = (wParam & MK_CONTROL) || (wParam & MK_SHIFT);
+			bool isErrantEvent = isPenEvent && hadDigitizerEvent_ && mx == dragDownPoint_.x && my == dragDownPoint_.y;
+			if (isPenEvent && !isErrantEvent) {
+				bool wasAcknowledged = !hadDigitizerEvent_;
+				hadDigitizerEvent_ = true;
+				wasDigitizerClick_ = true;
+				if (isCtrlOrShift && !wasAcknowledged) {
+					Trace(TraceEvent::kDigitizerHold, dragDownPoint_.x, dragDownPoint_.y, 0);
+					*lParamInOut = MAKELONG((short) dragDownPoint_.x, (short) dragDownPoint_.y);
+					return true;
+				}
+				POINT delta = penFilter_.Next({ mx, my }, in.time);
+				dragPrevDigitizerPoint_.x = mx;
+				dragPrevDigitizerPoint_.y = my;
+				dragDigitizerDelta_.x += delta.x;
+				dragDigitizerDelta_.y += delta.y;
+				int targetDX = dragDigitizerDelta_.x;
+				int targetDY = dragDigitizerDelta_.y;
+				// Until Live catches up with the last move, keep accumulating small motion rather
+				// than have it land on top of the move Live is still handling.
+				int deadZone = penFilter_.GetConfig().deadZone;
+				bool smallDelta = std::abs(targetDX) < deadZone && std::abs(targetDY) < deadZone;
+				if (!wasAcknowledged && smallDelta) {
+					Trace(TraceEvent::kDigitizerHold, dragDownPoint_.x, dragDownPoint_.y, 1);
+					*lParamInOut = MAKELONG((short) dragDownPoint_.x, (short) dragDownPoint_.y);
+					return true;
+				}
+				int targetX = dragDownPoint_.x + targetDX;
+				int targetY = dragDownPoint_.y + targetDY;
+				// Tell Live the mouse moved a small distance from where the button was originally pressed.
+				Trace(TraceEvent::kDigitizerMove, dragDownPoint_.x, dragDownPoint_.y, targetDX, targetDY);
+				lParam = MAKELONG((short) targetX, (short) targetY);
+				dragDigitizerDelta_.x = 0;
+				dragDigitizerDelta_.y = 0;
+			} else {
+				if (hadDigitizerEvent_ || dragPenDown_) {
+					Trace(TraceEvent::kDigitizerReset, dragDownPoint_.x, dragDownPoint_.y, isErrantEvent);
+					if (hadDigitizerClick_) {
+						// Record the location Live thinks the mouse button was pressed.
+						hadDigitizerClick_ = false;
+						dragDownPoint_.x = mx;
+						dragDownPoint_.y = my;
+					}
+					// Live has acknowledged the mouse move, and forced the cursor back to where
+					// it thinks the button went down. That means we can reset our running
+					// delta.
+					if (isCtrlOrShift) {
+						dragDigitizerDelta_.x = 0;
+						dragDigitizerDelta_.y = 0;
+						lParam = MAKELONG((short) dragDownPoint_.x, (short) dragDownPoint_.y);
+					}
+					hadDigitizerEvent_ = false;
+				}
+			}
+		} else {
+			if (isPenEvent) {
+				if (!isDoubleClick) {
+					dragPrevDigitizerPoint_.x = mx;
+					dragPrevDigitizerPoint_.y = my;
+					penFilter_.Reset(dragPrevDigitizerPoint_, in.time);
+				}
+			}
+		}
+	}
+	*lParamInOut = lParam;
+	return true;
+}
+
+// With kFeatureMotionPrediction, shows Live a left-button drag where it is about to be rather than
+// where it was. Only moves that would otherwise be forwarded untouched are led: ones we rewrote,
+// and drags under a hidden cursor (which Live measures from where it warped the cursor to), must
+// stay exact.
+void InputTranslator::PredictMove(const InputMessage& in, LPARAM* lParam) {
+	if (!(in.wParam & MK_LBUTTON) || *lParam != in.lParam || panGestureDown_ || !in.CursorShown()) {
+		predictor_.Reset();
+		return;
+	}
+	predictor_.AddSample({ GET_X_LPARAM(in.lParam), GET_Y_LPARAM(in.lParam) }, in.time);
+	POINT predicted = predictor_.Predict();
+	*lParam = MAKELONG((short) predicted.x, (short) predicted.y);
+}
+
+GestureSignals InputTranslator::Signals(DWORD time) const {
+	GestureSignals signals;
+	signals.panSpeed = time - panSpeedTime_ < kSignalIdleMs ? panSpeed_ : 0;
+	signals.pinchScale = pinchScale_;
+	signals.scrollRate = time - scrollRateTime_ < kSignalIdleMs ? scrollRate_ : 0;
+	return signals;
+}
+
+// Smoothed pan speed, for Signals().
+void InputTranslator::TrackPanSpeed(POINT location, DWORD time, bool begin) {
+	DWORD elapsed = time - panSpeedTime_;
+	if (!begin && elapsed > 0) {
+		double dx = location.x - panSpeedPos_.x;
+		double dy = location.y - panSpeedPos_.y;
+		float sample = (float) (std::sqrt(dx * dx + dy * dy) * 1000.0 / elapsed);
+		panSpeed_ += (sample - panSpeed_) / 4;
+	} else if (begin) {
+		panSpeed_ = 0;
+	}
+	panSpeedPos_ = location;
+	panSpeedTime_ = time;
+}
+
+// Smoothed scroll rate, for Signals(). Restarts from the first notch after a pause.
+void InputTranslator::TrackScrollRate(int delta, DWORD time) {
+	DWORD elapsed = time - scrollRateTime_;
+	float sample = (float) std::abs(delta) * 1000.0f / (elapsed < kSignalIdleMs ? std::max<DWORD>(elapsed, 1) : kScrollFrameMs);
+	scrollRate_ = elapsed < kSignalIdleMs ? scrollRate_ + (sample - scrollRate_) / 4 : sample;
+	scrollRateTime_ = time;
+}
+
+// Returns true if the key was consumed. Only called for keys with rules, so the modifier query and
+// the (rarer) text entry query are only made when they can change the outcome.
+bool InputTranslator::HandleKeyDown(const InputMessage& in, TranslatedInput* out) {
+	WORD vk = (WORD) in.wParam;
+	BYTE modifiers = in.KeyState();
+	bool inText = remap_.DependsOnContext(vk, modifiers) && in.TextEntry();
+	const RemapRule* rule = remap_.FindKey(vk, modifiers, inText);
+	if (!rule || (rule->feature && !(Features() & rule->feature))) {
+		return false;
+	}
+	SyntheticKey keys[RemapRule::kMaxKeys];
+	for (int i = 0; i < rule->keyCount; ++i) {
+		keys[i] = KeyEvent(rule->keys[i].vk, rule->keys[i].keyUp);
+	}
+	out->SendKeys(keys, rule->keyCount);
+	return rule->consume;
+}
+
+// Returns true if the character was consumed, otherwise leaves the one to forward in wParam.
+bool InputTranslator::HandleChar(const InputMessage& in, WPARAM* wParam) {
+	bool inText = remap_.CharDependsOnContext(in.wParam) && in.TextEntry();
+	const RemapRule* rule = remap_.FindChar(in.wParam, inText);
+	if (!rule || (rule->feature && !(Features() & rule->feature))) {
+		return false;
+	}
+	if (rule->consume) {
+		return true;
+	}
+	*wParam = rule->outputChar;
+	return false;
+}
+
+// Returns true if the gesture was consumed.
+template <uint32_t Features>
+bool InputTranslator::HandleGesture(const InputMessage& in, TranslatedInput* out) {
+	constexpr bool kEnableTouchPanGesture = IsEnabled<Features, kFeatureTouchPanGesture>::value;
+	if (!kEnableTouchPanGesture || !in.hasGesture || in.gestureId != GID_PAN) {
+		return false;
+	}
+	DWORD flags = in.gestureFlags;
+	POINT location = in.gestureLocation;
+	Trace(TraceEvent::kPanGesture, (int32_t) flags, (int32_t) in.gestureArguments, location.x, location.y);
+	EmitPanGesture(flags, location, in.time, out);
+	out->Push(ActionType::kCloseGestureInfo);
+	return true;
+}
+
+// Returns true if the pointer message was consumed by the multi-touch recognizer. Single contacts
+// go to Live as usual; once two are down, their frames are ours until the gesture ends.
+bool InputTranslator::HandlePointer(const InputMessage& in, TranslatedInput* out) {
+	if (!(Features() & kFeatureMultiTouch) || in.touchFrameCount <= 0) {
+		return false;
+	}
+	bool wasEngaged = touch_.Engaged();
+	TouchGesture gesture = touch_.Process(in.touchFrames, in.touchFrameCount);
+	if (gesture.panning) {
+		Trace(TraceEvent::kTouchGesture, (int32_t) gesture.panFlags, touch_.ActiveCount(), gesture.panLocation.x, gesture.panLocation.y);
+		EmitPanGesture(gesture.panFlags, gesture.panLocation, in.time, out);
+	}
+	if (gesture.zoomSteps != 0) {
+		QueueZoom(in, gesture.zoomSteps * WHEEL_DELTA, out);
+	}
+	if (gesture.pinchScale > 0) {
+		pinchScale_ = gesture.pinchScale;
+	} else if (!touch_.Engaged()) {
+		pinchScale_ = 1;
+	}
+	if (gesture.recognitionMs >= 0) {
+		++stats_.touchGestures;
+	}
+	return wasEngaged || touch_.Engaged();
+}
+
+// Fake a smooth pan by Ctrl+Alt clicking and dragging. Takes GID_PAN style flags and a location in
+// client space.
+//
+// Normally that means really pressing Ctrl+Alt and moving the cursor to the pan. With
+// kFeatureVirtualPan, Live is told instead: the modifiers through the messages' MK flags and our
+// answers to its key state queries, and the position through the messages and our answers to its
+// cursor queries. The real cursor and keyboard are never touched, so there's nothing to undo.
+//
+// With kFeaturePanInertia, Windows' GF_INERTIA frames are ignored and the pan coasts under
+// PanInertia instead, from the first inertia frame or from GF_END, whichever comes first.
+void InputTranslator::EmitPanGesture(DWORD flags, POINT location, DWORD time, TranslatedInput* out) {
+	bool ownInertia = (Features() & kFeaturePanInertia) != 0;
+	if (ownInertia && !(flags & GF_BEGIN) && (inertia_.Coasting() || (flags & GF_INERTIA))) {
+		if (flags == 0) {
+			// A new touch while coasting, which Windows reports as a bare update. Restart the pan
+			// from it below.
+			StopPanInertia(out);
+		} else {
+			if (!inertia_.Coasting() && panGestureDown_ && !StartPanInertia(time, out)) {
+				// Released too slowly to coast.
+				panGestureDown_ = false;
+				panGestureInInertia_ = false;
+				EmitPanGestureUp(panGestureLastPos_, out);
+			}
+			return;
+		}
+	}
+	bool restartedGesture = panGestureInInertia_ && flags == 0;
+	if (restartedGesture || (flags & GF_BEGIN)) {
+		StopPanInertia(out);
+		inertia_.Reset();
+		inertia_.AddSample(location, time);
+		TrackPanSpeed(location, time, true);
+		// Cancel our current Ctrl+Alt click if it was already down.
+		if (panGestureDown_) {
+			out->Forward(WM_LBUTTONUP, 0, MAKELONG(panGestureLastPos_.x, panGestureLastPos_.y));
+		}
+		// Simulate a Ctrl+Alt click. The mode is fixed for the whole gesture, so there's always the
+		// right thing to undo.
+		panGestureVirtual_ = (Features() & kFeatureVirtualPan) != 0;
+		inPanGesture_ = true;
+		panGestureDown_ = true;
+		panGestureInInertia_ = false;
+		if (panGestureVirtual_) {
+			out->SetVirtualInput(kKeyStateControl | kKeyStateAlt, location);
+			out->Forward(WM_MOUSEMOVE, MK_CONTROL, MAKELONG(location.x, location.y));
+			out->Forward(WM_LBUTTONDOWN, MK_LBUTTON | MK_CONTROL, MAKELONG(location.x, location.y));
+			// Live only looks at the modifiers as the button goes down.
+			out->SetVirtualInput(0, location);
+		} else {
+			{
+				SyntheticKey keys[] = {
+					KeyEvent(VK_CONTROL, false),
+					KeyEvent(VK_MENU, false),
+				};
+				out->SendKeys(keys, sizeof(keys) / sizeof(SyntheticKey));
+			}
+			out->SetCursorPos(location, true);
+			out->Forward(WM_MOUSEMOVE, 0, MAKELONG(location.x, location.y));
+			out->Forward(WM_LBUTTONDOWN, 0, MAKELONG(location.x, location.y));
+			{
+				SyntheticKey keys[] = {
+					KeyEvent(VK_CONTROL, true),
+					KeyEvent(VK_MENU, true),
+				};
+				out->SendKeys(keys, sizeof(keys) / sizeof(SyntheticKey));
+			}
+		}
+		panGestureLastPos_ = location;
+	}
+	if (flags & GF_INERTIA) {
+		panGestureInInertia_ = true;
+		inPanGesture_ = false;
+	}
+	if (flags & GF_END) {
+		// Cancel our current Ctrl+Alt click because the gesture is completely over, unless it's
+		// about to coast.
+		panGestureInInertia_ = false;
+		if (panGestureDown_) {
+			if (ownInertia) {
+				EmitPanMove(location, out);
+				inertia_.AddSample(location, time);
+				if (StartPanInertia(time, out)) {
+					return;
+				}
+			}
+			panGestureDown_ = false;
+			EmitPanGestureUp(location, out);
+		}
+	}
+
+	if (!(flags & GF_BEGIN) && panGestureDown_) {
+		EmitPanMove(location, out);
+		inertia_.AddSample(location, time);
+		TrackPanSpeed(location, time, false);
+	}
+}
+
+void InputTranslator::EmitPanMove(POINT location, TranslatedInput* out) {
+	if (panGestureVirtual_) {
+		out->SetVirtualInput(0, location);
+	}
+	out->Forward(WM_MOUSEMOVE, panGestureVirtual_ ? MK_LBUTTON : 0, MAKELONG(location.x, location.y));
+	panGestureLastPos_ = location;
+}
+
+bool InputTranslator::StartPanInertia(DWORD time, TranslatedInput* out) {
+	if (!inertia_.Start(time)) {
+		return false;
+	}
+	panGestureInInertia_ = true;
+	inPanGesture_ = false;
+	out->SetTimer(kPanInertiaTimerId, (int) kInertiaFrameMs);
+	return true;
+}
+
+// Move a coasting pan to where it should be now. Late timers just land further along the curve.
+void InputTranslator::TickPanInertia(const InputMessage& in, TranslatedInput* out) {
+	if (!inertia_.Coasting() || !panGestureDown_) {
+		inertia_.Stop();
+		out->KillTimer(kPanInertiaTimerId);
+		return;
+	}
+	POINT location;
+	bool moving = inertia_.PositionAt(in.time, &location);
+	EmitPanMove(location, out);
+	TrackPanSpeed(location, in.time, false);
+	if (!moving) {
+		StopPanInertia(out);
+		panGestureDown_ = false;
+		panGestureInInertia_ = false;
+		EmitPanGestureUp(location, out);
+	}
+}
+
+void InputTranslator::StopPanInertia(TranslatedInput* out) {
+	if (inertia_.Coasting()) {
+		inertia_.Stop();
+		out->KillTimer(kPanInertiaTimerId);
+	}
+}
+
+// Stop coasting and let go of the pan where it is.
+void InputTranslator::CancelPanInertia(TranslatedInput* out) {
+	if (!inertia_.Coasting()) {
+		return;
+	}
+	StopPanInertia(out);
+	if (panGestureDown_) {
+		panGestureDown_ = false;
+		panGestureInInertia_ = false;
+		EmitPanGestureUp(panGestureLastPos_, out);
+	}
+}
+
+// Release the emulated pan click at location, and put the cursor back where the user left it.
+void InputTranslator::EmitPanGestureUp(POINT location, TranslatedInput* out) {
+	panSpeed_ = 0;
+	out->Forward(WM_LBUTTONUP, 0, MAKELONG(location.x, location.y));
+	if (panGestureVirtual_) {
+		out->Push(ActionType::kClearVirtualInput);
+	} else {
+		out->SetCursorPos(panGestureBestRealPos_, false);
+	}
+}
+
+// Returns false if the wheel event was consumed.
+template <uint32_t Features>
+bool InputTranslator::HandleMouseWheel(const InputMessage& in, WPARAM* wParamInOut, TranslatedInput* out) {
+	constexpr bool kEnableTrackpadZoom = IsEnabled<Features, kFeatureTrackpadZoom>::value;
+	constexpr bool kEnableScrollingOverride = IsEnabled<Features, kFeatureScrollingOverride>::value;
+	constexpr bool kEnableSmoothScrolling = IsEnabled<Features, kFeatureSmoothScrolling>::value;
+	WPARAM wParam = in.wParam;
+	WORD loword = LOWORD(wParam);
+	if (kEnableTrackpadZoom && !in.inTrackpadScroll && (loword == MK_CONTROL)) {
+		// Either we got sent a touchpad zoom emulation event, or the user is scrolling while holding
+		// control. We can't tell the difference, so just assume it's a zoom event.
+		QueueZoom(in, GET_WHEEL_DELTA_WPARAM(wParam), out);
+		return false;
+	} if (kEnableScrollingOverride && kEnableSmoothScrolling) {
+		int delta = GET_WHEEL_DELTA_WPARAM(wParam);
+		scrollKeys_ = loword;
+		scrollLParam_ = in.lParam;
+		int outDelta = scrollY_.Add(ScrollAxis::Scale(delta, kWheelYScaleNumerator, kWheelYScaleDenominator), in.time);
+		StartScrollFrames(out);
+		if (outDelta == 0) {
+			return false;
+		}
+		*wParamInOut = MAKEWPARAM(loword, (short) outDelta);
+	} else if (kEnableScrollingOverride) {
+		int delta = GET_WHEEL_DELTA_WPARAM(wParam);
+		int outDelta = 0;
+		int deltaAcc = wheelDeltaAcc_.y;
+		deltaAcc += (delta * kWheelYScaleNumerator) / kWheelYScaleDenominator;
+		outDelta = (deltaAcc / kMinWheelDelta) * kMinWheelDelta;
+		wheelDeltaAcc_.y = deltaAcc - outDelta;
+
+		if (outDelta == 0) {
+			return false;
+		}
+		*wParamInOut = MAKEWPARAM(loword, (short) outDelta);
+	}
+	return true;
+}
+
+// Returns true if the horizontal wheel event was handled (and should not be forwarded as-is).
+template <uint32_t Features>
+bool InputTranslator::HandleMouseHWheel(const InputMessage& in, TranslatedInput* out) {
+	constexpr bool kEnableScrollingOverride = IsEnabled<Features, kFeatureScrollingOverride>::value;
+	constexpr bool kEnableSmoothScrolling = IsEnabled<Features, kFeatureSmoothScrolling>::value;
+	if (!kEnableScrollingOverride) {
+		return false;
+	}
+	int delta = GET_WHEEL_DELTA_WPARAM(in.wParam);
+	int outDelta = 0;
+	if (kEnableSmoothScrolling) {
+		scrollHLParam_ = in.lParam;
+		outDelta = scrollX_.Add(ScrollAxis::Scale(delta, -kWheelXScaleNumerator, kWheelXScaleDenominator), in.time);
+		StartScrollFrames(out);
+	} else {
+		int deltaAcc = wheelDeltaAcc_.x;
+		deltaAcc += (delta * -kWheelXScaleNumerator) / kWheelXScaleDenominator;
+		outDelta = (deltaAcc / kMinWheelDelta) * kMinWheelDelta;
+		wheelDeltaAcc_.x = deltaAcc - outDelta;
+	}
+
+	if (outDelta == 0) {
+		return true;
+	}
+	EmitHorizontalScroll(outDelta, in.lParam, true, out);
+	return true;
+}
+
+// Live scrolls horizontally on Ctrl+wheel, so hold Ctrl around a forwarded vertical wheel message,
+// marked so a hooked Ctrl+wheel doesn't mistake it for a trackpad zoom.
+void InputTranslator::EmitHorizontalScroll(int delta, LPARAM lParam, bool isResult, TranslatedInput* out) {
+	{
+		SyntheticKey keys[] = {
+			KeyEvent(VK_CONTROL, false),
+		};
+		out->SendKeys(keys, sizeof(keys) / sizeof(SyntheticKey));
+	}
+	OutputAction* scroll = out->Forward(WM_MOUSEWHEEL, MAKEWPARAM(MK_CONTROL, (short) delta), lParam, isResult);
+	if (scroll) {
+		scroll->trackpadScroll = true;
+	}
+	{
+		SyntheticKey keys[] = {
+			KeyEvent(VK_CONTROL, true),
+		};
+		out->SendKeys(keys, sizeof(keys) / sizeof(SyntheticKey));
+	}
+}
+
+void InputTranslator::StartScrollFrames(TranslatedInput* out) {
+	if (!scrollTimerSet_) {
+		scrollTimerSet_ = true;
+		out->SetTimer(kScrollFrameTimerId, (int) kScrollFrameMs);
+	}
+}
+
+// Hand Live this frame's share of any scroll in progress, and stop the frame timer once both axes
+// have gone quiet.
+void InputTranslator::TickScrollFrame(const InputMessage& in, TranslatedInput* out) {
+	int dy = scrollY_.Tick(in.time);
+	if (dy != 0) {
+		out->Forward(WM_MOUSEWHEEL, MAKEWPARAM(scrollKeys_, (short) dy), scrollLParam_);
+	}
+	int dx = scrollX_.Tick(in.time);
+	if (dx != 0) {
+		EmitHorizontalScroll(dx, scrollHLParam_, false, out);
+	}
+	if (!scrollX_.Active() && !scrollY_.Active()) {
+		out->KillTimer(kScrollFrameTimerId);
+		scrollTimerSet_ = false;
+	}
+}
+
+// Zoom input goes through the scheduler, which sends the first step of a gesture right away and
+// paces the rest on our frame timer.
+void InputTranslator::QueueZoom(const InputMessage& in, int delta, TranslatedInput* out) {
+	uint64_t reversed = zoom_.ReversedSteps();
+	uint64_t overflow = zoom_.OverflowSteps();
+	int steps = zoom_.Add(delta, in.time);
+	// A step is a key down and up that Live never has to see.
+	stats_.coalescedEvents += (zoom_.ReversedSteps() - reversed) * 2;
+	stats_.zoomStepsDropped += zoom_.OverflowSteps() - overflow;
+	if (steps != 0) {
+		EmitZoomSteps(steps, out);
+	}
+	if (zoom_.Active() && !zoomTimerSet_) {
+		zoomTimerSet_ = true;
+		out->SetTimer(kZoomFrameTimerId, kZoomFrameMs);
+	}
+}
+
+void InputTranslator::TickZoomFrame(const InputMessage& in, TranslatedInput* out) {
+	int steps = zoom_.Tick(in.time);
+	if (steps != 0) {
+		EmitZoomSteps(steps, out);
+	}
+	if (!zoom_.Active()) {
+		out->KillTimer(kZoomFrameTimerId);
+		zoomTimerSet_ = false;
+	}
+}
+
+// Send Live Ctrl+Plus or Ctrl+Minus once per step, with the user's own Ctrl released around it, all
+// in one SendInput batch.
+void InputTranslator::EmitZoomSteps(int steps, TranslatedInput* out) {
+	int deltas = std::min(std::abs(steps), kMaxZoomSteps);
+	int zoomVKey = steps > 0 ? VK_OEM_PLUS : VK_OEM_MINUS;
+	SyntheticKey keys[TranslatedInput::kMaxKeys];
+	int keyCount = 0;
+	keys[keyCount++] = KeyEvent(VK_CONTROL, true);
+	for (int i = 0 ; i < deltas; i++) {
+		keys[keyCount++] = KeyEvent(zoomVKey, false);
+		keys[keyCount++] = KeyEvent(zoomVKey, true);
+	}
+	keys[keyCount++] = KeyEvent(VK_CONTROL, false);
+	out->SendKeys(keys, keyCount);
+	// One call per step plus one for each Ctrl edge, had we sent them separately.
+	stats_.sendInputCallsSaved += deltas + 1;
+}
+
+} // namespace amm
@@ -0,0 +1,301 @@
+#pragma once
+
+#include "KeyRemap.h"
+#include "MotionPredictor.h"
+#include "PanInertia.h"
+#include "PenFilter.h"
+#include "ScrollEngine.h"
+#include "TouchRecognizer.h"
+#include "Win32Shim.h"
+#include "ZoomScheduler.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Good ol' Windows stuff.
+#define MI_WP_SIGNATURE 0xFF515700
+#define SIGNATURE_MASK 0xFFFFFF00
+#define IS_PEN_EVENT(dw) (((dw) & SIGNATURE_MASK) == MI_WP_SIGNATURE)
+
+namespace amm {
+
+// Optional behaviours. Every combination of the first kFeatureBits gets its own compiled
+// specialization of the message handler, so a disabled feature costs nothing per message yet can
+// still be switched at runtime. Features past those only affect messages off the hot path, and are
+// checked as they arrive instead of doubling the number of specializations.
+enum Feature : uint32_t {
+	kFeatureDigitizerFix = 1 << 0,
+	kFeatureTouchPanGesture = 1 << 1,
+	kFeatureTrackpadZoom = 1 << 2,
+	kFeatureScrollingOverride = 1 << 3,
+	kFeatureCtrlShiftZ = 1 << 4,
+	kFeaturePlusKeyWithoutShift = 1 << 5,
+	kFeatureSmoothScrolling = 1 << 6,  // Sub-notch, frame-paced scrolling. Needs ScrollingOverride.
+	kFeatureMultiTouch = 1 << 7,       // Two-finger pan and pinch from WM_POINTER. Not specialized.
+	kFeatureVirtualPan = 1 << 8,       // Pan without touching the real cursor or keyboard. Not specialized.
+	kFeaturePanInertia = 1 << 9,       // Our own frame-paced pan inertia instead of GF_INERTIA. Not specialized.
+	kFeatureMotionPrediction = 1 << 10,  // Lead drags ahead to hide Live's render latency. Not specialized.
+};
+constexpr int kFeatureBits = 7;
+constexpr uint32_t kFeatureCombinations = 1 << kFeatureBits;
+constexpr uint32_t kSpecializedFeatures = kFeatureCombinations - 1;
+constexpr uint32_t kAllFeatures = kSpecializedFeatures | kFeatureMultiTouch | kFeatureVirtualPan | kFeaturePanInertia |
+	kFeatureMotionPrediction;
+// The unspecialized features are opt-in until they have seen more hardware and Live versions.
+constexpr uint32_t kDefaultFeatures = kSpecializedFeatures;
+
+// Timer we set on hooked windows to pace zoom steps, running only while a zoom gesture is.
+constexpr WPARAM kZoomFrameTimerId = 0x414D4D01;
+// Timer that paces smooth scrolling, running only while a scroll gesture is.
+constexpr WPARAM kScrollFrameTimerId = 0x414D4D02;
+// Timer that moves a coasting pan, running only while one is.
+constexpr WPARAM kPanInertiaTimerId = 0x414D4D03;
+
+// Bits for InputMessage::present, one per lazily queried field.
+constexpr BYTE kInputExtraInfo = 0x01;
+constexpr BYTE kInputCursorShown = 0x02;
+constexpr BYTE kInputKeyState = 0x04;
+constexpr BYTE kInputCursorPos = 0x08;
+constexpr BYTE kInputTextEntry = 0x10;
+constexpr BYTE kInputAll = 0x1F;
+
+struct InputMessage;
+
+// Answers the queries that cost a system call, on demand. The Win32 adapter implements this over
+// user32; replays don't need one because every field is already present.
+class InputSource {
+public:
+	virtual void Fetch(const InputMessage& in, BYTE field) const = 0;
+};
+
+// Everything OurWndProc needs to know about a single message. The cheap parts are filled in up
+// front; the rest is a snapshot taken lazily, at most once per message, through the accessors.
+struct InputMessage {
+	UINT msg;
+	WPARAM wParam;
+	LPARAM lParam;
+	DWORD time;        // GetMessageTime(), in milliseconds.
+	bool inTrackpadScroll;  // We are inside a forwarded trackpad scroll (see OutputAction).
+
+	DWORD ExtraInfo() const { Need(kInputExtraInfo); return extraInfo; }
+	bool CursorShown() const { Need(kInputCursorShown); return cursorShown; }
+	BYTE KeyState() const { Need(kInputKeyState); return keyState; }
+	POINT CursorPos() const { Need(kInputCursorPos); return cursorPos; }
+	bool TextEntry() const { Need(kInputTextEntry); return textEntry; }
+	void Need(BYTE fields) const {
+		BYTE missing = fields & ~present;
+		if (missing && source) {
+			source->Fetch(*this, missing);
+		}
+	}
+
+	const InputSource* source;
+	mutable BYTE present;       // kInput* bits already filled in.
+	mutable DWORD extraInfo;    // GetMessageExtraInfo().
+	mutable bool cursorShown;   // GetCursorInfo() reported CURSOR_SHOWING.
+	mutable BYTE keyState;      // kKeyState* bits, from GetKeyState().
+	mutable POINT cursorPos;    // GetCursorPos(), in screen space.
+	mutable bool textEntry;     // Live is taking text: its thread has a caret.
+
+	// Decoded WM_GESTURE payload. Only meaningful if hasGesture is set.
+	bool hasGesture;
+	DWORD gestureId;
+	DWORD gestureFlags;
+	POINT gestureLocation;   // Client space, like everything the translator emits.
+	ULONGLONG gestureArguments;
+
+	// For touch WM_POINTER* messages: the message's whole pointer history, oldest first. Only set
+	// while kFeatureMultiTouch is on.
+	const TouchFrame* touchFrames;
+	int touchFrameCount;
+};
+
+// A single key press or release to hand to SendInput.
+struct SyntheticKey {
+	WORD vk;
+	bool keyUp;
+};
+
+enum class ActionType : BYTE {
+	kForward,              // CallWindowProc(oldWndProc, hwnd, msg, wParam, lParam).
+	kSendInput,            // SendInput(keys[keyBegin, keyBegin + keyCount)), as one batch.
+	kSetCursorPos,         // SetCursorPos(point), point in screen space.
+	kSetCursorPosClient,   // SetCursorPos(point), point in client space.
+	kConfigurePanGesture,  // SetGestureConfig to receive GID_PAN.
+	kCloseGestureInfo,     // CloseGestureInfoHandle on the incoming message's lParam.
+	kSetTimer,             // SetTimer(hwnd, wParam, lParam milliseconds).
+	kKillTimer,            // KillTimer(hwnd, wParam).
+	kSetVirtualInput,      // Answer Live's key state queries with wParam's kKeyState* bits held, and
+	                       // its cursor queries with point, in client space.
+	kClearVirtualInput,    // Back to the real keyboard and cursor.
+};
+
+struct OutputAction {
+	ActionType type;
+	bool isResult;  // For kForward: its return value becomes the return value of OurWndProc.
+	bool trackpadScroll;  // For kForward: report inTrackpadScroll while it runs.
+	bool coalescable;     // For kForward: a plain move Live may skip if a newer one is queued.
+	UINT msg;
+	WPARAM wParam;
+	LPARAM lParam;
+	POINT point;
+	int keyBegin;
+	int keyCount;
+};
+
+// The ordered side effects of handling one message. If no kForward action is marked isResult, the
+// message was consumed and OurWndProc returns 0.
+struct TranslatedInput {
+	static constexpr int kMaxActions = 16;
+	static constexpr int kMaxKeys = 64;
+
+	OutputAction actions[kMaxActions];
+	int actionCount = 0;
+	SyntheticKey keys[kMaxKeys];
+	int keyCount = 0;
+	int mergedSendInputs = 0;  // SendKeys calls folded into the preceding batch.
+
+	OutputAction* Forward(UINT msg, WPARAM wParam, LPARAM lParam, bool isResult = false);
+	// Back-to-back SendKeys calls are merged into a single SendInput batch.
+	void SendKeys(const SyntheticKey* keys, int count);
+	void SetTimer(WPARAM timerId, int milliseconds);
+	void KillTimer(WPARAM timerId);
+	void SetCursorPos(POINT point, bool clientSpace);
+	void SetVirtualInput(BYTE keyState, POINT clientPoint);
+	// Returns nullptr if the action list is full.
+	OutputAction* Push(ActionType type);
+};
+
+// Running totals for synthetic input, to see what batching and coalescing save us, and for the
+// gestures behind it.
+struct EmissionStats {
+	uint64_t syntheticEvents = 0;       // Key events handed to SendInput.
+	uint64_t sendInputCalls = 0;        // SendInput batches.
+	uint64_t sendInputCallsSaved = 0;   // Batches avoided by merging into a neighbour.
+	uint64_t coalescedEvents = 0;       // Key events dropped because opposing zoom steps cancelled.
+	uint64_t zoomStepsDropped = 0;      // Zoom steps past what the per-frame budget could keep up with.
+	uint64_t touchGestures = 0;         // Multi-touch pans and pinches recognized.
+};
+
+// How fast and how far gestures are going, for the plugin's automation parameters.
+struct GestureSignals {
+	float panSpeed = 0;     // Pixels per second.
+	float pinchScale = 1;   // Spread relative to where the pinch began.
+	float scrollRate = 0;   // Wheel units per second, either axis.
+};
+
+// Platform-neutral core of OurWndProc. Holds the digitizer, pan gesture, wheel and zoom state, and
+// turns each incoming message into the messages and synthetic input that should be emitted.
+class InputTranslator {
+public:
+	InputTranslator();
+
+	void Translate(const InputMessage& in, TranslatedInput* out);
+
+	// Installs the handler specialized for this set of kFeature* bits. A single pointer swap, so it
+	// is safe to call while messages are being handled.
+	void SetFeatures(uint32_t features);
+	uint32_t Features() const { return features_.load(std::memory_order_relaxed); }
+
+	const EmissionStats& Stats() const { return stats_; }
+
+	// Gesture speeds as of time (ms). Speeds fall to zero once their gesture has gone quiet.
+	GestureSignals Signals(DWORD time) const;
+
+	// Friction for kFeaturePanInertia, per second.
+	void SetInertiaFriction(int perSecond) { inertia_.SetFriction(perSecond); }
+
+	// Smoothing, dead zone and gain for pen drags under kFeatureDigitizerFix.
+	void SetPenFilter(const PenFilter::Config& config) { penFilter_.Configure(config); }
+
+	// The most zoom steps Live is sent per frame under kFeatureTrackpadZoom and pinches.
+	void SetZoomBudget(int stepsPerFrame) { zoom_.SetBudget(stepsPerFrame); }
+
+	// How far ahead kFeatureMotionPrediction leads drags, in milliseconds.
+	void SetPredictionLead(int milliseconds) { predictor_.SetLead(milliseconds); }
+
+	// Key and character remaps. Rules tagged with a kFeature* bit only apply while it is on.
+	void SetKeyRemap(const KeyRemapTable& remap) { remap_ = remap; }
+
+private:
+	typedef void (*TranslateFn)(InputTranslator& self, const InputMessage& in, TranslatedInput* out);
+	static const TranslateFn kTranslateFns[kFeatureCombinations];
+
+	template <uint32_t Features>
+	static void TranslateWith(InputTranslator& self, const InputMessage& in, TranslatedInput* out);
+	template <uint32_t Features>
+	void TranslateMessage(const InputMessage& in, TranslatedInput* out);
+	template <uint32_t Features>
+	bool HandleMouseMove(const InputMessage& in, LPARAM* lParam, TranslatedInput* out);
+	template <uint32_t Features>
+	bool HandleGesture(const InputMessage& in, TranslatedInput* out);
+	void PredictMove(const InputMessage& in, LPARAM* lParam);
+	bool HandleKeyDown(const InputMessage& in, TranslatedInput* out);
+	bool HandleChar(const InputMessage& in, WPARAM* wParam);
+	bool HandlePointer(const InputMessage& in, TranslatedInput* out);
+	void EmitPanGesture(DWORD flags, POINT location, DWORD time, TranslatedInput* out);
+	void EmitPanMove(POINT location, TranslatedInput* out);
+	void TrackPanSpeed(POINT location, DWORD time, bool begin);
+	void TrackScrollRate(int delta, DWORD time);
+	bool StartPanInertia(DWORD time, TranslatedInput* out);
+	void StopPanInertia(TranslatedInput* out);
+	void TickPanInertia(const InputMessage& in, TranslatedInput* out);
+	void CancelPanInertia(TranslatedInput* out);
+	void EmitPanGestureUp(POINT location, TranslatedInput* out);
+	template <uint32_t Features>
+	bool HandleMouseWheel(const InputMessage& in, WPARAM* wParam, TranslatedInput* out);
+	template <uint32_t Features>
+	bool HandleMouseHWheel(const InputMessage& in, TranslatedInput* out);
+	void StartScrollFrames(TranslatedInput* out);
+	void TickScrollFrame(const InputMessage& in, TranslatedInput* out);
+	void EmitHorizontalScroll(int delta, LPARAM lParam, bool isResult, TranslatedInput* out);
+	void QueueZoom(const InputMessage& in, int delta, TranslatedInput* out);
+	void TickZoomFrame(const InputMessage& in, TranslatedInput* out);
+	void EmitZoomSteps(int steps, TranslatedInput* out);
+
+	bool dragDown_ = false;
+	bool dragPenDown_ = false;
+	POINT dragDownPoint_ = { 0, };
+	POINT dragPrevDigitizerPoint_ = { 0, };
+	POINT dragDigitizerDelta_ = { 0, };
+	PenFilter penFilter_;
+	MotionPredictor predictor_;
+	KeyRemapTable remap_;
+	bool hadDigitizerEvent_ = false;
+	bool wasDigitizerClick_ = false;
+	bool hadDigitizerClick_ = false;
+	int hadDoubleClick_ = 0;
+	POINT wheelDeltaAcc_ = { 0, };
+	ScrollAxis scrollX_;
+	ScrollAxis scrollY_;
+	WORD scrollKeys_ = 0;        // MK_* flags of the last vertical wheel message.
+	LPARAM scrollLParam_ = 0;    // Cursor position of the last vertical wheel message.
+	LPARAM scrollHLParam_ = 0;   // And of the last horizontal one.
+	bool scrollTimerSet_ = false;
+	ZoomScheduler zoom_;
+	bool zoomTimerSet_ = false;
+	// For Signals().
+	float panSpeed_ = 0;
+	POINT panSpeedPos_ = { 0, };
+	DWORD panSpeedTime_ = 0;
+	float pinchScale_ = 1;
+	float scrollRate_ = 0;
+	DWORD scrollRateTime_ = 0;
+	bool inPanGesture_ = false;
+	bool panGestureDown_ = false;
+	bool panGestureInInertia_ = false;
+	bool panGestureVirtual_ = false;
+	POINT panGestureLastPos_ = { 0, };
+	POINT panGestureBestRealPos_ = { 0, };
+	TouchRecognizer touch_;
+	PanInertia inertia_;
+	std::atomic<TranslateFn> translate_;
+	std::atomic<uint32_t> features_;
+	EmissionStats stats_;
+};
+
+// Starts table off with the rules behind kFeatureCtrlShiftZ and kFeaturePlusKeyWithoutShift, tagged
+// so they follow those bits. User rules compiled afterwards override them.
+void CompileBuiltinKeyRemaps(KeyRemapTable* table);
+
+} // namespace amm
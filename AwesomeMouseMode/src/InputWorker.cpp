@@ -0,0 +1,222 @@
+#include "stdafx.h"
+#include "InputWorker.h"
+
+#include "TraceRecorder.h"
+
+namespace amm {
+
+namespace {
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+// How long the worker lets input accumulate before emitting, so a burst of messages from one
+// message pump turn goes out in one SendInput. Skipped whenever the UI thread is waiting on us.
+constexpr LONGLONG kBatchWindow100ns = 5000;  // 0.5 ms.
+
+constexpr int kSpinsBeforeYield = 2000;
+
+uint64_t ReadPerformanceCounter() {
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	return (uint64_t) now.QuadPart;
+}
+
+} // namespace
+
+InputWorker::InputWorker() {
+	LARGE_INTEGER frequency;
+	if (::QueryPerformanceFrequency(&frequency) && frequency.QuadPart > 0) {
+		ticksPerSecond_ = (uint64_t) frequency.QuadPart;
+	}
+}
+
+bool InputWorker::Start(StatsBlock* stats) {
+	if (thread_) {
+		return true;
+	}
+	stats_ = stats;
+	if (!wake_) {
+		wake_ = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+	}
+	// High-resolution waitable timers need Windows 10 1803; fall back to a regular one, which is
+	// only as fine as the system timer resolution.
+	if (!timer_) {
+		timer_ = ::CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	}
+	if (!timer_) {
+		timer_ = ::CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}
+	if (!wake_ || !timer_) {
+		return false;
+	}
+
+	// The thread runs our code until the process exits, so we can never be unloaded under it.
+	HMODULE pinned = nullptr;
+	::GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_PIN,
+		(LPCWSTR) &InputWorker::ThreadProc, &pinned);
+
+	thread_ = ::CreateThread(nullptr, 0, &InputWorker::ThreadProc, this, 0, nullptr);
+	if (!thread_) {
+		return false;
+	}
+	::SetThreadPriority(thread_, THREAD_PRIORITY_ABOVE_NORMAL);
+	return true;
+}
+
+bool InputWorker::EnqueueKeys(const SyntheticKey* keys, int count) {
+	if (count <= 0) {
+		return true;
+	}
+	if (queue_.FreeSlots() < (size_t) count) {
+		return false;
+	}
+	uint64_t now = ReadPerformanceCounter();
+	uint64_t sequence = enqueued_.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; ++i) {
+		SyntheticInput item;
+		::memset(&item, 0, sizeof(item));
+		item.type = SyntheticInput::kKey;
+		item.vk = keys[i].vk;
+		item.keyUp = keys[i].keyUp;
+		item.endOfBatch = i == count - 1;
+		item.enqueueTicks = now;
+		item.sequence = ++sequence;
+		queue_.Push(item);
+	}
+	enqueued_.store(sequence, std::memory_order_release);
+	::SetEvent(wake_);
+	return true;
+}
+
+bool InputWorker::EnqueueCursor(POINT point) {
+	SyntheticInput item;
+	::memset(&item, 0, sizeof(item));
+	item.type = SyntheticInput::kCursor;
+	item.endOfBatch = true;
+	item.point = point;
+	item.enqueueTicks = ReadPerformanceCounter();
+	item.sequence = enqueued_.load(std::memory_order_relaxed) + 1;
+	if (!queue_.Push(item)) {
+		return false;
+	}
+	enqueued_.store(item.sequence, std::memory_order_release);
+	::SetEvent(wake_);
+	return true;
+}
+
+void InputWorker::WaitForEmitted() {
+	uint64_t enqueued = enqueued_.load(std::memory_order_acquire);
+	if (emitted_.load(std::memory_order_acquire) >= enqueued) {
+		return;
+	}
+	waiting_.fetch_add(1, std::memory_order_acq_rel);
+	::SetEvent(wake_);
+	for (int spins = 0; emitted_.load(std::memory_order_acquire) < enqueued; ++spins) {
+		if (spins < kSpinsBeforeYield) {
+			YieldProcessor();
+		} else {
+			::SwitchToThread();
+		}
+	}
+	waiting_.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+DWORD WINAPI InputWorker::ThreadProc(void* param) {
+	static_cast<InputWorker*>(param)->Run();
+	return 0;
+}
+
+void InputWorker::Run() {
+	if (stats_) {
+		threadStats_ = stats_->ForThread(::GetCurrentThreadId());
+	}
+	HANDLE handles[] = { wake_, timer_ };
+	for (;;) {
+		::WaitForSingleObject(wake_, INFINITE);
+		if (waiting_.load(std::memory_order_acquire) == 0) {
+			// Give the rest of this burst a moment to arrive. A thread waking us again
+			// (because it is now waiting) cuts this short.
+			LARGE_INTEGER due;
+			due.QuadPart = -kBatchWindow100ns;
+			if (::SetWaitableTimer(timer_, &due, 0, nullptr, nullptr, FALSE)) {
+				::WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+				::CancelWaitableTimer(timer_);
+			}
+		}
+		Drain();
+	}
+}
+
+// Emit everything queued, in order: runs of keys go out together in one SendInput, split only by
+// cursor warps.
+void InputWorker::Drain() {
+	INPUT inputs[kQueueCapacity];
+	int inputCount = 0;
+	int calls = 0;
+	int items = 0;
+	uint64_t oldestTicks = 0;
+	uint64_t lastSequence = 0;
+	uint64_t emitTicks = 0;
+
+	auto flushKeys = [&]() {
+		if (inputCount == 0) {
+			return;
+		}
+		uint64_t start = ReadPerformanceCounter();
+		::SendInput(inputCount, inputs, sizeof(INPUT));
+		emitTicks += ReadPerformanceCounter() - start;
+		++calls;
+		if (threadStats_) {
+			threadStats_->sendInputCalls.fetch_add(1, std::memory_order_relaxed);
+			threadStats_->sendInputEvents.fetch_add(inputCount, std::memory_order_relaxed);
+		}
+		inputCount = 0;
+	};
+
+	SyntheticInput item;
+	while (queue_.Pop(&item)) {
+		uint64_t now = ReadPerformanceCounter();
+		queueLatency_.Record(TicksToNanos(now - item.enqueueTicks));
+		if (items == 0) {
+			oldestTicks = now - item.enqueueTicks;
+		}
+		++items;
+		lastSequence = item.sequence;
+
+		if (item.type == SyntheticInput::kCursor) {
+			flushKeys();
+			uint64_t start = ReadPerformanceCounter();
+			::SetCursorPos(item.point.x, item.point.y);
+			emitTicks += ReadPerformanceCounter() - start;
+			++calls;
+			emitted_.store(lastSequence, std::memory_order_release);
+			continue;
+		}
+		INPUT& input = inputs[inputCount++];
+		::memset(&input, 0, sizeof(input));
+		input.type = INPUT_KEYBOARD;
+		input.ki.wVk = item.vk;
+		input.ki.dwFlags = item.keyUp ? KEYEVENTF_KEYUP : 0;
+		if (item.endOfBatch && inputCount > (int) kQueueCapacity - TranslatedInput::kMaxKeys) {
+			// No room for another whole batch; batches are never split across SendInput calls.
+			flushKeys();
+			emitted_.store(lastSequence, std::memory_order_release);
+		}
+	}
+	if (items == 0) {
+		return;
+	}
+	flushKeys();
+	emitted_.store(lastSequence, std::memory_order_release);
+	emitLatency_.Record(TicksToNanos(emitTicks));
+	Trace(TraceEvent::kSyntheticEmit, items, calls, (int32_t) (TicksToNanos(oldestTicks) / 1000),
+		(int32_t) (TicksToNanos(emitTicks) / 1000));
+}
+
+uint64_t InputWorker::TicksToNanos(uint64_t ticks) const {
+	return ticks / ticksPerSecond_ * 1000000000ull + ticks % ticksPerSecond_ * 1000000000ull / ticksPerSecond_;
+}
+
+} // namespace amm
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "InputTranslator.h"
+#include "LatencyHistogram.h"
+#include "LiveStats.h"
+#include "SpscQueue.h"
+
+namespace amm {
+
+// One unit of synthetic input for the worker. Keys are collected until an item with endOfBatch set,
+// then sent with a single SendInput, exactly as the synchronous path would have.
+struct SyntheticInput {
+	enum Type : uint8_t {
+		kKey,
+		kCursor,
+	};
+
+	Type type;
+	bool keyUp;
+	bool endOfBatch;
+	WORD vk;
+	POINT point;            // Screen coordinates, for kCursor.
+	uint64_t enqueueTicks;  // QueryPerformanceCounter() when queued.
+	uint64_t sequence;
+};
+
+// Emits SendInput and SetCursorPos on a dedicated thread, so Live's UI thread never waits on them.
+//
+// The queue is single-producer: only one thread may ever enqueue, and the caller picks which.
+// Items are emitted strictly in order. Because Live's handlers read key and cursor state when they
+// see a forwarded message, the hook calls WaitForEmitted() before forwarding anything while input
+// is still queued, whichever message queued it. That keeps the Ctrl+Alt pan emulation's
+// keys-then-warp-then-click order intact, and the key ups ending a pan ahead of the next click,
+// while the UI thread only waits when it has something to forward.
+class InputWorker {
+public:
+	static constexpr size_t kQueueCapacity = 256;
+
+	InputWorker();
+
+	// Starts the thread, which then runs for the rest of the process: it can't be joined from
+	// DllMain, so the module is pinned instead. The thread counts its SendInputs in stats, if set.
+	bool Start(StatsBlock* stats = nullptr);
+	bool Started() const { return thread_ != nullptr; }
+
+	// Producer only. Return false if the queue is full, in which case the caller should emit
+	// synchronously after WaitForEmitted().
+	bool EnqueueKeys(const SyntheticKey* keys, int count);
+	bool EnqueueCursor(POINT point);
+
+	// Any thread. Blocks until everything queued so far has been emitted.
+	void WaitForEmitted();
+
+	// Enqueue-to-emit latency of every item, and the time each drain spent in SendInput and
+	// SetCursorPos.
+	const LatencyHistogram& QueueLatency() const { return queueLatency_; }
+	const LatencyHistogram& EmitLatency() const { return emitLatency_; }
+
+private:
+	static DWORD WINAPI ThreadProc(void* param);
+	void Run();
+	void Drain();
+	uint64_t TicksToNanos(uint64_t ticks) const;
+
+	SpscQueue<SyntheticInput, kQueueCapacity> queue_;
+	HANDLE thread_ = nullptr;
+	HANDLE wake_ = nullptr;
+	HANDLE timer_ = nullptr;
+	StatsBlock* stats_ = nullptr;
+	StatsThread* threadStats_ = nullptr;  // The worker thread's own.
+	uint64_t ticksPerSecond_ = 1;
+	std::atomic<uint64_t> enqueued_{ 0 };  // Written by the producer only.
+	std::atomic<uint64_t> emitted_{ 0 };
+	std::atomic<int> waiting_{ 0 };  // Threads in WaitForEmitted().
+	LatencyHistogram queueLatency_;
+	LatencyHistogram emitLatency_;
+};
+
+} // namespace amm
@@ -0,0 +1,390 @@
+#include "KeyRemap.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace amm {
+
+namespace {
+
+struct KeyName {
+	const char* name;
+	WORD vk;
+};
+
+// Virtual key codes by name. Letters and digits are their own codes and F1-F24 are handled apart.
+const KeyName kKeyNames[] = {
+	{ "Ctrl", VK_CONTROL },
+	{ "Control", VK_CONTROL },
+	{ "Shift", VK_SHIFT },
+	{ "Alt", VK_MENU },
+	{ "Backspace", 0x08 },
+	{ "Tab", 0x09 },
+	{ "Enter", 0x0D },
+	{ "Return", 0x0D },
+	{ "Escape", 0x1B },
+	{ "Esc", 0x1B },
+	{ "Space", 0x20 },
+	{ "PageUp", 0x21 },
+	{ "PageDown", 0x22 },
+	{ "End", 0x23 },
+	{ "Home", 0x24 },
+	{ "Left", 0x25 },
+	{ "Up", 0x26 },
+	{ "Right", 0x27 },
+	{ "Down", 0x28 },
+	{ "Insert", 0x2D },
+	{ "Delete", 0x2E },
+	{ "Plus", VK_OEM_PLUS },
+	{ "Comma", 0xBC },
+	{ "Minus", VK_OEM_MINUS },
+	{ "Period", 0xBE },
+};
+
+struct Token {
+	const char* begin;
+	size_t length;
+};
+
+bool Equals(Token token, const char* text) {
+	size_t length = ::strlen(text);
+	if (token.length != length) {
+		return false;
+	}
+	for (size_t i = 0; i < length; ++i) {
+		char a = token.begin[i];
+		char b = text[i];
+		if (a >= 'a' && a <= 'z') {
+			a -= 'a' - 'A';
+		}
+		if (b >= 'a' && b <= 'z') {
+			b -= 'a' - 'A';
+		}
+		if (a != b) {
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool IsSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+// Splits off the next whitespace-separated token, or returns false at the end of the line.
+bool NextToken(const char** cursor, Token* token) {
+	const char* p = *cursor;
+	while (IsSpace(*p)) {
+		++p;
+	}
+	if (*p == '\0' || *p == '\n' || *p == '#') {
+		*cursor = p;
+		return false;
+	}
+	token->begin = p;
+	while (*p && *p != '\n' && !IsSpace(*p)) {
+		++p;
+	}
+	token->length = (size_t) (p - token->begin);
+	*cursor = p;
+	return true;
+}
+
+// 0x41 style codes, for anything without a name.
+bool ParseHex(Token token, unsigned limit, unsigned* value) {
+	if (token.length < 3 || token.length > 6 || token.begin[0] != '0' || (token.begin[1] != 'x' && token.begin[1] != 'X')) {
+		return false;
+	}
+	unsigned result = 0;
+	for (size_t i = 2; i < token.length; ++i) {
+		char c = token.begin[i];
+		unsigned digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			return false;
+		}
+		result = result * 16 + digit;
+	}
+	if (result == 0 || result > limit) {
+		return false;
+	}
+	*value = result;
+	return true;
+}
+
+bool ParseKey(Token token, WORD* vk) {
+	if (token.length == 1) {
+		char c = token.begin[0];
+		if (c >= 'a' && c <= 'z') {
+			c -= 'a' - 'A';
+		}
+		if ((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+			*vk = (WORD) c;
+			return true;
+		}
+	}
+	if ((token.begin[0] == 'F' || token.begin[0] == 'f') && token.length >= 2 && token.length <= 3) {
+		int number = 0;
+		for (size_t i = 1; i < token.length; ++i) {
+			if (token.begin[i] < '0' || token.begin[i] > '9') {
+				number = 0;
+				break;
+			}
+			number = number * 10 + (token.begin[i] - '0');
+		}
+		if (number >= 1 && number <= 24) {
+			*vk = (WORD) (0x70 + number - 1);
+			return true;
+		}
+	}
+	for (const KeyName& name : kKeyNames) {
+		if (Equals(token, name.name)) {
+			*vk = name.vk;
+			return true;
+		}
+	}
+	unsigned code;
+	if (ParseHex(token, 0xFE, &code)) {
+		*vk = (WORD) code;
+		return true;
+	}
+	return false;
+}
+
+// A single printable character, or a 0x3D style code.
+bool ParseChar(Token token, WORD* ch) {
+	unsigned code;
+	if (token.length == 1 && token.begin[0] > ' ' && token.begin[0] < 0x7F) {
+		*ch = (WORD) token.begin[0];
+		return true;
+	}
+	if (ParseHex(token, 0xFF, &code)) {
+		*ch = (WORD) code;
+		return true;
+	}
+	return false;
+}
+
+// Splits a '+' separated chord into parts. "Ctrl++" is not a thing; use Plus.
+int SplitChord(Token token, Token* parts, int maxParts) {
+	int count = 0;
+	const char* begin = token.begin;
+	const char* end = token.begin + token.length;
+	for (const char* p = begin; p <= end; ++p) {
+		if (p == end || *p == '+') {
+			if (p == begin || count == maxParts) {
+				return 0;
+			}
+			parts[count].begin = begin;
+			parts[count].length = (size_t) (p - begin);
+			++count;
+			begin = p + 1;
+		}
+	}
+	return count;
+}
+
+BYTE ModifierBit(WORD vk) {
+	switch (vk) {
+	case VK_CONTROL: return kKeyStateControl;
+	case VK_SHIFT: return kKeyStateShift;
+	case VK_MENU: return kKeyStateAlt;
+	default: return 0;
+	}
+}
+
+} // namespace
+
+void KeyRemapTable::Clear() {
+	::memset(keyBits_, 0, sizeof(keyBits_));
+	::memset(charBits_, 0, sizeof(charBits_));
+	::memset(keySlots_, 0, sizeof(keySlots_));
+	::memset(charSlots_, 0, sizeof(charSlots_));
+	ruleCount_ = 0;
+}
+
+bool KeyRemapTable::Same(const KeyRemapTable& other) const {
+	if (ruleCount_ != other.ruleCount_ || ::memcmp(keyBits_, other.keyBits_, sizeof(keyBits_)) != 0 ||
+			::memcmp(charBits_, other.charBits_, sizeof(charBits_)) != 0 ||
+			::memcmp(keySlots_, other.keySlots_, sizeof(keySlots_)) != 0 ||
+			::memcmp(charSlots_, other.charSlots_, sizeof(charSlots_)) != 0) {
+		return false;
+	}
+	// Rule by rule, since padding may differ.
+	for (int i = 0; i < ruleCount_; ++i) {
+		const RemapRule& a = rules_[i];
+		const RemapRule& b = other.rules_[i];
+		if (a.feature != b.feature || a.consume != b.consume || a.keyCount != b.keyCount || a.outputChar != b.outputChar) {
+			return false;
+		}
+		for (int k = 0; k < a.keyCount; ++k) {
+			if (a.keys[k].vk != b.keys[k].vk || a.keys[k].keyUp != b.keys[k].keyUp) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool KeyRemapTable::Compile(const char* config, uint32_t feature, int* errorLine) {
+	bool ok = true;
+	int line = 1;
+	for (const char* p = config; *p; ++line) {
+		if (!CompileLine(p, feature) && ok) {
+			ok = false;
+			if (errorLine) {
+				*errorLine = line;
+			}
+		}
+		while (*p && *p != '\n') {
+			++p;
+		}
+		if (*p == '\n') {
+			++p;
+		}
+	}
+	return ok;
+}
+
+// key <modifiers+key> [any|text|notext] [consume] => <key>[:down|:up] ...
+// char <character> [any|text|notext] [consume] => [character]
+bool KeyRemapTable::CompileLine(const char* line, uint32_t feature) {
+	const char* cursor = line;
+	Token token;
+	if (!NextToken(&cursor, &token)) {
+		return true;  // Blank or comment.
+	}
+	bool isKey = Equals(token, "key");
+	if (!isKey && !Equals(token, "char")) {
+		return false;
+	}
+	if (ruleCount_ == kMaxRules) {
+		return false;
+	}
+	RemapRule rule = {};
+	rule.feature = feature;
+
+	// Trigger.
+	if (!NextToken(&cursor, &token)) {
+		return false;
+	}
+	WORD trigger = 0;
+	BYTE modifiers = 0;
+	if (isKey) {
+		Token parts[4];
+		int partCount = SplitChord(token, parts, 4);
+		if (partCount == 0 || !ParseKey(parts[partCount - 1], &trigger)) {
+			return false;
+		}
+		for (int i = 0; i < partCount - 1; ++i) {
+			WORD vk;
+			BYTE bit = ParseKey(parts[i], &vk) ? ModifierBit(vk) : 0;
+			if (!bit) {
+				return false;
+			}
+			modifiers |= bit;
+		}
+	} else if (!ParseChar(token, &trigger)) {
+		return false;
+	}
+
+	// Options, up to the arrow.
+	RemapContext context = RemapContext::kAny;
+	for (;;) {
+		if (!NextToken(&cursor, &token)) {
+			return false;
+		}
+		if (Equals(token, "=>")) {
+			break;
+		} else if (Equals(token, "any")) {
+			context = RemapContext::kAny;
+		} else if (Equals(token, "text")) {
+			context = RemapContext::kText;
+		} else if (Equals(token, "notext")) {
+			context = RemapContext::kNotText;
+		} else if (Equals(token, "consume")) {
+			rule.consume = true;
+		} else {
+			return false;
+		}
+	}
+
+	// Output.
+	while (NextToken(&cursor, &token)) {
+		if (!isKey) {
+			if (rule.outputChar || !ParseChar(token, &rule.outputChar)) {
+				return false;
+			}
+			continue;
+		}
+		bool press = true;
+		bool release = true;
+		const char* colon = (const char*) ::memchr(token.begin, ':', token.length);
+		if (colon) {
+			Token suffix = { colon + 1, (size_t) (token.begin + token.length - colon - 1) };
+			if (Equals(suffix, "down")) {
+				release = false;
+			} else if (Equals(suffix, "up")) {
+				press = false;
+			} else {
+				return false;
+			}
+			token.length = (size_t) (colon - token.begin);
+		}
+		Token parts[4];
+		WORD vks[4];
+		int partCount = SplitChord(token, parts, 4);
+		if (partCount == 0) {
+			return false;
+		}
+		for (int i = 0; i < partCount; ++i) {
+			if (!ParseKey(parts[i], &vks[i])) {
+				return false;
+			}
+		}
+		int needed = (press ? partCount : 0) + (release ? partCount : 0);
+		if (rule.keyCount + needed > RemapRule::kMaxKeys) {
+			return false;
+		}
+		for (int i = 0; press && i < partCount; ++i) {
+			rule.keys[rule.keyCount].vk = vks[i];
+			rule.keys[rule.keyCount].keyUp = false;
+			++rule.keyCount;
+		}
+		for (int i = partCount - 1; release && i >= 0; --i) {
+			rule.keys[rule.keyCount].vk = vks[i];
+			rule.keys[rule.keyCount].keyUp = true;
+			++rule.keyCount;
+		}
+	}
+	if (isKey ? rule.keyCount == 0 && !rule.consume : rule.outputChar == 0 && !rule.consume) {
+		return false;
+	}
+
+	rules_[ruleCount_] = rule;
+	uint8_t index = (uint8_t) ++ruleCount_;
+	if (isKey) {
+		keyBits_[trigger >> 5] |= 1u << (trigger & 31);
+		Assign(&keySlots_[(trigger * kModifierMasks + modifiers) * kContexts], context, index);
+	} else {
+		charBits_[trigger >> 5] |= 1u << (trigger & 31);
+		Assign(&charSlots_[trigger * kContexts], context, index);
+	}
+	return true;
+}
+
+void KeyRemapTable::Assign(uint8_t* slots, RemapContext context, uint8_t index) {
+	if (context != RemapContext::kText) {
+		slots[0] = index;
+	}
+	if (context != RemapContext::kNotText) {
+		slots[1] = index;
+	}
+}
+
+} // namespace amm
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstdint>
+
+namespace amm {
+
+// Modifier bits for InputMessage::keyState, and for remap triggers.
+constexpr BYTE kKeyStateControl = 0x01;
+constexpr BYTE kKeyStateShift = 0x02;
+constexpr BYTE kKeyStateAlt = 0x04;
+
+// Whether a remap applies while Live is taking text, outside it, or either way.
+enum class RemapContext : uint8_t {
+	kAny,
+	kText,
+	kNotText,
+};
+
+// What a matching key or character turns into.
+struct RemapRule {
+	static constexpr int kMaxKeys = 8;
+
+	uint32_t feature;   // kFeature* bit the rule belongs to, or 0 for the user's own rules.
+	bool consume;       // Swallow the original message instead of forwarding it after the keys.
+	uint8_t keyCount;
+	WORD outputChar;    // For character rules: what Live gets in WM_CHAR instead.
+	struct {
+		WORD vk;
+		bool keyUp;
+	} keys[kMaxKeys];   // For key rules: sent as one SendInput batch.
+};
+
+// Remaps compiled into flat tables: one slot for every (virtual key, kKeyState* modifiers, text
+// context) triple and every (character, text context) pair, holding the index of the rule that
+// applies there. Dispatch is a single array read whatever the number of rules.
+//
+// Config, one rule per line, '#' starts a comment:
+//
+//   key  Ctrl+Shift+Z         => Shift:up Y Shift:down
+//   key  Alt+F12     consume  => Ctrl+Shift+F12
+//   char =           notext   => +
+//
+// Key triggers are modifiers (Ctrl, Shift, Alt) and a key name, matched exactly. Output keys are
+// pressed and released, or just pressed or released with :down and :up; a chord such as
+// Ctrl+Shift+F12 presses in order and releases in reverse. Character rules replace the character
+// of a WM_CHAR. Contexts: any (the default), text or notext. Later rules override earlier ones.
+class KeyRemapTable {
+public:
+	static constexpr int kMaxRules = 64;
+	static constexpr int kModifierMasks = 8;  // Every combination of kKeyStateControl/Shift/Alt.
+	static constexpr int kContexts = 2;       // Not in text, in text.
+
+	KeyRemapTable() { Clear(); }
+
+	void Clear();
+
+	// Adds every rule in config, tagged with feature. Returns false if any line couldn't be parsed
+	// or didn't fit, with *errorLine set to the first such line (1-based); the rest still apply.
+	bool Compile(const char* config, uint32_t feature, int* errorLine = nullptr);
+
+	// Cheap pre-check so the modifier and context queries are only made for keys with rules.
+	bool HasKeyRules(WORD vk) const { return vk < 256 && (keyBits_[vk >> 5] & (1u << (vk & 31))) != 0; }
+	bool HasCharRules(WPARAM ch) const { return ch < 256 && (charBits_[ch >> 5] & (1u << (ch & 31))) != 0; }
+
+	// Returns nullptr if nothing applies.
+	const RemapRule* FindKey(WORD vk, BYTE modifiers, bool inText) const {
+		if (vk >= 256) {
+			return nullptr;
+		}
+		uint8_t index = keySlots_[((vk * kModifierMasks) + (modifiers & (kModifierMasks - 1))) * kContexts + (inText ? 1 : 0)];
+		return index ? &rules_[index - 1] : nullptr;
+	}
+	const RemapRule* FindChar(WPARAM ch, bool inText) const {
+		if (ch >= 256) {
+			return nullptr;
+		}
+		uint8_t index = charSlots_[ch * kContexts + (inText ? 1 : 0)];
+		return index ? &rules_[index - 1] : nullptr;
+	}
+
+	// Whether a key's rules differ between text and not, so the context is worth asking for.
+	bool DependsOnContext(WORD vk, BYTE modifiers) const {
+		return vk < 256 && FindKey(vk, modifiers, false) != FindKey(vk, modifiers, true);
+	}
+	bool CharDependsOnContext(WPARAM ch) const {
+		return ch < 256 && FindChar(ch, false) != FindChar(ch, true);
+	}
+
+	int RuleCount() const { return ruleCount_; }
+
+	// Whether both tables remap everything the same way.
+	bool Same(const KeyRemapTable& other) const;
+
+private:
+	bool CompileLine(const char* line, uint32_t feature);
+	void Assign(uint8_t* slots, RemapContext context, uint8_t index);
+
+	uint32_t keyBits_[256 / 32];
+	uint32_t charBits_[256 / 32];
+	uint8_t keySlots_[256 * kModifierMasks * kContexts];  // Rule index + 1, or 0.
+	uint8_t charSlots_[256 * kContexts];
+	RemapRule rules_[kMaxRules];
+	int ruleCount_;
+};
+
+} // namespace amm
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace amm {
+
+// Power-of-two bucketed histogram of nanosecond latencies. Bucket i counts samples in
+// [2^i, 2^(i+1)) ns. Recording is one relaxed increment, so a single writer can feed it from a hot
+// loop while anyone reads it.
+class LatencyHistogram {
+public:
+	static constexpr int kBuckets = 40;  // Up to ~9 minutes; anything longer lands in the last one.
+
+	void Record(uint64_t nanos) {
+		int bucket = 0;
+		while (bucket < kBuckets - 1 && (nanos >> (bucket + 1)) != 0) {
+			++bucket;
+		}
+		counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	uint64_t Count(int bucket) const { return counts_[bucket].load(std::memory_order_relaxed); }
+
+	uint64_t Total() const {
+		uint64_t total = 0;
+		for (int i = 0; i < kBuckets; ++i) {
+			total += Count(i);
+		}
+		return total;
+	}
+
+	// Upper bound, in ns, of the bucket holding the given fraction (0..1) of samples.
+	uint64_t Percentile(double fraction) const {
+		uint64_t total = Total();
+		if (total == 0) {
+			return 0;
+		}
+		uint64_t target = (uint64_t) (fraction * (double) total);
+		uint64_t seen = 0;
+		for (int i = 0; i < kBuckets; ++i) {
+			seen += Count(i);
+			if (seen > target) {
+				return (uint64_t) 1 << (i + 1);
+			}
+		}
+		return (uint64_t) 1 << kBuckets;
+	}
+
+	void Reset() {
+		for (int i = 0; i < kBuckets; ++i) {
+			counts_[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+private:
+	std::atomic<uint64_t> counts_[kBuckets] = {};
+};
+
+} // namespace amm
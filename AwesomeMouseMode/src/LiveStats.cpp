@@ -0,0 +1,187 @@
+#include "LiveStats.h"
+
+#include <cstring>
+#include <new>
+
+namespace amm {
+
+namespace {
+
+const char* const kStatsMessageNames[kStatsMessageKinds] = {
+	"move",
+	"button",
+	"wheel",
+	"key",
+	"gesture",
+	"pointer",
+	"timer",
+	"other",
+};
+
+uint64_t Percentile(const uint64_t* counts, double fraction) {
+	uint64_t total = 0;
+	for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+		total += counts[i];
+	}
+	if (total == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t) (fraction * (double) total);
+	uint64_t seen = 0;
+	for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+		seen += counts[i];
+		if (seen > target) {
+			return (uint64_t) 1 << (i + 1);
+		}
+	}
+	return (uint64_t) 1 << LatencyHistogram::kBuckets;
+}
+
+} // namespace
+
+StatsMessage ClassifyMessage(UINT msg) {
+	if (msg == WM_MOUSEMOVE) {
+		return StatsMessage::kMouseMove;
+	}
+	if (msg == WM_MOUSEWHEEL || msg == WM_MOUSEHWHEEL) {
+		return StatsMessage::kWheel;
+	}
+	if (msg > WM_MOUSEMOVE && msg <= 0x020D) {  // Through WM_XBUTTONDBLCLK.
+		return StatsMessage::kButton;
+	}
+	if (msg >= WM_KEYDOWN && msg <= 0x0109) {  // WM_KEYFIRST..WM_KEYLAST.
+		return StatsMessage::kKey;
+	}
+	if (msg == WM_GESTURE || msg == WM_GESTURENOTIFY) {
+		return StatsMessage::kGesture;
+	}
+	if (msg >= 0x0241 && msg <= 0x0251) {  // WM_NCPOINTERUPDATE..WM_POINTERROUTEDRELEASED.
+		return StatsMessage::kPointer;
+	}
+	if (msg == WM_TIMER) {
+		return StatsMessage::kTimer;
+	}
+	return StatsMessage::kOther;
+}
+
+const char* StatsMessageName(StatsMessage kind) {
+	return (int) kind < kStatsMessageKinds ? kStatsMessageNames[(int) kind] : "?";
+}
+
+StatsThread* StatsBlock::ForThread(uint32_t threadId) {
+	for (StatsThread& thread : threads) {
+		uint32_t owner = thread.threadId.load(std::memory_order_relaxed);
+		if (owner == threadId) {
+			return &thread;
+		}
+		if (owner == 0 && thread.threadId.compare_exchange_strong(owner, threadId, std::memory_order_relaxed)) {
+			return &thread;
+		}
+	}
+	return &threads[kMaxThreads - 1];
+}
+
+StatsBlock* InitStatsBlock(void* memory, uint32_t processId, uint64_t ticksPerSecond) {
+	::memset(memory, 0, sizeof(StatsBlock));
+	StatsBlock* block = new (memory) StatsBlock();
+	block->magic = StatsBlock::kMagic;
+	block->version = StatsBlock::kVersion;
+	block->threadSize = (uint16_t) sizeof(StatsThread);
+	block->threadCount = StatsBlock::kMaxThreads;
+	block->processId = processId;
+	block->ticksPerSecond = ticksPerSecond;
+	return block;
+}
+
+const StatsBlock* ValidateStatsBlock(const void* memory, size_t size) {
+	if (!memory || size < sizeof(StatsBlock)) {
+		return nullptr;
+	}
+	const StatsBlock* block = static_cast<const StatsBlock*>(memory);
+	if (block->magic != StatsBlock::kMagic || block->version != StatsBlock::kVersion ||
+			block->threadSize != sizeof(StatsThread) || block->threadCount != StatsBlock::kMaxThreads) {
+		return nullptr;
+	}
+	return block;
+}
+
+void TakeStatsSnapshot(const StatsBlock& block, StatsSnapshot* snapshot) {
+	*snapshot = StatsSnapshot();
+	for (const StatsThread& thread : block.threads) {
+		if (thread.threadId.load(std::memory_order_relaxed) == 0) {
+			continue;
+		}
+		++snapshot->threads;
+		for (int i = 0; i < kStatsMessageKinds; ++i) {
+			uint64_t count = thread.messages[i].load(std::memory_order_relaxed);
+			snapshot->messages[i] += count;
+			snapshot->totalMessages += count;
+		}
+		snapshot->queries += thread.queries.load(std::memory_order_relaxed);
+		snapshot->hookNanos += thread.hookNanos.load(std::memory_order_relaxed);
+		snapshot->forwardNanos += thread.forwardNanos.load(std::memory_order_relaxed);
+		snapshot->sendInputCalls += thread.sendInputCalls.load(std::memory_order_relaxed);
+		snapshot->sendInputEvents += thread.sendInputEvents.load(std::memory_order_relaxed);
+		snapshot->movesDropped += thread.movesDropped.load(std::memory_order_relaxed);
+		snapshot->keysCoalesced += thread.keysCoalesced.load(std::memory_order_relaxed);
+		snapshot->panGestures += thread.panGestures.load(std::memory_order_relaxed);
+		snapshot->touchGestures += thread.touchGestures.load(std::memory_order_relaxed);
+		for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+			snapshot->hookLatency[i] += thread.hookLatency.Count(i);
+			snapshot->forwardLatency[i] += thread.forwardLatency.Count(i);
+		}
+	}
+	snapshot->windowEvents = block.windowEvents.load(std::memory_order_relaxed);
+	snapshot->windowsMapped = block.windowsMapped.load(std::memory_order_relaxed);
+	snapshot->windowsSkipped = block.windowsSkipped.load(std::memory_order_relaxed);
+	snapshot->coverageMicros = block.coverageMicros.load(std::memory_order_relaxed);
+}
+
+void PrintStatsSnapshot(const StatsSnapshot& now, const StatsSnapshot* before, double seconds, FILE* out) {
+	StatsSnapshot zero;
+	const StatsSnapshot& base = before ? *before : zero;
+	bool rates = before && seconds > 0;
+	double scale = rates ? 1.0 / seconds : 1.0;
+	const char* unit = rates ? "/s" : "";
+
+	::fprintf(out, "messages%s: %.0f (", unit, (now.totalMessages - base.totalMessages) * scale);
+	for (int i = 0; i < kStatsMessageKinds; ++i) {
+		::fprintf(out, "%s%s %.0f", i ? ", " : "", kStatsMessageNames[i], (now.messages[i] - base.messages[i]) * scale);
+	}
+	::fprintf(out, ") on %u threads\n", now.threads);
+
+	uint64_t messages = now.totalMessages - base.totalMessages;
+	uint64_t hookNanos = now.hookNanos - base.hookNanos;
+	uint64_t forwardNanos = now.forwardNanos - base.forwardNanos;
+	uint64_t hookLatency[LatencyHistogram::kBuckets];
+	uint64_t forwardLatency[LatencyHistogram::kBuckets];
+	uint64_t forwarded = 0;
+	for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+		hookLatency[i] = now.hookLatency[i] - base.hookLatency[i];
+		forwardLatency[i] = now.forwardLatency[i] - base.forwardLatency[i];
+		forwarded += forwardLatency[i];
+	}
+	::fprintf(out, "hook: %.1f ns/message, p50 < %llu ns, p99 < %llu ns, %.2f%% of wall time\n",
+		messages ? (double) hookNanos / messages : 0.0,
+		(unsigned long long) Percentile(hookLatency, 0.5), (unsigned long long) Percentile(hookLatency, 0.99),
+		rates ? hookNanos / (seconds * 1e7) : 0.0);
+	::fprintf(out, "live: %.1f ns/forwarded message, p50 < %llu ns, p99 < %llu ns, %.2f%% of wall time\n",
+		forwarded ? (double) forwardNanos / forwarded : 0.0,
+		(unsigned long long) Percentile(forwardLatency, 0.5), (unsigned long long) Percentile(forwardLatency, 0.99),
+		rates ? forwardNanos / (seconds * 1e7) : 0.0);
+	::fprintf(out, "queries%s: %.0f, SendInput calls%s: %.0f, events%s: %.0f\n",
+		unit, (now.queries - base.queries) * scale,
+		unit, (now.sendInputCalls - base.sendInputCalls) * scale,
+		unit, (now.sendInputEvents - base.sendInputEvents) * scale);
+	::fprintf(out, "moves dropped%s: %.0f, zoom keys coalesced%s: %.0f\n",
+		unit, (now.movesDropped - base.movesDropped) * scale,
+		unit, (now.keysCoalesced - base.keysCoalesced) * scale);
+	::fprintf(out, "pan gestures%s: %.0f, touch gestures%s: %.0f\n",
+		unit, (now.panGestures - base.panGestures) * scale,
+		unit, (now.touchGestures - base.touchGestures) * scale);
+	::fprintf(out, "windows: %u hooked, %u skipped, %llu us to cover, %llu hook callbacks\n",
+		now.windowsMapped, now.windowsSkipped, (unsigned long long) now.coverageMicros,
+		(unsigned long long) now.windowEvents);
+}
+
+} // namespace amm
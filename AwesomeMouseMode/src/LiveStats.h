@@ -0,0 +1,111 @@
+#pragma once
+
+#include "LatencyHistogram.h"
+#include "Win32Shim.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace amm {
+
+// What OurWndProc sees, bucketed for the per-type message counts.
+enum class StatsMessage : uint8_t {
+	kMouseMove,
+	kButton,
+	kWheel,
+	kKey,
+	kGesture,
+	kPointer,
+	kTimer,
+	kOther,
+	kCount,
+};
+constexpr int kStatsMessageKinds = (int) StatsMessage::kCount;
+
+StatsMessage ClassifyMessage(UINT msg);
+const char* StatsMessageName(StatsMessage kind);
+
+// Counters for one thread that runs our hooks. Each thread writes only its own, so increments never
+// contend; anyone may read at any time. Cache-line aligned so neighbours don't share lines.
+struct alignas(64) StatsThread {
+	std::atomic<uint32_t> threadId;  // Owner, or 0 while unclaimed.
+	std::atomic<uint64_t> messages[kStatsMessageKinds];
+	std::atomic<uint64_t> queries;          // user32 queries made on the translator's behalf.
+	std::atomic<uint64_t> hookNanos;        // In OurWndProc, not counting Live's own handler.
+	std::atomic<uint64_t> forwardNanos;     // In Live's handler, for messages we forwarded.
+	std::atomic<uint64_t> sendInputCalls;
+	std::atomic<uint64_t> sendInputEvents;
+	std::atomic<uint64_t> movesDropped;     // Stale mouse moves skipped by the move coalescer.
+	std::atomic<uint64_t> keysCoalesced;    // Zoom key events cancelled before being sent.
+	std::atomic<uint64_t> panGestures;      // GID_PAN gestures begun.
+	std::atomic<uint64_t> touchGestures;    // Multi-touch pans and pinches begun.
+	LatencyHistogram hookLatency;           // Per message, as hookNanos.
+	LatencyHistogram forwardLatency;        // Per forwarded message, as forwardNanos.
+};
+
+// The shared-memory block the hook publishes into, for a viewer to read while Live runs. Versioned:
+// bump kVersion whenever the layout changes, and readers refuse what they don't know.
+struct StatsBlock {
+	static constexpr uint32_t kMagic = 0x534d4d41;  // "AMMS".
+	static constexpr uint16_t kVersion = 1;
+	static constexpr int kMaxThreads = 8;
+
+	uint32_t magic;
+	uint16_t version;
+	uint16_t threadSize;  // sizeof(StatsThread).
+	uint32_t threadCount;
+	uint32_t processId;
+	uint64_t ticksPerSecond;
+
+	// Window hooking.
+	std::atomic<uint64_t> windowEvents;    // WinEvent callbacks.
+	std::atomic<uint32_t> windowsMapped;
+	std::atomic<uint32_t> windowsSkipped;
+	std::atomic<uint64_t> coverageMicros;  // Time to hook every window Live had at attach.
+
+	StatsThread threads[kMaxThreads];
+
+	// The calling thread's counters, claiming a slot on first use. Threads past kMaxThreads share
+	// the last slot, which stays correct, just contended.
+	StatsThread* ForThread(uint32_t threadId);
+};
+
+// Name of the block's file mapping for a process, formatted with its id.
+#define AMM_STATS_MAPPING_NAME L"Local\\AwesomeMouseMode.Stats.%lu"
+
+// Sets up a fresh, zeroed block in memory of at least sizeof(StatsBlock).
+StatsBlock* InitStatsBlock(void* memory, uint32_t processId, uint64_t ticksPerSecond);
+
+// Checks that memory holds a block this code understands. Returns nullptr if not.
+const StatsBlock* ValidateStatsBlock(const void* memory, size_t size);
+
+// Everything in a block summed over threads, as plain values a viewer can diff between samples.
+struct StatsSnapshot {
+	uint32_t threads = 0;
+	uint64_t messages[kStatsMessageKinds] = {};
+	uint64_t totalMessages = 0;
+	uint64_t queries = 0;
+	uint64_t hookNanos = 0;
+	uint64_t forwardNanos = 0;
+	uint64_t sendInputCalls = 0;
+	uint64_t sendInputEvents = 0;
+	uint64_t movesDropped = 0;
+	uint64_t keysCoalesced = 0;
+	uint64_t panGestures = 0;
+	uint64_t touchGestures = 0;
+	uint64_t hookLatency[LatencyHistogram::kBuckets] = {};
+	uint64_t forwardLatency[LatencyHistogram::kBuckets] = {};
+	uint64_t windowEvents = 0;
+	uint32_t windowsMapped = 0;
+	uint32_t windowsSkipped = 0;
+	uint64_t coverageMicros = 0;
+};
+
+void TakeStatsSnapshot(const StatsBlock& block, StatsSnapshot* snapshot);
+
+// Prints now as rates over the seconds since before, or as totals if before is null.
+void PrintStatsSnapshot(const StatsSnapshot& now, const StatsSnapshot* before, double seconds, FILE* out);
+
+} // namespace amm
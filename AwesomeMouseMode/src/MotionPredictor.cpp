@@ -0,0 +1,61 @@
+#include "MotionPredictor.h"
+
+#include <cmath>
+
+namespace amm {
+
+namespace {
+
+// Samples older than this, relative to the newest, say nothing about the current velocity.
+constexpr DWORD kSampleWindowMs = 40;
+// Never lead by more than this, however fast the fit says; a wrong guess is worse than a late one.
+constexpr double kMaxPredictionPx = 48.0;
+
+} // namespace
+
+void MotionPredictor::SetLead(int milliseconds) {
+	if (milliseconds < 0) {
+		milliseconds = 0;
+	}
+	leadMs_ = milliseconds < kMaxLeadMs ? milliseconds : kMaxLeadMs;
+}
+
+void MotionPredictor::AddSample(POINT position, DWORD time) {
+	MotionSample& sample = samples_[nextSample_];
+	sample.x = position.x;
+	sample.y = position.y;
+	sample.time = time;
+	nextSample_ = (nextSample_ + 1) % kSamples;
+	if (sampleCount_ < kSamples) {
+		++sampleCount_;
+	}
+}
+
+POINT MotionPredictor::Predict() const {
+	if (sampleCount_ == 0) {
+		return POINT{ 0, 0 };
+	}
+	const MotionSample& last = samples_[(nextSample_ + kSamples - 1) % kSamples];
+	POINT predicted = { last.x, last.y };
+	if (sampleCount_ < 2 || leadMs_ == 0) {
+		return predicted;
+	}
+
+	double velocityX;
+	double velocityY;
+	if (!FitVelocity(samples_, sampleCount_, last, kSampleWindowMs, &velocityX, &velocityY)) {
+		return predicted;
+	}
+	double dx = velocityX * leadMs_;
+	double dy = velocityY * leadMs_;
+	double distance = std::sqrt(dx * dx + dy * dy);
+	if (distance > kMaxPredictionPx) {
+		dx *= kMaxPredictionPx / distance;
+		dy *= kMaxPredictionPx / distance;
+	}
+	predicted.x = last.x + (LONG) std::lround(dx);
+	predicted.y = last.y + (LONG) std::lround(dy);
+	return predicted;
+}
+
+} // namespace amm
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "VelocityFit.h"
+
+namespace amm {
+
+// Extrapolates a drag a few milliseconds ahead, so the position Live draws from is closer to where
+// the pen or mouse actually is by the time the frame reaches the screen. Constant velocity, fitted
+// to the last few samples (see FitVelocity) and cheap enough for every move.
+class MotionPredictor {
+public:
+	static constexpr int kSamples = 4;
+	static constexpr int kDefaultLeadMs = 12;
+	static constexpr int kMaxLeadMs = 50;
+
+	void SetLead(int milliseconds);
+	int Lead() const { return leadMs_; }
+
+	// Forgets the samples, so the next prediction starts from scratch. Call at button transitions.
+	void Reset() { sampleCount_ = 0; }
+
+	// Records where the pointer was at time (ms).
+	void AddSample(POINT position, DWORD time);
+
+	// Where the pointer should be Lead() ms after the last sample. That sample itself while there
+	// is too little recent motion to extrapolate from.
+	POINT Predict() const;
+
+private:
+	MotionSample samples_[kSamples];
+	int sampleCount_ = 0;
+	int nextSample_ = 0;
+	int leadMs_ = kDefaultLeadMs;
+};
+
+} // namespace amm
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace amm {
+
+// Decides when a mouse move can be skipped because Live is falling behind. Live only ever acts on
+// the latest position, so when its handler is slow and a newer move is already queued, forwarding
+// the older one just delays the newer one.
+//
+// Only moves the translator marks coalescable are offered here, and the caller only asks while a
+// newer move is pending and no button message is; so button transitions, and the moves right
+// before them, always reach Live.
+class MoveCoalescer {
+public:
+	// Live must be taking at least this long per move before we start dropping any.
+	static constexpr uint64_t kMinCostNanos = 1000000;
+	// However far behind Live is, it still sees at least one move in this many.
+	static constexpr int kMaxConsecutiveDrops = 4;
+
+	// How long Live's window procedure took with a move we forwarded.
+	void RecordCost(uint64_t nanos) {
+		// Exponential moving average, weighted 1/4 to the new sample.
+		uint64_t cost = costNanos_.load(std::memory_order_relaxed);
+		cost = cost - cost / 4 + nanos / 4;
+		costNanos_.store(cost, std::memory_order_relaxed);
+		consecutiveDrops_ = 0;
+	}
+
+	// Returns true if this move should be dropped in favour of the newer one already queued.
+	bool ShouldDrop() {
+		uint64_t cost = costNanos_.load(std::memory_order_relaxed);
+		if (cost < kMinCostNanos || consecutiveDrops_ >= kMaxConsecutiveDrops) {
+			return false;
+		}
+		++consecutiveDrops_;
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		savedNanos_.fetch_add(cost, std::memory_order_relaxed);
+		return true;
+	}
+
+	uint64_t CostNanos() const { return costNanos_.load(std::memory_order_relaxed); }
+	uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+	// Estimated UI-thread time not spent in Live's handler thanks to dropped moves.
+	uint64_t SavedNanos() const { return savedNanos_.load(std::memory_order_relaxed); }
+
+private:
+	int consecutiveDrops_ = 0;
+	std::atomic<uint64_t> costNanos_{ 0 };
+	std::atomic<uint64_t> dropped_{ 0 };
+	std::atomic<uint64_t> savedNanos_{ 0 };
+};
+
+} // namespace amm
@@ -0,0 +1,82 @@
+#include "PanInertia.h"
+
+#include <cmath>
+
+namespace amm {
+
+namespace {
+
+// Samples older than this at release don't count towards the velocity.
+constexpr DWORD kSampleWindowMs = 100;
+// Coasting stops once it slows below this, in pixels per millisecond.
+constexpr double kStopSpeed = 0.02;
+// Releases slower than this don't coast at all.
+constexpr double kMinStartSpeed = 0.2;
+// Nor faster than this, however fast the fit says.
+constexpr double kMaxStartSpeed = 10.0;
+
+} // namespace
+
+void PanInertia::Reset() {
+	sampleCount_ = 0;
+	nextSample_ = 0;
+	coasting_ = false;
+}
+
+void PanInertia::AddSample(POINT location, DWORD time) {
+	MotionSample& sample = samples_[nextSample_];
+	sample.x = location.x;
+	sample.y = location.y;
+	sample.time = time;
+	nextSample_ = (nextSample_ + 1) % kSamples;
+	if (sampleCount_ < kSamples) {
+		++sampleCount_;
+	}
+	coasting_ = false;
+}
+
+bool PanInertia::Start(DWORD time) {
+	coasting_ = false;
+	if (sampleCount_ < 2) {
+		return false;
+	}
+	const MotionSample& last = samples_[(nextSample_ + kSamples - 1) % kSamples];
+
+	if (!FitVelocity(samples_, sampleCount_, last, kSampleWindowMs, &velocityX_, &velocityY_)) {
+		return false;
+	}
+
+	double speed = std::sqrt(velocityX_ * velocityX_ + velocityY_ * velocityY_);
+	if (speed < kMinStartSpeed) {
+		return false;
+	}
+	if (speed > kMaxStartSpeed) {
+		velocityX_ *= kMaxStartSpeed / speed;
+		velocityY_ *= kMaxStartSpeed / speed;
+		speed = kMaxStartSpeed;
+	}
+	// v(t) = v0 e^(-kt) falls to kStopSpeed at t = ln(v0 / kStopSpeed) / k.
+	double k = friction_ / 1000.0;
+	durationMs_ = std::log(speed / kStopSpeed) / k;
+	startX_ = last.x;
+	startY_ = last.y;
+	startTime_ = time;
+	coasting_ = true;
+	return true;
+}
+
+bool PanInertia::PositionAt(DWORD time, POINT* position) const {
+	double elapsed = (double) (DWORD) (time - startTime_);
+	bool moving = coasting_ && elapsed < durationMs_;
+	if (elapsed > durationMs_) {
+		elapsed = durationMs_;
+	}
+	// Integral of v0 e^(-kt) from 0 to elapsed.
+	double k = friction_ / 1000.0;
+	double travel = (1.0 - std::exp(-k * elapsed)) / k;
+	position->x = (LONG) std::lround(startX_ + velocityX_ * travel);
+	position->y = (LONG) std::lround(startY_ + velocityY_ * travel);
+	return moving;
+}
+
+} // namespace amm
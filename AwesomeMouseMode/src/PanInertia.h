@@ -0,0 +1,52 @@
+#pragma once
+
+#include "VelocityFit.h"
+
+namespace amm {
+
+// How often a coasting pan moves, about once per display refresh.
+constexpr DWORD kInertiaFrameMs = 16;
+
+// Coasting after a pan is released. Velocity is fitted to the last few pan samples, then decays
+// exponentially under friction. The position is a pure function of time since release, so frames
+// can arrive late or irregularly without the motion jittering, and the whole curve can be checked
+// without a window.
+class PanInertia {
+public:
+	static constexpr int kSamples = 6;
+	static constexpr int kDefaultFriction = 4;  // Per second: speed falls by e every 1/friction s.
+
+	void SetFriction(int perSecond) { friction_ = perSecond > 0 ? perSecond : kDefaultFriction; }
+
+	// Forgets the samples and stops coasting.
+	void Reset();
+
+	// Records the pan's position at time (ms). Call for every pan update.
+	void AddSample(POINT location, DWORD time);
+
+	// Starts coasting from the last sample. Returns false if the pan was released too slowly to
+	// coast at all.
+	bool Start(DWORD time);
+
+	// Where the pan is at time. Returns false once it has come to rest there.
+	bool PositionAt(DWORD time, POINT* position) const;
+
+	bool Coasting() const { return coasting_; }
+	void Stop() { coasting_ = false; }
+
+private:
+	MotionSample samples_[kSamples];
+	int sampleCount_ = 0;
+	int nextSample_ = 0;
+	int friction_ = kDefaultFriction;
+
+	bool coasting_ = false;
+	DWORD startTime_ = 0;
+	double startX_ = 0;
+	double startY_ = 0;
+	double velocityX_ = 0;  // Pixels per millisecond at release.
+	double velocityY_ = 0;
+	double durationMs_ = 0;
+};
+
+} // namespace amm
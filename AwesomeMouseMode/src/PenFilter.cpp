@@ -0,0 +1,74 @@
+#include "PenFilter.h"
+
+#include <cmath>
+
+namespace amm {
+
+namespace {
+
+// Cutoff for the speed estimate that drives the adaptive cutoff. Higher than the usual 1 Hz so the
+// filter opens up within the first few samples of a stroke.
+constexpr double kDerivativeCutoffHz = 10.0;
+constexpr double kTwoPi = 6.283185307179586;
+
+// Smoothing factor of a one-pole low-pass at cutoff for a step of dt seconds.
+inline double Alpha(double cutoff, double dt) {
+	double tau = 1.0 / (kTwoPi * cutoff);
+	return 1.0 / (1.0 + tau / dt);
+}
+
+} // namespace
+
+void PenFilter::Configure(const Config& config) {
+	config_ = config;
+	if (config_.deadZone < 0) {
+		config_.deadZone = 0;
+	}
+	if (config_.gainPercent <= 0) {
+		config_.gainPercent = 100;
+	}
+	if (config_.minCutoffTenthsHz <= 0) {
+		config_.minCutoffTenthsHz = Config().minCutoffTenthsHz;
+	}
+	if (config_.betaThousandths < 0) {
+		config_.betaThousandths = 0;
+	}
+	minCutoff_ = config_.minCutoffTenthsHz / 10.0;
+	beta_ = config_.betaThousandths / 1000.0;
+	gain_ = config_.gainPercent / 100.0;
+}
+
+void PenFilter::Reset(POINT position, DWORD time) {
+	x_ = Axis();
+	x_.raw = x_.value = x_.emitted = position.x;
+	y_ = Axis();
+	y_.raw = y_.value = y_.emitted = position.y;
+	time_ = time;
+}
+
+POINT PenFilter::Next(POINT position, DWORD time) {
+	// Digitizers often report several samples within the same millisecond.
+	DWORD elapsed = time - time_;
+	double dt = (elapsed > 0 ? elapsed : 1) / 1000.0;
+	time_ = time;
+	POINT delta;
+	delta.x = Step(x_, position.x, dt);
+	delta.y = Step(y_, position.y, dt);
+	return delta;
+}
+
+int PenFilter::Step(Axis& axis, double raw, double dt) {
+	double speed = (raw - axis.raw) / dt;
+	axis.raw = raw;
+	axis.derivative += Alpha(kDerivativeCutoffHz, dt) * (speed - axis.derivative);
+	double cutoff = minCutoff_ + beta_ * std::fabs(axis.derivative);
+	axis.value += Alpha(cutoff, dt) * (raw - axis.value);
+
+	double motion = (axis.value - axis.emitted) * gain_ + axis.carry;
+	axis.emitted = axis.value;
+	int whole = (int) motion;
+	axis.carry = motion - whole;
+	return whole;
+}
+
+} // namespace amm
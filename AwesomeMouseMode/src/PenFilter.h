@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstdint>
+
+namespace amm {
+
+// Smooths pen motion before it is handed to Live as relative drags. An adaptive low-pass per axis
+// (the One-Euro filter): slow, careful movement is filtered hard to take out digitizer jitter,
+// while the cutoff rises with speed so fast strokes get through with little lag. Output is integer
+// deltas with the sub-pixel remainder carried over, so nothing is lost to rounding. Fully
+// deterministic: the same samples always give the same deltas.
+class PenFilter {
+public:
+	struct Config {
+		int deadZone = 3;            // Pixels of motion Live must see at once before it has caught up.
+		int gainPercent = 100;       // Scales every delta.
+		int minCutoffTenthsHz = 50;  // Cutoff while the pen is still, in 0.1 Hz.
+		int betaThousandths = 100;   // Cutoff added per pixel/second of speed, in 0.001 Hz.
+	};
+
+	void Configure(const Config& config);
+	const Config& GetConfig() const { return config_; }
+
+	// Starts a fresh stroke at position, without emitting any motion.
+	void Reset(POINT position, DWORD time);
+
+	// Feeds the next raw pen position at time (ms) and returns the motion to pass on since the
+	// previous call, smoothed and scaled by the gain.
+	POINT Next(POINT position, DWORD time);
+
+private:
+	struct Axis {
+		double raw = 0;         // Last raw position.
+		double value = 0;       // Filtered position.
+		double derivative = 0;  // Filtered speed, pixels per second.
+		double emitted = 0;     // Filtered position already handed out, before gain.
+		double carry = 0;       // Sub-pixel output not yet handed out, after gain.
+	};
+
+	int Step(Axis& axis, double raw, double dt);
+
+	Config config_;
+	double minCutoff_ = 5.0;
+	double beta_ = 0.1;
+	double gain_ = 1.0;
+	Axis x_;
+	Axis y_;
+	DWORD time_ = 0;
+};
+
+} // namespace amm
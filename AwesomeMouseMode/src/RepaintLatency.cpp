@@ -0,0 +1,132 @@
+#include "RepaintLatency.h"
+
+namespace amm {
+
+void RepaintHistograms::Record(StatsMessage kind, uint64_t latencyNanos, uint64_t handlerNanos) {
+	Kind& stats = kinds_[(int) kind];
+	uint64_t bucket = latencyNanos / kBucketNanos;
+	stats.counts[bucket < kBuckets ? bucket : kBuckets - 1].fetch_add(1, std::memory_order_relaxed);
+	stats.count.fetch_add(1, std::memory_order_relaxed);
+	stats.latencyNanos.fetch_add(latencyNanos, std::memory_order_relaxed);
+	stats.handlerNanos.fetch_add(handlerNanos, std::memory_order_relaxed);
+	if (latencyNanos > stats.maxNanos.load(std::memory_order_relaxed)) {
+		stats.maxNanos.store(latencyNanos, std::memory_order_relaxed);
+	}
+}
+
+uint64_t RepaintHistograms::TotalCount() const {
+	uint64_t total = 0;
+	for (int i = 0; i < kStatsMessageKinds; ++i) {
+		total += Count((StatsMessage) i);
+	}
+	return total;
+}
+
+uint64_t RepaintHistograms::Percentile(StatsMessage kind, double fraction) const {
+	const Kind& stats = kinds_[(int) kind];
+	uint64_t total = 0;
+	for (int i = 0; i < kBuckets; ++i) {
+		total += stats.counts[i].load(std::memory_order_relaxed);
+	}
+	if (total == 0) {
+		return 0;
+	}
+	uint64_t target = (uint64_t) (fraction * (double) total);
+	uint64_t seen = 0;
+	for (int i = 0; i < kBuckets; ++i) {
+		seen += stats.counts[i].load(std::memory_order_relaxed);
+		if (seen > target) {
+			return (uint64_t) (i + 1) * kBucketNanos;
+		}
+	}
+	return (uint64_t) kBuckets * kBucketNanos;
+}
+
+void RepaintHistograms::Write(FILE* out) const {
+	std::fprintf(out, "# kind count unmatched mean_ms handler_ms p50_ms p90_ms p99_ms max_ms\n");
+	for (int i = 0; i < kStatsMessageKinds; ++i) {
+		StatsMessage kind = (StatsMessage) i;
+		const Kind& stats = kinds_[i];
+		uint64_t count = stats.count.load(std::memory_order_relaxed);
+		uint64_t unmatched = stats.unmatched.load(std::memory_order_relaxed);
+		if (count == 0 && unmatched == 0) {
+			continue;
+		}
+		double samples = count ? (double) count : 1;
+		std::fprintf(out, "%-8s %8llu %9llu %7.2f %10.2f %6.2f %6.2f %6.2f %6.2f\n", StatsMessageName(kind),
+			(unsigned long long) count, (unsigned long long) unmatched,
+			stats.latencyNanos.load(std::memory_order_relaxed) / samples / 1e6,
+			stats.handlerNanos.load(std::memory_order_relaxed) / samples / 1e6,
+			Percentile(kind, 0.5) / 1e6, Percentile(kind, 0.9) / 1e6, Percentile(kind, 0.99) / 1e6,
+			stats.maxNanos.load(std::memory_order_relaxed) / 1e6);
+	}
+	// Buckets by upper bound; the last holds everything slower.
+	std::fprintf(out, "\n# kind bucket_ms count\n");
+	for (int i = 0; i < kStatsMessageKinds; ++i) {
+		const Kind& stats = kinds_[i];
+		for (int bucket = 0; bucket < kBuckets; ++bucket) {
+			if (uint64_t count = stats.counts[bucket].load(std::memory_order_relaxed)) {
+				std::fprintf(out, "%s %.2f%s %llu\n", StatsMessageName((StatsMessage) i),
+					(bucket + 1) * kBucketNanos / 1e6, bucket == kBuckets - 1 ? "+" : "", (unsigned long long) count);
+			}
+		}
+	}
+}
+
+void RepaintHistograms::Reset() {
+	for (Kind& stats : kinds_) {
+		for (std::atomic<uint64_t>& count : stats.counts) {
+			count.store(0, std::memory_order_relaxed);
+		}
+		stats.count.store(0, std::memory_order_relaxed);
+		stats.unmatched.store(0, std::memory_order_relaxed);
+		stats.latencyNanos.store(0, std::memory_order_relaxed);
+		stats.handlerNanos.store(0, std::memory_order_relaxed);
+		stats.maxNanos.store(0, std::memory_order_relaxed);
+	}
+}
+
+void RepaintTracker::Input(StatsMessage kind, uint64_t enteredNanos, RepaintHistograms* histograms) {
+	while (count_ > 0 && enteredNanos - pending_[first_].enteredNanos > kExpiryNanos) {
+		histograms->Unmatched(pending_[first_].kind);
+		first_ = (first_ + 1) % kMaxPending;
+		--count_;
+	}
+	if (count_ == kMaxPending) {
+		histograms->Unmatched(kind);
+		return;
+	}
+	Pending& pending = pending_[(first_ + count_) % kMaxPending];
+	pending.enteredNanos = enteredNanos;
+	pending.handlerNanos = 0;
+	pending.kind = kind;
+	++count_;
+}
+
+void RepaintTracker::Handled(uint64_t enteredNanos, uint64_t handlerNanos) {
+	if (count_ == 0) {
+		return;
+	}
+	// Usually the newest, unless Live's handler sent the window more input of its own.
+	for (int i = count_ - 1; i >= 0; --i) {
+		Pending& pending = pending_[(first_ + i) % kMaxPending];
+		if (pending.enteredNanos == enteredNanos) {
+			pending.handlerNanos = handlerNanos < UINT32_MAX ? (uint32_t) handlerNanos : UINT32_MAX;
+			return;
+		}
+		if (pending.enteredNanos < enteredNanos) {
+			return;
+		}
+	}
+}
+
+void RepaintTracker::Painted(uint64_t nanos, RepaintHistograms* histograms) {
+	for (; count_ > 0; --count_) {
+		const Pending& pending = pending_[first_];
+		histograms->Record(pending.kind, nanos > pending.enteredNanos ? nanos - pending.enteredNanos : 0, pending.handlerNanos);
+		first_ = (first_ + 1) % kMaxPending;
+	}
+	first_ = 0;
+}
+
+} // namespace amm
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "LiveStats.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+namespace amm {
+
+// Input-to-repaint latency per kind of input message: from the moment a message reaches the hook
+// to the end of the window's next WM_PAINT. Buckets are a quarter of a millisecond up to 100 ms,
+// fine enough to tell one frame from the next, which LatencyHistogram's powers of two can't;
+// anything slower lands in the last. Recording is a few relaxed increments, so the UI thread can
+// feed it while anyone reads it.
+class RepaintHistograms {
+public:
+	static constexpr uint64_t kBucketNanos = 250000;
+	static constexpr int kBuckets = 401;
+
+	// latencyNanos from hook to repaint, of which handlerNanos were in Live's handler for the input
+	// itself (0 if we didn't forward it).
+	void Record(StatsMessage kind, uint64_t latencyNanos, uint64_t handlerNanos);
+
+	// An input that no repaint followed in time, or that was crowded out waiting for one.
+	void Unmatched(StatsMessage kind) { kinds_[(int) kind].unmatched.fetch_add(1, std::memory_order_relaxed); }
+
+	uint64_t Count(StatsMessage kind) const { return kinds_[(int) kind].count.load(std::memory_order_relaxed); }
+	uint64_t TotalCount() const;
+
+	// Upper bound, in ns, of the bucket holding the given fraction (0..1) of a kind's samples.
+	uint64_t Percentile(StatsMessage kind, double fraction) const;
+
+	// A table of every kind with samples, then each one's non-empty buckets, as '#' comments and
+	// whitespace-separated columns.
+	void Write(FILE* out) const;
+
+	void Reset();
+
+private:
+	struct Kind {
+		std::atomic<uint64_t> counts[kBuckets];
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> unmatched;
+		std::atomic<uint64_t> latencyNanos;
+		std::atomic<uint64_t> handlerNanos;
+		std::atomic<uint64_t> maxNanos;
+	};
+
+	Kind kinds_[kStatsMessageKinds] = {};
+};
+
+// The inputs one window has handled since it last repainted, waiting for the paint that shows them.
+// One per window, used only by the thread running its window procedure.
+class RepaintTracker {
+public:
+	static constexpr int kMaxPending = 256;
+	static constexpr uint64_t kExpiryNanos = 1000000000;
+
+	// An input reached the hook at enteredNanos. Anything that has waited longer than kExpiryNanos
+	// for a repaint is given up on.
+	void Input(StatsMessage kind, uint64_t enteredNanos, RepaintHistograms* histograms);
+
+	// The hook is done with the input that reached it at enteredNanos, having spent handlerNanos in
+	// Live's handler with it. Lost if a repaint nested in the handler has already counted it.
+	void Handled(uint64_t enteredNanos, uint64_t handlerNanos);
+
+	// Live finished repainting the window at nanos, showing everything pending.
+	void Painted(uint64_t nanos, RepaintHistograms* histograms);
+
+private:
+	struct Pending {
+		uint64_t enteredNanos;
+		uint32_t handlerNanos;
+		StatsMessage kind;
+	};
+
+	Pending pending_[kMaxPending];
+	int first_ = 0;
+	int count_ = 0;
+};
+
+} // namespace amm
@@ -0,0 +1,78 @@
+#include "ScrollEngine.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace amm {
+
+namespace {
+
+// A gap this long between inputs ends a gesture.
+constexpr DWORD kScrollIdleMs = 60;
+
+// Never let more than this much scroll pile up behind the frame cadence.
+constexpr int32_t kMaxBacklogFixed = 8 * WHEEL_DELTA * ScrollAxis::kOne;
+
+constexpr int32_t kGranuleFixed = kScrollGranule * ScrollAxis::kOne;
+
+inline int Sign(int32_t value) {
+	return value < 0 ? -1 : 1;
+}
+
+} // namespace
+
+int ScrollAxis::Add(int32_t deltaFixed, DWORD time) {
+	DWORD elapsed = time - lastInputTime_;
+	bool reversed = (deltaFixed < 0) != (accFixed_ < 0) && std::abs(accFixed_) >= kGranuleFixed;
+	bool newGesture = !active_ || elapsed >= kScrollIdleMs || reversed;
+	lastInputTime_ = time;
+	active_ = true;
+
+	if (newGesture) {
+		if (reversed) {
+			// Don't make Live finish scrolling one way before it can go back.
+			accFixed_ = 0;
+		}
+		velocityFixed_ = deltaFixed / (int32_t) kScrollFrameMs;
+		accFixed_ += deltaFixed;
+		// The start of a gesture is where lag shows; send every whole granule now.
+		return Take(kMaxBacklogFixed);
+	}
+
+	int32_t sample = deltaFixed / (int32_t) std::max<DWORD>(elapsed, 1);
+	velocityFixed_ += (sample - velocityFixed_) / 4;
+	accFixed_ = std::max(-kMaxBacklogFixed, std::min(accFixed_ + deltaFixed, kMaxBacklogFixed));
+	return 0;
+}
+
+int ScrollAxis::Tick(DWORD time) {
+	if (!active_) {
+		return 0;
+	}
+	if (time - lastInputTime_ >= kScrollIdleMs) {
+		// The gesture is over. Send the rest, rounded to the nearest granule; the remainder carries
+		// over to the next gesture like the old accumulator did.
+		int granules = (std::abs(accFixed_) + kGranuleFixed / 2) / kGranuleFixed;
+		int delta = Sign(accFixed_) * granules * kScrollGranule;
+		accFixed_ -= delta * kOne;
+		velocityFixed_ = 0;
+		active_ = false;
+		return delta;
+	}
+	// Spread the backlog out at the rate input is arriving, at least a granule a frame, and catch
+	// up quickly if it grows.
+	int32_t budget = std::max(std::abs(velocityFixed_) * (int32_t) kScrollFrameMs, kGranuleFixed);
+	budget = std::max(budget, std::abs(accFixed_) / 2);
+	return Take(budget);
+}
+
+// Removes up to maxFixed worth of whole granules from the accumulator and returns them in wheel
+// units.
+int ScrollAxis::Take(int32_t maxFixed) {
+	int32_t magnitude = std::min(std::abs(accFixed_), maxFixed);
+	int delta = Sign(accFixed_) * (magnitude / kGranuleFixed) * kScrollGranule;
+	accFixed_ -= delta * kOne;
+	return delta;
+}
+
+} // namespace amm
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstdint>
+
+namespace amm {
+
+// How often pending scroll is handed to Live while a gesture is under way.
+constexpr DWORD kScrollFrameMs = 16;
+
+// Scroll is emitted in multiples of this, a quarter notch, rather than only in whole notches.
+constexpr int kScrollGranule = WHEEL_DELTA / 4;
+
+// Scroll state for one axis. Wheel input is accumulated in fixed point, so nothing is lost to
+// rounding, alongside a smoothed estimate of how fast it is arriving. The first input of a gesture
+// goes out straight away; after that, once per frame, Live gets about what arrived in a frame, so
+// bursty trackpad input turns into an even scroll. When the gesture stops, whatever is left is
+// rounded to the nearest granule, so even a tiny swipe moves something.
+class ScrollAxis {
+public:
+	static constexpr int kFractionBits = 8;
+	static constexpr int32_t kOne = 1 << kFractionBits;
+
+	// Converts a raw wheel delta to the fixed-point units Add takes, applying a scale factor.
+	static int32_t Scale(int delta, int numerator, int denominator) {
+		return (int32_t) ((int64_t) delta * numerator * kOne / denominator);
+	}
+
+	// Adds scaled wheel input that arrived at time (ms). Returns the delta to send Live right away,
+	// in wheel units, or 0 to wait for the next frame.
+	int Add(int32_t deltaFixed, DWORD time);
+
+	// Called every kScrollFrameMs while Active(). Returns the delta to send Live this frame.
+	int Tick(DWORD time);
+
+	// True from a gesture's first input until it has gone quiet and been flushed.
+	bool Active() const { return active_; }
+
+private:
+	int Take(int32_t maxFixed);
+
+	int32_t accFixed_ = 0;
+	int32_t velocityFixed_ = 0;  // Per millisecond, smoothed.
+	DWORD lastInputTime_ = 0;
+	bool active_ = false;
+};
+
+} // namespace amm
@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "Settings.h"
+
+#include "InputTranslator.h"
+#include "TraceRecorder.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+namespace amm {
+
+namespace {
+
+struct FeatureKey {
+	const wchar_t* name;
+	uint32_t bit;
+};
+
+const FeatureKey kFeatureKeys[] = {
+	{ L"DigitizerFix", kFeatureDigitizerFix },
+	{ L"TouchPanGesture", kFeatureTouchPanGesture },
+	{ L"TrackpadZoom", kFeatureTrackpadZoom },
+	{ L"ScrollingOverride", kFeatureScrollingOverride },
+	{ L"CtrlShiftZ", kFeatureCtrlShiftZ },
+	{ L"PlusKeyWithoutShift", kFeaturePlusKeyWithoutShift },
+	{ L"SmoothScrolling", kFeatureSmoothScrolling },
+	{ L"MultiTouch", kFeatureMultiTouch },
+	{ L"VirtualPan", kFeatureVirtualPan },
+	{ L"PanInertia", kFeaturePanInertia },
+	{ L"MotionPrediction", kFeatureMotionPrediction },
+};
+
+// AwesomeMouseMode_x64.dll -> AwesomeMouseMode_x64.ini (or another extension), alongside it.
+bool GetSettingsPath(HMODULE module, const wchar_t* extensionName, wchar_t* path, DWORD size) {
+	DWORD length = ::GetModuleFileNameW(module, path, size);
+	if (length == 0 || length >= size) {
+		return false;
+	}
+	wchar_t* extension = wcsrchr(path, L'.');
+	if (!extension || (size_t) (extension - path) + wcslen(extensionName) + 1 > size) {
+		return false;
+	}
+	wcscpy(extension, extensionName);
+	return true;
+}
+
+// Adds the user's remap file, if there is one, to table.
+void LoadKeyRemaps(HMODULE module, KeyRemapTable* table) {
+	wchar_t path[MAX_PATH];
+	if (!GetSettingsPath(module, L".remap", path, MAX_PATH)) {
+		return;
+	}
+	FILE* file = _wfopen(path, L"rb");
+	if (!file) {
+		return;
+	}
+	std::vector<char> text;
+	char buffer[4096];
+	size_t read;
+	while ((read = ::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		text.insert(text.end(), buffer, buffer + read);
+	}
+	::fclose(file);
+	text.push_back('\0');
+	int errorLine = 0;
+	if (!table->Compile(text.data(), 0, &errorLine)) {
+		Trace(TraceEvent::kRemapError, errorLine, table->RuleCount());
+	}
+}
+
+// snprintf onto the end of buffer, keeping whatever fits.
+void Append(char* buffer, size_t size, int* length, const char* format, ...) {
+	if ((size_t) *length + 1 >= size) {
+		return;
+	}
+	va_list args;
+	va_start(args, format);
+	int written = ::vsnprintf(buffer + *length, size - *length, format, args);
+	va_end(args);
+	if (written > 0) {
+		*length = (size_t) (*length + written) < size ? *length + written : (int) size - 1;
+	}
+}
+
+} // namespace
+
+void LoadSettings(HMODULE module, Settings* settings) {
+	settings->features = kDefaultFeatures;
+	settings->asyncSynthesis = false;
+	settings->coalesceMoves = false;
+	settings->predictionLeadMs = MotionPredictor::kDefaultLeadMs;
+	settings->inertiaFriction = PanInertia::kDefaultFriction;
+	settings->zoomStepsPerFrame = ZoomScheduler::kDefaultStepsPerFrame;
+	settings->pen = PenFilter::Config();
+	settings->remap.Clear();
+	CompileBuiltinKeyRemaps(&settings->remap);
+	LoadKeyRemaps(module, &settings->remap);
+
+	wchar_t path[MAX_PATH];
+	if (!GetSettingsPath(module, L".ini", path, MAX_PATH)) {
+		return;
+	}
+	for (const FeatureKey& key : kFeatureKeys) {
+		bool enabled = (kDefaultFeatures & key.bit) != 0;
+		enabled = ::GetPrivateProfileIntW(L"Features", key.name, enabled ? 1 : 0, path) != 0;
+		if (enabled) {
+			settings->features |= key.bit;
+		} else {
+			settings->features &= ~key.bit;
+		}
+	}
+	settings->asyncSynthesis = ::GetPrivateProfileIntW(L"Input", L"AsyncSynthesis", 0, path) != 0;
+	settings->coalesceMoves = ::GetPrivateProfileIntW(L"Input", L"CoalesceMoves", 0, path) != 0;
+	settings->predictionLeadMs = (int) ::GetPrivateProfileIntW(L"Input", L"PredictionLeadMs", MotionPredictor::kDefaultLeadMs, path);
+	settings->inertiaFriction = (int) ::GetPrivateProfileIntW(L"Pan", L"InertiaFriction", PanInertia::kDefaultFriction, path);
+	settings->zoomStepsPerFrame = (int) ::GetPrivateProfileIntW(L"Zoom", L"StepsPerFrame", ZoomScheduler::kDefaultStepsPerFrame, path);
+	PenFilter::Config& pen = settings->pen;
+	pen.deadZone = (int) ::GetPrivateProfileIntW(L"Pen", L"DeadZone", pen.deadZone, path);
+	pen.gainPercent = (int) ::GetPrivateProfileIntW(L"Pen", L"Gain", pen.gainPercent, path);
+	pen.minCutoffTenthsHz = (int) ::GetPrivateProfileIntW(L"Pen", L"MinCutoff", pen.minCutoffTenthsHz, path);
+	pen.betaThousandths = (int) ::GetPrivateProfileIntW(L"Pen", L"Beta", pen.betaThousandths, path);
+}
+
+bool SameSettings(const Settings& a, const Settings& b) {
+	return a.features == b.features && a.asyncSynthesis == b.asyncSynthesis && a.coalesceMoves == b.coalesceMoves &&
+		a.predictionLeadMs == b.predictionLeadMs && a.inertiaFriction == b.inertiaFriction &&
+		a.zoomStepsPerFrame == b.zoomStepsPerFrame && a.pen.deadZone == b.pen.deadZone &&
+		a.pen.gainPercent == b.pen.gainPercent && a.pen.minCutoffTenthsHz == b.pen.minCutoffTenthsHz &&
+		a.pen.betaThousandths == b.pen.betaThousandths && a.remap.Same(b.remap);
+}
+
+int FormatSettings(const Settings& settings, char* buffer, size_t size) {
+	int length = 0;
+	if (size > 0) {
+		buffer[0] = '\0';
+	}
+	Append(buffer, size, &length, "[Features]\n");
+	for (const FeatureKey& key : kFeatureKeys) {
+		Append(buffer, size, &length, "%ls=%d\n", key.name, (settings.features & key.bit) ? 1 : 0);
+	}
+	Append(buffer, size, &length, "\n[Input]\nAsyncSynthesis=%d\nCoalesceMoves=%d\nPredictionLeadMs=%d\n",
+		settings.asyncSynthesis ? 1 : 0, settings.coalesceMoves ? 1 : 0, settings.predictionLeadMs);
+	Append(buffer, size, &length, "\n[Pan]\nInertiaFriction=%d\n", settings.inertiaFriction);
+	Append(buffer, size, &length, "\n[Zoom]\nStepsPerFrame=%d\n", settings.zoomStepsPerFrame);
+	Append(buffer, size, &length, "\n[Pen]\nDeadZone=%d\nGain=%d\nMinCutoff=%d\nBeta=%d\n", settings.pen.deadZone,
+		settings.pen.gainPercent, settings.pen.minCutoffTenthsHz, settings.pen.betaThousandths);
+	return length;
+}
+
+} // namespace amm
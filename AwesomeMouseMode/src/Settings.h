@@ -0,0 +1,67 @@
+#pragma once
+
+#include "KeyRemap.h"
+#include "PenFilter.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace amm {
+
+// User settings, read from AwesomeMouseMode.ini next to the DLL. Anything missing keeps its
+// built-in default.
+//
+//   [Features]
+//   DigitizerFix=1
+//   TouchPanGesture=1
+//   TrackpadZoom=1
+//   ScrollingOverride=1
+//   CtrlShiftZ=1
+//   PlusKeyWithoutShift=1
+//   SmoothScrolling=1
+//   MultiTouch=0
+//   VirtualPan=0
+//   PanInertia=0
+//   MotionPrediction=0
+//
+//   [Input]
+//   AsyncSynthesis=0    ; Send synthetic input from a worker thread instead of Live's UI thread.
+//   CoalesceMoves=0     ; Skip stale mouse moves while Live is falling behind.
+//   PredictionLeadMs=12 ; With MotionPrediction, how far ahead drags are shown, up to 50.
+//
+//   [Pan]
+//   InertiaFriction=4   ; With PanInertia, how quickly a released pan slows, per second.
+//
+//   [Zoom]
+//   StepsPerFrame=2     ; With TrackpadZoom or MultiTouch, the most zoom steps Live gets per frame, up to 8.
+//
+//   [Pen]
+//   DeadZone=3          ; With DigitizerFix, pixels of motion held back until Live catches up.
+//   Gain=100            ; Pen drag speed, in percent.
+//   MinCutoff=50        ; Smoothing of slow pen motion, in 0.1 Hz. Lower is smoother but laggier.
+//   Beta=100            ; How quickly smoothing eases off as the pen speeds up, in 0.001 Hz per px/s.
+//
+// Key remaps come from AwesomeMouseMode.remap, also next to the DLL, in the format described at
+// KeyRemapTable. They are added after the CtrlShiftZ and PlusKeyWithoutShift rules, so they can
+// override those.
+struct Settings {
+	uint32_t features;
+	bool asyncSynthesis;
+	bool coalesceMoves;
+	int predictionLeadMs;
+	int inertiaFriction;
+	int zoomStepsPerFrame;
+	PenFilter::Config pen;
+	KeyRemapTable remap;
+};
+
+void LoadSettings(HMODULE module, Settings* settings);
+
+// Whether two sets of settings behave the same.
+bool SameSettings(const Settings& a, const Settings& b);
+
+// The settings as .ini sections that LoadSettings would read back the same, key remaps aside, for
+// reports to say what they were measured with. Truncates to fit size; returns the length written.
+int FormatSettings(const Settings& settings, char* buffer, size_t size);
+
+} // namespace amm
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace amm {
+
+// Bounded, wait-free single-producer single-consumer ring. Push and Pop never block and never
+// allocate; a full queue is reported to the producer, which decides what to do about it.
+template <typename T, size_t Capacity>
+class SpscQueue {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	// Producer only. Returns false if the queue is full.
+	bool Push(const T& item) {
+		size_t tail = tail_.load(std::memory_order_relaxed);
+		if (tail - headCache_ >= Capacity) {
+			headCache_ = head_.load(std::memory_order_acquire);
+			if (tail - headCache_ >= Capacity) {
+				return false;
+			}
+		}
+		items_[tail & (Capacity - 1)] = item;
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Returns false if the queue is empty.
+	bool Pop(T* item) {
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tailCache_) {
+			tailCache_ = tail_.load(std::memory_order_acquire);
+			if (head == tailCache_) {
+				return false;
+			}
+		}
+		*item = items_[head & (Capacity - 1)];
+		head_.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only. Looks at the next item without removing it.
+	const T* Peek() {
+		size_t head = head_.load(std::memory_order_relaxed);
+		if (head == tailCache_) {
+			tailCache_ = tail_.load(std::memory_order_acquire);
+			if (head == tailCache_) {
+				return nullptr;
+			}
+		}
+		return &items_[head & (Capacity - 1)];
+	}
+
+	// Producer only. A lower bound on how many more items Push will accept.
+	size_t FreeSlots() {
+		headCache_ = head_.load(std::memory_order_acquire);
+		return Capacity - (tail_.load(std::memory_order_relaxed) - headCache_);
+	}
+
+	bool Empty() const {
+		return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+	}
+
+private:
+	// Producer and consumer indices live on separate cache lines, each next to its own cached copy
+	// of the other side's index.
+	alignas(64) std::atomic<size_t> tail_{ 0 };
+	size_t headCache_ = 0;
+	alignas(64) std::atomic<size_t> head_{ 0 };
+	size_t tailCache_ = 0;
+	alignas(64) T items_[Capacity];
+};
+
+} // namespace amm
@@ -0,0 +1,167 @@
+#include "TouchRecognizer.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace amm {
+
+namespace {
+
+// How far the centroid must move before two contacts are a pan.
+constexpr int kPanSlopPx = 8;
+// How much the distance between them must change before they are a pinch.
+constexpr int kPinchSlopPx = 16;
+// Change in distance per zoom step, once pinching.
+constexpr int kPinchStepPx = 48;
+
+int Spread(int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+	double dx = (double) x1 - x0;
+	double dy = (double) y1 - y0;
+	return (int) std::lround(std::sqrt(dx * dx + dy * dy));
+}
+
+} // namespace
+
+TouchGesture TouchRecognizer::Process(const TouchFrame* frames, int count) {
+	TouchGesture gesture;
+	for (int i = 0; i < count; ++i) {
+		ProcessFrame(frames[i], &gesture);
+	}
+	return gesture;
+}
+
+// The slot for a contact, claiming a free one if it's new. Returns -1 if every slot is taken.
+int TouchRecognizer::Slot(uint32_t id) {
+	int free = -1;
+	for (int i = 0; i < kMaxTouchContacts; ++i) {
+		if (active_[i] && ids_[i] == id) {
+			return i;
+		}
+		if (!active_[i] && free < 0) {
+			free = i;
+		}
+	}
+	if (free >= 0) {
+		ids_[free] = id;
+		active_[free] = true;
+		++activeCount_;
+	}
+	return free;
+}
+
+void TouchRecognizer::ProcessFrame(const TouchFrame& frame, TouchGesture* gesture) {
+	uint32_t count = frame.count < (uint32_t) kMaxTouchContacts ? frame.count : (uint32_t) kMaxTouchContacts;
+	bool lifted[kMaxTouchContacts];
+	for (int slot = 0; slot < kMaxTouchContacts; ++slot) {
+		// A frame lists every contact that's down, so anything missing from it has gone.
+		lifted[slot] = true;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		const TouchContact& contact = frame.contacts[i];
+		int slot = Slot(contact.id);
+		if (slot < 0) {
+			continue;
+		}
+		x_[slot] = contact.x;
+		y_[slot] = contact.y;
+		lifted[slot] = (contact.flags & kTouchUp) != 0;
+	}
+
+	// Only exactly two contacts make a gesture; a third hand on the screen just holds things.
+	if (activeCount_ == 2) {
+		int a = -1;
+		int b = -1;
+		for (int i = 0; i < kMaxTouchContacts; ++i) {
+			if (active_[i]) {
+				(a < 0 ? a : b) = i;
+			}
+		}
+		POINT centroid = { (x_[a] + x_[b]) / 2, (y_[a] + y_[b]) / 2 };
+		int spread = Spread(x_[a], y_[a], x_[b], y_[b]);
+		switch (mode_) {
+		case Mode::kIdle:
+			mode_ = Mode::kPending;
+			anchorCentroid_ = centroid;
+			anchorSpread_ = spread;
+			pendingSince_ = frame.time;
+			break;
+		case Mode::kPending:
+			if (std::abs(centroid.x - anchorCentroid_.x) >= kPanSlopPx || std::abs(centroid.y - anchorCentroid_.y) >= kPanSlopPx) {
+				mode_ = Mode::kPan;
+				gesture->panFlags |= GF_BEGIN;
+				gesture->recognitionMs = (int) (frame.time - pendingSince_);
+			} else if (std::abs(spread - anchorSpread_) >= kPinchSlopPx) {
+				mode_ = Mode::kPinch;
+				pinchSpread_ = anchorSpread_;
+				gesture->recognitionMs = (int) (frame.time - pendingSince_);
+			}
+			break;
+		default:
+			break;
+		}
+		if (mode_ == Mode::kPan) {
+			panCentroid_ = centroid;
+			gesture->panning = true;
+			gesture->panLocation = centroid;
+		} else if (mode_ == Mode::kPinch) {
+			int steps = (spread - pinchSpread_) / kPinchStepPx;
+			pinchSpread_ += steps * kPinchStepPx;
+			gesture->zoomSteps += steps;
+			gesture->pinchScale = anchorSpread_ > 0 ? (float) spread / anchorSpread_ : 1.0f;
+		}
+	} else if (mode_ != Mode::kIdle) {
+		EndGesture(gesture);
+	}
+
+	for (int slot = 0; slot < kMaxTouchContacts; ++slot) {
+		if (active_[slot] && lifted[slot]) {
+			active_[slot] = false;
+			--activeCount_;
+		}
+	}
+	if (activeCount_ < 2 && mode_ != Mode::kIdle) {
+		// A contact lifted in this frame; the gesture ends with it.
+		EndGesture(gesture);
+	}
+}
+
+// A pan ends where the two contacts last were, not wherever a third one or the lifting one went.
+void TouchRecognizer::EndGesture(TouchGesture* gesture) {
+	if (mode_ == Mode::kPan) {
+		gesture->panFlags |= GF_END;
+		gesture->panning = true;
+		gesture->panLocation = panCentroid_;
+	}
+	mode_ = Mode::kIdle;
+}
+
+TouchRecorder::~TouchRecorder() {
+	if (file_) {
+		::fclose(file_);
+	}
+}
+
+bool TouchRecorder::Open(const char* path) {
+	if (file_) {
+		::fclose(file_);
+	}
+	file_ = ::fopen(path, "wb");
+	if (!file_) {
+		return false;
+	}
+	TouchStreamHeader header;
+	::memset(&header, 0, sizeof(header));
+	header.magic = TouchStreamHeader::kMagic;
+	header.version = TouchStreamHeader::kVersion;
+	header.frameSize = sizeof(TouchFrame);
+	return ::fwrite(&header, sizeof(header), 1, file_) == 1;
+}
+
+void TouchRecorder::Append(const TouchFrame* frames, int count) {
+	if (file_ && count > 0) {
+		::fwrite(frames, sizeof(TouchFrame), count, file_);
+	}
+}
+
+} // namespace amm
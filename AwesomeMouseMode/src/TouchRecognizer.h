@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace amm {
+
+constexpr int kMaxTouchContacts = 10;
+// Pointer history frames taken from a single WM_POINTER message.
+constexpr int kMaxTouchHistory = 32;
+
+// Bits for TouchContact::flags.
+constexpr uint32_t kTouchDown = 0x01;  // The contact landed in this frame.
+constexpr uint32_t kTouchUp = 0x02;    // The contact lifted (or was cancelled) in this frame.
+
+// One contact in a pointer frame, in client coordinates. Also the contact stream file format.
+struct TouchContact {
+	uint32_t id;
+	int32_t x;
+	int32_t y;
+	uint32_t flags;
+};
+
+// Every contact's state at one instant, as GetPointerFrameTouchInfo reports it.
+struct TouchFrame {
+	uint32_t time;  // Milliseconds.
+	uint32_t count;
+	TouchContact contacts[kMaxTouchContacts];
+};
+
+// What a run of frames amounted to.
+struct TouchGesture {
+	DWORD panFlags = 0;           // GF_BEGIN and/or GF_END, as for GID_PAN.
+	bool panning = false;         // A two-finger pan is in progress (or just ended).
+	POINT panLocation = { 0, };   // Latest centroid of the two contacts, also when the pan ends.
+	int zoomSteps = 0;            // Pinch, in zoom steps; positive spreads apart.
+	float pinchScale = 0;         // While pinching: spread relative to where the pinch began.
+	int recognitionMs = -1;       // If recognized in these frames: how long after two contacts were down.
+};
+
+// Two-finger pan and pinch recognizer, fed whole pointer frames. Contact state lives in fixed-size
+// parallel arrays, and a message's full pointer history is consumed in one pass, so coalesced frames
+// aren't lost and cost nothing extra to look up.
+//
+// It commits to pan or pinch as soon as the contacts have moved a few pixels together or apart,
+// well before the system's gesture engine would report GID_PAN.
+class TouchRecognizer {
+public:
+	// Processes frames, oldest first.
+	TouchGesture Process(const TouchFrame* frames, int count);
+
+	// True while two or more contacts are down, or a gesture hasn't finished; pointer messages then
+	// belong to us rather than to Live.
+	bool Engaged() const { return activeCount_ >= 2 || mode_ != Mode::kIdle; }
+	int ActiveCount() const { return activeCount_; }
+
+private:
+	enum class Mode : uint8_t {
+		kIdle,
+		kPending,  // Two contacts down; not yet sure what they're doing.
+		kPan,
+		kPinch,
+	};
+
+	int Slot(uint32_t id);
+	void ProcessFrame(const TouchFrame& frame, TouchGesture* gesture);
+	void EndGesture(TouchGesture* gesture);
+
+	uint32_t ids_[kMaxTouchContacts];
+	int32_t x_[kMaxTouchContacts];
+	int32_t y_[kMaxTouchContacts];
+	bool active_[kMaxTouchContacts] = {};
+	int activeCount_ = 0;
+
+	Mode mode_ = Mode::kIdle;
+	POINT anchorCentroid_ = { 0, };
+	POINT panCentroid_ = { 0, };  // Of the two contacts, as of the pan's latest frame.
+	int anchorSpread_ = 0;
+	int pinchSpread_ = 0;  // Spread at which the last zoom step was taken.
+	uint32_t pendingSince_ = 0;
+};
+
+// Contact stream file: a TouchStreamHeader followed by TouchFrames, as they arrived. Lets the
+// recognizer be exercised from real captures on any platform, with tools/TouchReplay.
+struct TouchStreamHeader {
+	static constexpr uint32_t kMagic = 0x434d4d41;  // "AMMC".
+	static constexpr uint16_t kVersion = 1;
+
+	uint32_t magic;
+	uint16_t version;
+	uint16_t frameSize;
+};
+
+// Appends pointer frames to a contact stream file.
+class TouchRecorder {
+public:
+	~TouchRecorder();
+
+	bool Open(const char* path);
+	void Append(const TouchFrame* frames, int count);
+
+private:
+	FILE* file_ = nullptr;
+};
+
+} // namespace amm
@@ -0,0 +1,63 @@
+#include "TraceRecorder.h"
+
+#include <cstring>
+#include <vector>
+
+namespace amm {
+
+TraceRecorder gTraceRecorder;
+
+TraceRecorder::TraceRecorder()
+	: startTicks_(ReadCycleCounter()),
+	  startTime_(std::chrono::steady_clock::now()) {
+	for (TraceRecord& record : records_) {
+		record.sequence.store(0, std::memory_order_relaxed);
+	}
+}
+
+bool TraceRecorder::WriteDump(FILE* out) const {
+	uint32_t head = head_.load(std::memory_order_acquire);
+	uint32_t first = head > kCapacity ? head - kCapacity : 0;
+
+	std::vector<TraceDumpRecord> dump;
+	dump.reserve(head - first);
+	for (uint32_t index = first; index != head; ++index) {
+		const TraceRecord& record = records_[index & (kCapacity - 1)];
+		TraceDumpRecord copy;
+		copy.sequence = record.sequence.load(std::memory_order_acquire);
+		copy.timestamp = record.timestamp;
+		copy.event = record.event;
+		copy.reserved = 0;
+		::memcpy(copy.args, record.args, sizeof(copy.args));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (copy.sequence != index + 1 || record.sequence.load(std::memory_order_relaxed) != copy.sequence) {
+			// Overwritten or still being written while we looked.
+			continue;
+		}
+		dump.push_back(copy);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+	TraceDumpHeader header;
+	header.magic = TraceDumpHeader::kMagic;
+	header.version = TraceDumpHeader::kVersion;
+	header.recordSize = (uint16_t) sizeof(TraceDumpRecord);
+	header.recordCount = (uint32_t) dump.size();
+	header.droppedCount = head - header.recordCount;
+	header.ticksPerSecond = seconds > 0 ? (ReadCycleCounter() - startTicks_) / seconds : 0;
+	if (::fwrite(&header, sizeof(header), 1, out) != 1) {
+		return false;
+	}
+	return dump.empty() || ::fwrite(dump.data(), sizeof(TraceDumpRecord), dump.size(), out) == dump.size();
+}
+
+bool WriteTraceDump(const char* path) {
+	FILE* out = ::fopen(path, "wb");
+	if (!out) {
+		return false;
+	}
+	bool ok = gTraceRecorder.WriteDump(out);
+	return ::fclose(out) == 0 && ok;
+}
+
+} // namespace amm
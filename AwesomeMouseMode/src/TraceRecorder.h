@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace amm {
+
+// Every kind of trace record, with the format the decoder prints its four arguments with. Keep
+// additions at the end so old dumps still decode.
+#define AMM_TRACE_EVENTS(X) \
+	X(kMessage, "msg=0x%04x wParam=0x%x lParam=0x%x extra=0x%08x (0 = not fetched)") \
+	X(kButtonDown, "BUTTONDOWN: [%d, %d]") \
+	X(kDoubleClickReset, "DBLCLK Reset: [%d, %d]") \
+	X(kPanForceUp, "MOUSEMOVE: Force Pan Gesture Up") \
+	X(kMouseMove, "MOUSEMOVE [%d, %d] Cursor: %d Pen: %d") \
+	X(kDigitizerHold, "Hold at [%d, %d] Reason: %d (0 = modifier, 1 = small delta, 2 = roll in old dumps)") \
+	X(kDigitizerMove, "[%d, %d] -> [%d, %d]") \
+	X(kDigitizerReset, "Reset: [%d, %d] Errant: %d") \
+	X(kPanGesture, "GID_PAN: %d %d, [%d, %d]") \
+	X(kSyntheticEmit, "Worker emitted %d inputs in %d calls, queued %d us, emit %d us") \
+	X(kMoveCoalesced, "Dropped MOUSEMOVE [%d, %d], Live takes %d us, %d dropped so far") \
+	X(kTouchGesture, "Touch pan: flags %d, %d contacts, [%d, %d]") \
+	X(kHookCoverage, "Hooked %d existing windows, skipped %d, in %d us") \
+	X(kRemapError, "Remap file line %d not understood, %d rules in effect") \
+	X(kCoordinatesRefreshed, "Window client at [%d, %d], %d DPI on a %d DPI monitor") \
+	X(kRegistryFull, "Window 0x%x left unhooked: all %d slots in use, %d windows skipped so far")
+
+enum class TraceEvent : uint16_t {
+#define AMM_TRACE_ENUM(name, format) name,
+	AMM_TRACE_EVENTS(AMM_TRACE_ENUM)
+#undef AMM_TRACE_ENUM
+	kCount,
+};
+
+// One compact binary trace record. The sequence number is written last, so a reader can tell a
+// complete record from one that is being overwritten.
+struct TraceRecord {
+	uint64_t timestamp;  // ReadCycleCounter().
+	std::atomic<uint32_t> sequence;  // Record number + 1, or 0 while being written.
+	uint16_t event;
+	uint16_t reserved;
+	int32_t args[4];
+};
+
+// Header of a trace dump file, followed by recordCount TraceDumpRecords, oldest first. Decoded by
+// tools/TraceDecode.
+struct TraceDumpHeader {
+	static constexpr uint32_t kMagic = 0x544d4d41;  // "AMMT".
+	static constexpr uint16_t kVersion = 1;
+
+	uint32_t magic;
+	uint16_t version;
+	uint16_t recordSize;
+	uint32_t recordCount;
+	uint32_t droppedCount;  // Records overwritten before they could be dumped.
+	double ticksPerSecond;
+};
+
+struct TraceDumpRecord {
+	uint64_t timestamp;
+	uint32_t sequence;
+	uint16_t event;
+	uint16_t reserved;
+	int32_t args[4];
+};
+
+inline uint64_t ReadCycleCounter() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t) std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+// Fixed-size, always-on ring of trace records. Recording is a fetch_add and a handful of stores,
+// cheap enough to leave on in release builds. Any thread may record; the oldest records are
+// overwritten once the ring is full.
+class TraceRecorder {
+public:
+	static constexpr uint32_t kCapacity = 1 << 14;
+
+	TraceRecorder();
+
+	void Record(TraceEvent event, int32_t a0, int32_t a1, int32_t a2, int32_t a3) {
+		uint32_t index = head_.fetch_add(1, std::memory_order_relaxed);
+		TraceRecord& record = records_[index & (kCapacity - 1)];
+		record.sequence.store(0, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		record.timestamp = ReadCycleCounter();
+		record.event = (uint16_t) event;
+		record.args[0] = a0;
+		record.args[1] = a1;
+		record.args[2] = a2;
+		record.args[3] = a3;
+		record.sequence.store(index + 1, std::memory_order_release);
+	}
+
+	// Writes everything still in the ring to out, in dump file format.
+	bool WriteDump(FILE* out) const;
+
+private:
+	std::atomic<uint32_t> head_{ 0 };
+	uint64_t startTicks_;
+	std::chrono::steady_clock::time_point startTime_;
+	TraceRecord records_[kCapacity];
+};
+
+extern TraceRecorder gTraceRecorder;
+
+inline void Trace(TraceEvent event, int32_t a0 = 0, int32_t a1 = 0, int32_t a2 = 0, int32_t a3 = 0) {
+	gTraceRecorder.Record(event, a0, a1, a2, a3);
+}
+
+// Writes the global trace to a file. Returns false if it couldn't be written.
+bool WriteTraceDump(const char* path);
+
+} // namespace amm
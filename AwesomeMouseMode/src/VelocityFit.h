@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstdint>
+
+namespace amm {
+
+// A pointer position at time (ms), as MotionPredictor and PanInertia collect them.
+struct MotionSample {
+	int32_t x;
+	int32_t y;
+	DWORD time;
+};
+
+// Velocity in pixels per millisecond at newest.time: the least-squares slope of position against
+// time over the samples at most windowMs older than newest, which is far less jittery than the last
+// two samples' difference. The samples may be in any order. Returns false if fewer than two are
+// recent enough, or they all share a time.
+inline bool FitVelocity(const MotionSample* samples, int count, const MotionSample& newest, DWORD windowMs,
+	double* velocityX, double* velocityY) {
+	double sumT = 0;
+	double sumX = 0;
+	double sumY = 0;
+	double sumTT = 0;
+	double sumTX = 0;
+	double sumTY = 0;
+	int n = 0;
+	for (int i = 0; i < count; ++i) {
+		const MotionSample& sample = samples[i];
+		DWORD age = newest.time - sample.time;
+		if (age > windowMs) {
+			continue;
+		}
+		double t = -(double) age;
+		sumT += t;
+		sumX += sample.x;
+		sumY += sample.y;
+		sumTT += t * t;
+		sumTX += t * sample.x;
+		sumTY += t * sample.y;
+		++n;
+	}
+	double denominator = n * sumTT - sumT * sumT;
+	if (n < 2 || denominator <= 0) {
+		return false;
+	}
+	*velocityX = (n * sumTX - sumT * sumX) / denominator;
+	*velocityY = (n * sumTY - sumT * sumY) / denominator;
+	return true;
+}
+
+} // namespace amm
@@ -1,27 +1,74 @@
 
 #include "stdafx.h"
 #include "vstsdk2.4/public.sdk/source/vst2.x/audioeffectx.h"
+#include "AudioPassThrough.h"
+#include "GestureParameters.h"
 
 namespace {
 
+// The plugin only exists to get the hook loaded into Live, so the audio goes straight through. Its
+// parameters follow the gestures the hook sees, for mapping or recording as automation; the first
+// instance to process audio receives them, others just report the latest values.
 class EmptyAudioEffect : public AudioEffectX {
 public:
 	typedef AudioEffectX BaseClass;
+	static constexpr int kChannels = 2;
+	static constexpr int kMaxParameterEvents = 64;
 
 	EmptyAudioEffect(audioMasterCallback audioMaster)
-		: BaseClass(audioMaster, 1, 0) {
-		this->setNumInputs(2);
-		this->setNumOutputs(2);
+		: BaseClass(audioMaster, 1, amm::kGestureParameters) {
+		this->setNumInputs(kChannels);
+		this->setNumOutputs(kChannels);
 		this->isSynth(false);
 		this->setUniqueID(*reinterpret_cast<const int*>("amml"));  //This code should be registered with Steinberg to ensure uniqueness.
 		this->canDoubleReplacing(true);
+		// No noTail(true), even though silence in gives silence out: hosts would stop calling
+		// processReplacing on a silent track, the usual place for us, and with it the gesture
+		// parameters would stop.
 	}
 	virtual ~EmptyAudioEffect() {
+		amm::gGestureParameters.Release(this);
 	}
 
 	virtual void processReplacing(float** inputs, float** outputs, VstInt32 sampleFrames) override {
+		TakeGestureParameters();
+		amm::PassThrough(inputs, outputs, kChannels, sampleFrames);
 	}
 	virtual void processDoubleReplacing(double** inputs, double** outputs, VstInt32 sampleFrames) override {
+		TakeGestureParameters();
+		amm::PassThrough(inputs, outputs, kChannels, sampleFrames);
+	}
+
+	// The parameters are driven by gestures; what the host writes back is ignored.
+	virtual void setParameter(VstInt32 index, float value) override {
+	}
+	virtual float getParameter(VstInt32 index) override {
+		if (index < 0 || index >= amm::kGestureParameters) {
+			return 0;
+		}
+		return amm::gGestureParameters.Value((amm::GestureParameter) index);
+	}
+	virtual void getParameterName(VstInt32 index, char* text) override {
+		if (index >= 0 && index < amm::kGestureParameters) {
+			vst_strncpy(text, amm::GestureParameterName((amm::GestureParameter) index), kVstMaxParamStrLen);
+		}
+	}
+	virtual void getParameterLabel(VstInt32 index, char* label) override {
+		if (index >= 0 && index < amm::kGestureParameters) {
+			vst_strncpy(label, amm::GestureParameterLabel((amm::GestureParameter) index), kVstMaxParamStrLen);
+		}
+	}
+	virtual void getParameterDisplay(VstInt32 index, char* text) override {
+		if (index >= 0 && index < amm::kGestureParameters) {
+			amm::GestureParameter parameter = (amm::GestureParameter) index;
+			float2string(amm::DenormalizeGestureParameter(parameter, getParameter(index)), text, kVstMaxParamStrLen);
+		}
+	}
+
+	// Soft bypass: the host keeps calling processReplacing either way, and that already passes the
+	// audio straight through, so there is nothing to switch.
+	virtual bool setBypass(bool onOff) override {
+		return true;
 	}
 
 	virtual bool getEffectName(char* name) override {
@@ -39,9 +86,28 @@ public:
 	virtual VstInt32 getVendorVersion() override {
 		return 0;
 	}
+	// "bypass" only tells the host setBypass works; VST 2 has no way to let it skip processing.
 	virtual VstInt32 canDo(char* text) override {
+		if (strcmp(text, "bypass") == 0) {
+			return 1;
+		}
 		return 0;
 	}
+
+private:
+	// Report the gesture updates that arrived since the last block to the host, oldest first. VST 2
+	// automation carries no sample offset, so they all apply at the start of the block. Nothing here
+	// blocks or allocates.
+	void TakeGestureParameters() {
+		if (!amm::gGestureParameters.Claim(this)) {
+			return;
+		}
+		amm::GestureParameterEvent events[kMaxParameterEvents];
+		int count = amm::gGestureParameters.TakeBlock(amm::GestureClockNanos(), events, kMaxParameterEvents);
+		for (int i = 0; i < count; ++i) {
+			setParameterAutomated((VstInt32) events[i].parameter, events[i].value);
+		}
+	}
 };
 
 } // namespace
@@ -0,0 +1,86 @@
+#pragma once
+
+// Windows types and message constants used by the platform-neutral input code. On Windows these
+// come straight from windows.h. Elsewhere we define just the subset we need, so the translation
+// core can be built and exercised without a live Ableton window.
+
+#if defined(_WIN32)
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <windowsx.h>
+
+#else
+
+#include <cstdint>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t UINT;
+typedef uint64_t ULONGLONG;
+typedef uintptr_t WPARAM;
+typedef intptr_t LPARAM;
+typedef intptr_t LRESULT;
+
+struct POINT {
+	LONG x;
+	LONG y;
+};
+
+struct RECT {
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+
+#define LOWORD(l) ((WORD) (((uintptr_t) (l)) & 0xffff))
+#define HIWORD(l) ((WORD) ((((uintptr_t) (l)) >> 16) & 0xffff))
+#define LOBYTE(w) ((BYTE) (((uintptr_t) (w)) & 0xff))
+#define HIBYTE(w) ((BYTE) ((((uintptr_t) (w)) >> 8) & 0xff))
+#define MAKELONG(a, b) ((LONG) (((WORD) (((uintptr_t) (a)) & 0xffff)) | ((DWORD) ((WORD) (((uintptr_t) (b)) & 0xffff))) << 16))
+#define MAKEWPARAM(l, h) ((WPARAM) (DWORD) MAKELONG(l, h))
+#define MAKELPARAM(l, h) ((LPARAM) (DWORD) MAKELONG(l, h))
+#define GET_X_LPARAM(lp) ((int) (short) LOWORD(lp))
+#define GET_Y_LPARAM(lp) ((int) (short) HIWORD(lp))
+#define GET_WHEEL_DELTA_WPARAM(wParam) ((short) HIWORD(wParam))
+
+#define WM_KEYDOWN 0x0100
+#define WM_KEYUP 0x0101
+#define WM_CHAR 0x0102
+#define WM_SYSKEYDOWN 0x0104
+#define WM_TIMER 0x0113
+#define WM_GESTURE 0x0119
+#define WM_GESTURENOTIFY 0x011A
+#define WM_MOUSEMOVE 0x0200
+#define WM_LBUTTONDOWN 0x0201
+#define WM_LBUTTONUP 0x0202
+#define WM_LBUTTONDBLCLK 0x0203
+#define WM_MOUSEWHEEL 0x020A
+#define WM_MOUSEHWHEEL 0x020E
+#define WM_POINTERUPDATE 0x0245
+#define WM_POINTERDOWN 0x0246
+#define WM_POINTERUP 0x0247
+
+#define MK_LBUTTON 0x0001
+#define MK_RBUTTON 0x0002
+#define MK_SHIFT 0x0004
+#define MK_CONTROL 0x0008
+#define MK_MBUTTON 0x0010
+
+#define VK_SHIFT 0x10
+#define VK_CONTROL 0x11
+#define VK_MENU 0x12
+#define VK_OEM_PLUS 0xBB
+#define VK_OEM_MINUS 0xBD
+
+#define GID_PAN 4
+#define GF_BEGIN 0x00000001
+#define GF_INERTIA 0x00000002
+#define GF_END 0x00000004
+
+#define WHEEL_DELTA 120
+
+#endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace amm {
+
+// Read-mostly map from a window handle to its original WndProc, for the handful of windows we hook.
+//
+// Keys and values live in flat, cache-line aligned arrays guarded by a single sequence counter
+// (seqlock style). Find() takes no locks and never allocates, so it is safe to call on every
+// message. Insert() and Erase() must be serialized by the caller; MapWindow and UnmapWindow do that
+// with gStateLock.
+class WindowRegistry {
+public:
+	// Live has a window for every plugin editor and detached view the user opens, and each is
+	// hooked. Lookups only scan up to the highest slot in use, so headroom costs nothing per
+	// message.
+	static constexpr int kCapacity = 64;
+
+	// Looks up key. Returns the slot index, or -1 if the key isn't registered. Lock-free.
+	int Find(uintptr_t key, uintptr_t* value) const {
+		for (;;) {
+			uint32_t sequence = sequence_.load(std::memory_order_acquire);
+			if (sequence & 1) {
+				// A writer is mid-update. They only ever hold this for a few stores.
+				continue;
+			}
+			int index = -1;
+			uintptr_t found = 0;
+			int count = count_.load(std::memory_order_relaxed);
+			for (int i = 0; i < count; ++i) {
+				if (keys_[i].load(std::memory_order_relaxed) == key) {
+					index = i;
+					found = values_[i].load(std::memory_order_relaxed);
+					break;
+				}
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (sequence_.load(std::memory_order_relaxed) == sequence) {
+				*value = found;
+				return index;
+			}
+		}
+	}
+
+	// Registers key. Returns the slot index, or -1 if the registry is full. Free slots for which
+	// reusable returns false are passed over. Writers only.
+	template <typename Reusable>
+	int Insert(uintptr_t key, uintptr_t value, Reusable reusable) {
+		int count = count_.load(std::memory_order_relaxed);
+		int index = -1;
+		for (int i = 0; i < count; ++i) {
+			if (keys_[i].load(std::memory_order_relaxed) == 0 && reusable(i)) {
+				index = i;
+				break;
+			}
+		}
+		for (int i = count; index < 0 && i < kCapacity; ++i) {
+			if (reusable(i)) {
+				index = i;
+			}
+		}
+		if (index < 0) {
+			return -1;
+		}
+		BeginWrite();
+		values_[index].store(value, std::memory_order_relaxed);
+		// seq_cst like KeyAt, so a caller's check in reusable and a handler's recheck of the slot
+		// can't both miss each other.
+		keys_[index].store(key, std::memory_order_seq_cst);
+		if (index >= count) {
+			count_.store(index + 1, std::memory_order_relaxed);
+		}
+		EndWrite();
+		return index;
+	}
+
+	int Insert(uintptr_t key, uintptr_t value) {
+		return Insert(key, value, [](int) { return true; });
+	}
+
+	// The key registered at index, or 0. For checking a slot from Find is still the same window's;
+	// ordered against Insert and Erase's key stores.
+	uintptr_t KeyAt(int index) const { return keys_[index].load(std::memory_order_seq_cst); }
+
+	// Unregisters key. Returns false if it wasn't registered. Writers only.
+	bool Erase(uintptr_t key) {
+		int count = count_.load(std::memory_order_relaxed);
+		for (int i = 0; i < count; ++i) {
+			if (keys_[i].load(std::memory_order_relaxed) != key) {
+				continue;
+			}
+			BeginWrite();
+			keys_[i].store(0, std::memory_order_seq_cst);
+			values_[i].store(0, std::memory_order_relaxed);
+			while (count > 0 && keys_[count - 1].load(std::memory_order_relaxed) == 0) {
+				--count;
+			}
+			count_.store(count, std::memory_order_relaxed);
+			EndWrite();
+			return true;
+		}
+		return false;
+	}
+
+	// Returns any registered key, or 0 if empty. Writers only, for tearing everything down.
+	uintptr_t AnyKey() const {
+		int count = count_.load(std::memory_order_relaxed);
+		for (int i = 0; i < count; ++i) {
+			uintptr_t key = keys_[i].load(std::memory_order_relaxed);
+			if (key != 0) {
+				return key;
+			}
+		}
+		return 0;
+	}
+
+private:
+	void BeginWrite() {
+		sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+	void EndWrite() {
+		sequence_.store(sequence_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	alignas(64) std::atomic<uint32_t> sequence_{ 0 };
+	std::atomic<int> count_{ 0 };
+	alignas(64) std::atomic<uintptr_t> keys_[kCapacity] = {};
+	alignas(64) std::atomic<uintptr_t> values_[kCapacity] = {};
+};
+
+} // namespace amm
@@ -0,0 +1,120 @@
+#include "ZoomScheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace amm {
+
+namespace {
+
+// A gap this long between inputs ends a gesture.
+constexpr DWORD kZoomIdleMs = 60;
+
+// Never let more than this many frames' worth of steps pile up behind the budget.
+constexpr int kMaxBacklogFrames = 4;
+
+constexpr int32_t kStepFixed = WHEEL_DELTA * ZoomScheduler::kOne;
+
+// Acceleration curve: input arriving at or below kSlowVelocity (wheel units per ms; one step every
+// 120 ms) counts kSlowGainPercent, at or above kFastVelocity (about a step a frame) face value, and
+// linearly in between.
+constexpr int32_t kSlowVelocityFixed = 1 * ZoomScheduler::kOne;
+constexpr int32_t kFastVelocityFixed = 8 * ZoomScheduler::kOne;
+constexpr int kSlowGainPercent = 160;
+
+inline int Sign(int32_t value) {
+	return value < 0 ? -1 : 1;
+}
+
+int GainPercent(int32_t velocityFixed) {
+	int32_t speed = std::abs(velocityFixed);
+	if (speed <= kSlowVelocityFixed) {
+		return kSlowGainPercent;
+	}
+	if (speed >= kFastVelocityFixed) {
+		return 100;
+	}
+	return kSlowGainPercent - (kSlowGainPercent - 100) * (speed - kSlowVelocityFixed) / (kFastVelocityFixed - kSlowVelocityFixed);
+}
+
+} // namespace
+
+void ZoomScheduler::SetBudget(int stepsPerFrame) {
+	stepsPerFrame_ = std::max(1, std::min(stepsPerFrame, kMaxStepsPerFrame));
+}
+
+int ZoomScheduler::Add(int delta, DWORD time) {
+	if (delta == 0) {
+		return 0;
+	}
+	DWORD elapsed = time - lastInputTime_;
+	bool reversed = active_ && (delta < 0) != (accFixed_ < 0) && std::abs(accFixed_) >= kStepFixed / 2;
+	bool newGesture = !active_ || elapsed >= kZoomIdleMs || reversed;
+	lastInputTime_ = time;
+	active_ = true;
+
+	if (newGesture) {
+		if (reversed) {
+			// Whatever is still queued the old way would only be undone again; don't make Live draw it.
+			reversedSteps_ += std::abs(accFixed_) / kStepFixed;
+			accFixed_ = 0;
+		}
+		velocityFixed_ = delta * kOne / (int32_t) kZoomFrameMs;
+		stepped_ = false;
+	} else {
+		int32_t sample = delta * kOne / (int32_t) std::max<DWORD>(elapsed, 1);
+		velocityFixed_ += (sample - velocityFixed_) / 4;
+	}
+
+	accFixed_ += (int32_t) ((int64_t) delta * kOne * GainPercent(velocityFixed_) / 100);
+	int32_t maxBacklogFixed = stepsPerFrame_ * kMaxBacklogFrames * kStepFixed;
+	if (std::abs(accFixed_) > maxBacklogFixed) {
+		overflowSteps_ += (std::abs(accFixed_) - maxBacklogFixed) / kStepFixed;
+		accFixed_ = Sign(accFixed_) * maxBacklogFixed;
+	}
+
+	if (stepped_ || std::abs(accFixed_) < kStepFixed / 2) {
+		return 0;
+	}
+	// The start of a gesture is where lag shows, and where a slow pinch would otherwise feel dead:
+	// send the first step as soon as half of it is in. The overshoot is paid back by later input.
+	int steps = std::min((std::abs(accFixed_) + kStepFixed / 2) / kStepFixed, stepsPerFrame_);
+	int signedSteps = Sign(accFixed_) * steps;
+	accFixed_ -= signedSteps * kStepFixed;
+	stepped_ = true;
+	return signedSteps;
+}
+
+int ZoomScheduler::Tick(DWORD time) {
+	if (!active_) {
+		return 0;
+	}
+	if (time - lastInputTime_ >= kZoomIdleMs) {
+		// The gesture is over. Send the rest, rounded to the nearest step; the remainder carries
+		// over to the next gesture like the old accumulator did.
+		int steps = std::min((std::abs(accFixed_) + kStepFixed / 2) / kStepFixed, stepsPerFrame_);
+		int signedSteps = Sign(accFixed_) * steps;
+		accFixed_ -= signedSteps * kStepFixed;
+		velocityFixed_ = 0;
+		active_ = false;
+		stepped_ = false;
+		return signedSteps;
+	}
+	// About what arrives in a frame, at least a step and at most the budget.
+	int32_t perFrameFixed = std::abs(velocityFixed_) * (int32_t) kZoomFrameMs;
+	int steps = std::max(1, std::min((int) ((perFrameFixed + kStepFixed - 1) / kStepFixed), stepsPerFrame_));
+	return Take(steps);
+}
+
+// Removes up to maxSteps whole steps from the accumulator and returns them, signed.
+int ZoomScheduler::Take(int maxSteps) {
+	int steps = std::min(std::abs(accFixed_) / kStepFixed, maxSteps);
+	int signedSteps = Sign(accFixed_) * steps;
+	accFixed_ -= signedSteps * kStepFixed;
+	if (steps) {
+		stepped_ = true;
+	}
+	return signedSteps;
+}
+
+} // namespace amm
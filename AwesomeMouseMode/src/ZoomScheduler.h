@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Win32Shim.h"
+
+#include <cstdint>
+
+namespace amm {
+
+// How often queued zoom steps are handed to Live while a zoom gesture is under way.
+constexpr DWORD kZoomFrameMs = 16;
+
+// Turns Ctrl+wheel and pinch input into paced zoom steps (one Ctrl+Plus or Ctrl+Minus each).
+//
+// Input is accumulated in fixed-point wheel units, scaled by an acceleration curve over a smoothed
+// estimate of how fast it is arriving: slow, careful pinches are boosted so they reach a step
+// sooner, fast ones pass through at face value. The first step of a gesture goes out as soon as
+// half of it has arrived; after that, each frame hands Live about what arrived in a frame, never more
+// than the per-frame budget, so Live redraws at most that many times per frame however hard the user
+// pinches. Input the budget can't keep up with is dropped rather than left to play out after the
+// pinch has stopped, and reversing direction drops whatever was still queued the old way.
+class ZoomScheduler {
+public:
+	static constexpr int kFractionBits = 8;
+	static constexpr int32_t kOne = 1 << kFractionBits;
+	static constexpr int kDefaultStepsPerFrame = 2;
+	static constexpr int kMaxStepsPerFrame = 8;
+
+	void SetBudget(int stepsPerFrame);
+	int Budget() const { return stepsPerFrame_; }
+
+	// Adds zoom input, in wheel units (WHEEL_DELTA per step, positive zooms in), that arrived at
+	// time (ms). Returns the steps to send Live right away, or 0 to wait for the next frame.
+	int Add(int delta, DWORD time);
+
+	// Called every kZoomFrameMs while Active(). Returns the steps to send Live this frame.
+	int Tick(DWORD time);
+
+	// True from a gesture's first input until it has gone quiet and been flushed.
+	bool Active() const { return active_; }
+
+	// Steps dropped so far: by reversals, and because the budget couldn't keep up.
+	uint64_t ReversedSteps() const { return reversedSteps_; }
+	uint64_t OverflowSteps() const { return overflowSteps_; }
+
+private:
+	int Take(int maxSteps);
+
+	int stepsPerFrame_ = kDefaultStepsPerFrame;
+	int32_t accFixed_ = 0;
+	int32_t velocityFixed_ = 0;  // Wheel units per millisecond, smoothed.
+	DWORD lastInputTime_ = 0;
+	bool active_ = false;
+	bool stepped_ = false;       // This gesture has sent a step.
+	uint64_t reversedSteps_ = 0;
+	uint64_t overflowSteps_ = 0;
+};
+
+} // namespace amm
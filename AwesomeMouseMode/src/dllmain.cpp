@@ -1,432 +1,960 @@
 #include "stdafx.h"
 #include "vstsdk2.4/pluginterfaces/vst2.x/aeffectx.h"
+#include "CoordinateSpace.h"
+#include "GestureParameters.h"
+#include "ImportPatch.h"
+#include "InputRecording.h"
+#include "InputTranslator.h"
+#include "InputWorker.h"
+#include "LiveStats.h"
+#include "MoveCoalescer.h"
+#include "RepaintLatency.h"
+#include "Settings.h"
+#include "TraceRecorder.h"
+#include "WindowRegistry.h"
 
 namespace {
 
-// Constants affecting plugin behaviour.
-// Constants instead of defines so these can be turned into runtime options.
-constexpr bool kEnableDigitizerFix = true;
-constexpr bool kEnableTouchPanGesture = true;
-constexpr bool kEnableTrackpadZoom = true;
-constexpr bool kEnableMultiTouch = false; // Not working.
+// Everything one hooked window's input needs: its drag, pen, wheel and gesture state in the
+// platform-neutral translator (OurWndProc only gathers Windows state for it and carries out what it
+// decides), plus how fast its handler is. Detached Live windows, plugin editors and the main window
+// each get their own, so a pen on one screen and a trackpad on another never mix. Cache-line
+// aligned, so windows handled on different threads don't share lines.
+struct alignas(64) WindowState {
+	amm::InputTranslator translator;
+	amm::MoveCoalescer moveCoalescer;
+	amm::CoordinateSpace coordinates;  // Use through Coordinates(), which refreshes it.
+	HWND root = nullptr;               // The top-level window it sits in, which moves it too.
+	amm::RepaintTracker repaint;       // Inputs not yet repainted, with AMM_REPAINT_LATENCY.
+	uint32_t settingsGeneration = 0;   // Of the settings snapshot the translator is set up with.
+	bool inTrackpadScroll = false;
+};
 
-constexpr bool kEnableScrollingOverride = true;
-constexpr int kWheelXScaleNumerator = 2;
-constexpr int kWheelXScaleDenominator = 1;
-constexpr int kWheelYScaleNumerator = 4;
-constexpr int kWheelYScaleDenominator = 3;
-constexpr int kMinWheelDelta = 120; // Happens to be equal to WHEEL_DELTA, probably not by accident.
+// How many OurWndProc frames are running on each slot's state. A slot is only handed to a new
+// window once its count is back to zero, so a window unmapped and replaced while Live was handling
+// one of its messages can't have its state reset under the outer frame.
+struct alignas(64) SlotUse {
+	std::atomic<int> handlers{ 0 };
+};
 
-constexpr bool kEnableCtrlShiftZ = true;
-constexpr bool kEnablePlusKeyWithoutShift = true;
+// Holds a slot in use for the life of one OurWndProc frame.
+class SlotHandler {
+public:
+	explicit SlotHandler(std::atomic<int>* handlers) : handlers_(handlers) { handlers_->fetch_add(1, std::memory_order_seq_cst); }
+	~SlotHandler() { handlers_->fetch_sub(1, std::memory_order_release); }
+
+private:
+	std::atomic<int>* handlers_;
+};
 
-// Global state, global 'cause we're cool.
 struct WindowData {
 	HWND hwnd;
 	LONG_PTR oldWndProc;
+	int slot;
+	WindowState* state;
 };
 
 // Map of window state, 'cause we don't want to override GWLP_USERDATA, which Live likely already
-// uses.
+// uses. Lookups are lock-free; gStateLock only serializes MapWindow and UnmapWindow. Each window's
+// WindowState lives at its registry slot, so the lookup that finds the WndProc finds it too.
 std::recursive_mutex* gStateLock = nullptr;
-std::unordered_map<HWND, WindowData>* gWindowMap = nullptr;
-
-bool gDragDown = false;
-bool gDragPenDown = false;
-POINT gDragDownPoint = { 0, };
-POINT gDragPrevDigitizerPoint = { 0, };
-POINT gDragDigitizerDelta = { 0, };
-bool gHadDigitizerEvent = false;
-bool gWasDigitizerClick = false;
-bool gHadDigitizerClick = false;
-int gHadDoubleClick = 0;
-POINT gWheelDeltaAcc = { 0, };
-int gWheelZoomDeltaAcc = 0;
-bool gInPanGesture = false;
-bool gPanGestureDown = false;
-bool gPanGestureInInertia = false;
-POINT gPanGestureLastPos = { 0, };
-POINT gPanGestureBestRealPos = { 0, };
-bool gInTrackpadScroll = false;
+amm::WindowRegistry gWindowMap;
+WindowState gWindowStates[amm::WindowRegistry::kCapacity];
+SlotUse gSlotUse[amm::WindowRegistry::kCapacity];
+
+// Settings, published as immutable snapshots. ReloadSettings swaps in a new one when anything has
+// changed, under gStateLock, and each window applies the latest at the start of its own
+// OurWndProc, so a translator is only ever reconfigured by the thread that runs it. Replaced
+// snapshots are kept until the DLL unloads, since a window may still be applying one; there is one
+// per edit of the settings.
+struct SettingsSnapshot {
+	amm::Settings settings;
+	uint32_t generation;
+};
+std::atomic<const SettingsSnapshot*> gSettings{ nullptr };
+std::vector<const SettingsSnapshot*> gRetiredSettings;
+
+// Answers the translator's user32 queries lazily, at most once per message each, and counts them
+// so the per-message cost is visible.
+class Win32InputSource : public amm::InputSource {
+public:
+	virtual void Fetch(const amm::InputMessage& in, BYTE fields) const override;
+};
+Win32InputSource gInputSource;
+
+// Live statistics, published in a named file mapping (AMM_STATS_MAPPING_NAME) for StatsReader to
+// watch while Live runs. Until it is created, or if it can't be, the counters go to gLocalStats.
+amm::StatsBlock gLocalStats;
+amm::StatsBlock* gStats = &gLocalStats;
+HANDLE gStatsMapping = nullptr;
+thread_local amm::StatsThread* tThreadStats = nullptr;
+
+// Cursor visibility, tracked from EVENT_OBJECT_SHOW/HIDE on the cursor instead of polled: 1 shown,
+// 0 hidden, -1 until we've seen the first event (we poll GetCursorInfo until then).
+std::atomic<int> gCursorShown{ -1 };
+HWINEVENTHOOK gCursorHook = nullptr;
+
+// Window hooking. Live's existing windows are hooked at attach, and new ones as they are created,
+// as long as Live's executable registered their class. Classes are decided once each, by atom;
+// only MapLiveWindow touches the cache, under gStateLock.
+HWINEVENTHOOK gWindowHook = nullptr;
+HMODULE gLiveModule = nullptr;
+struct WindowClass {
+	ATOM atom;
+	bool live;
+};
+constexpr int kMaxWindowClasses = 32;
+WindowClass gWindowClasses[kMaxWindowClasses];
+int gWindowClassCount = 0;
+
+
+// Settings are re-read whenever Live is activated, so edits to the .ini apply without a restart.
+HMODULE gModule = nullptr;
+
+// Set AMM_RECORD_INPUT to a path to capture every message and decision for tools/ReplayRecording.
+amm::InputRecorder* gRecorder = nullptr;
+
+// Set AMM_REPAINT_LATENCY to a path to measure input-to-repaint latency for each kind of input. A
+// report is appended there, with the settings it was measured under, whenever they change and from
+// SaveMeasurements; gRepaintSettings is FormatSettings of those, and gRepaintSince when measuring
+// began.
+amm::RepaintHistograms* gRepaintLatency = nullptr;
+const char* gRepaintLatencyPath = nullptr;
+char gRepaintSettings[1024] = {};
+LONGLONG gRepaintSince = 0;
+
+// With [Input] AsyncSynthesis=1, SendInput and SetCursorPos run on this worker instead of inside
+// Live's window procedure. Started on first use, never from DllMain, and kept for the life of the
+// process. Its queue takes one producer, gInputThread: the first UI thread to queue input. Windows
+// on any other thread send theirs synchronously, once the worker has caught up.
+amm::InputWorker gInputWorker;
+std::atomic<bool> gInputWorkerReady{ false };
+std::atomic<DWORD> gInputThread{ 0 };
+std::atomic<bool> gAsyncSynthesis{ false };
+
+// With [Input] CoalesceMoves=1, stale mouse moves are skipped while Live's handler is slow.
+std::atomic<bool> gCoalesceMoves{ false };
+LONGLONG gPerformanceFrequency = 1;
+
+// Pointer history for the multi-touch recognizer, reused for every WM_POINTER message. Only the UI
+// thread touches these. Set AMM_RECORD_TOUCH to a path to capture the frames for tools/TouchReplay.
+POINTER_TOUCH_INFO gPointerHistory[amm::kMaxTouchHistory * amm::kMaxTouchContacts];
+amm::TouchFrame gTouchFrames[amm::kMaxTouchHistory];
+amm::TouchRecorder* gTouchRecorder = nullptr;
+
+// Gesture parameters for the plugin's automation, published from whichever UI thread first does so
+// (the bridge takes one producer) while a plugin instance is listening. gPenPressure is the latest
+// pen pointer's pressure; gPublishedParameters what was last sent, to skip repeats.
+std::atomic<DWORD> gParameterThread{ 0 };
+float gPenPressure = 0;
+float gPublishedParameters[amm::kGestureParameters] = {};
+
+// Per-monitor DPI, which Windows before 10 (1607) can't tell us; without it everything is 96 DPI.
+// Looked up on first use rather than at attach, since shcore may need loading.
+typedef UINT (WINAPI* GetDpiForWindowFn)(HWND hwnd);
+typedef HRESULT (WINAPI* GetDpiForMonitorFn)(HMONITOR monitor, int dpiType, UINT* dpiX, UINT* dpiY);
+typedef DPI_AWARENESS_CONTEXT (WINAPI* SetThreadDpiAwarenessContextFn)(DPI_AWARENESS_CONTEXT context);
+struct DpiFunctions {
+	GetDpiForWindowFn getDpiForWindow;
+	GetDpiForMonitorFn getDpiForMonitor;
+	SetThreadDpiAwarenessContextFn setThreadDpiAwarenessContext;
+};
+
+// Virtual pan. Live's own imports of these user32 functions are redirected to us once the feature
+// is first turned on, and pass straight through unless a virtual pan is under way.
+std::atomic<bool> gVirtualInput{ false };
+std::atomic<BYTE> gVirtualKeyState{ 0 };
+// Screen space, x in the low half and y in the high, so the patched GetCursorPos never reads one
+// coordinate from before a move and the other from after it.
+std::atomic<uint64_t> gVirtualCursor{ 0 };
+HMODULE gPatchedModule = nullptr;
+bool gImportsPatched = false;
+void* gRealGetKeyState = nullptr;
+void* gRealGetAsyncKeyState = nullptr;
+void* gRealGetCursorPos = nullptr;
+void* gRealSetCursorPos = nullptr;
 
 
 INPUT MakeKeyboardEvent(int vk, bool keyUp);
+void GatherInputMessage(const WindowData& data, UINT msg, WPARAM wParam, LPARAM lParam, amm::InputMessage* in);
+int GatherTouchFrames(const amm::CoordinateSpace& coordinates, UINT32 pointerId);
+const amm::CoordinateSpace& Coordinates(const WindowData& data);
+void RefreshCoordinates(HWND hwnd, amm::CoordinateSpace* coordinates);
+void InvalidateCoordinates(const WindowData& data, UINT msg);
+const DpiFunctions& Dpi();
+LRESULT EmitTranslatedInput(HWND hwnd, const WindowData& data, LPARAM lParam, const amm::TranslatedInput& out, LONGLONG* forwardTicks);
+void EmitKeys(amm::InputWorker* worker, const amm::SyntheticKey* keys, int count);
+amm::StatsThread* ThreadStats();
+void CreateStatsMapping();
+uint64_t TicksToNanos(LONGLONG ticks);
+void EmitCursorPos(amm::InputWorker* worker, POINT point);
+void PublishGestureParameters(const amm::InputTranslator& translator, DWORD time);
 LRESULT CALLBACK OurWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+bool NewerMovePending();
+void SetVirtualInput(POINT screenPoint, BYTE keyState);
+void ClearVirtualInput();
+bool PatchLiveImports();
+void RestoreLiveImports();
+SHORT WINAPI OurGetKeyState(int vk);
+SHORT WINAPI OurGetAsyncKeyState(int vk);
+BOOL WINAPI OurGetCursorPos(LPPOINT point);
+BOOL WINAPI OurSetCursorPos(int x, int y);
+bool IsRepaintInput(amm::StatsMessage kind, WPARAM wParam);
+void ExportRepaintLatency();
+void SaveMeasurements();
+void ReloadSettings();
+amm::InputWorker* StartedInputWorker();
+void CatchUpWithInputWorker();
+const amm::Settings& CurrentSettings();
+void RecordSettings(const amm::Settings& settings, amm::RecordedSettings* recorded);
+void ApplySettings(const SettingsSnapshot& snapshot, const WindowData& data);
+void FreeSettings();
+void ResetWindowState(WindowState* state);
 void MapWindow(HWND hwnd);
+void MapLiveWindow(HWND hwnd);
+bool IsLiveWindowClass(HWND hwnd);
+void MapExistingWindows();
+BOOL CALLBACK EnumLiveWindow(HWND hwnd, LPARAM lParam);
 void UnmapWindow(HWND hwnd);
 void UnmapAllWindows();
 void CALLBACK OurWinEventProc(HWINEVENTHOOK hWinEventHook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD dwEventThread, DWORD dwmsEventTime);
-
-
-// Good ol' Windows stuff.
-#define MI_WP_SIGNATURE 0xFF515700
-#define SIGNATURE_MASK 0xFFFFFF00
-#define IS_PEN_EVENT(dw) (((dw) & SIGNATURE_MASK) == MI_WP_SIGNATURE)
-
-#if defined(_DEBUG)
-static void DEBUG_TRACE(LPTSTR format ...) {
-	va_list varargs;
-	va_start(varargs, format);
-	TCHAR outstr[1024];
-	_vstprintf_s(outstr, format, varargs);
-	OutputDebugString(outstr);
-}
-#else
-#define DEBUG_TRACE(...)
-#endif
+void CALLBACK OurCursorEventProc(HWINEVENTHOOK hWinEventHook, DWORD event, HWND hwnd, LONG idObject, LONG idChild, DWORD dwEventThread, DWORD dwmsEventTime);
 
 
 // Handle events forwarded from windows we're hooked into. This lets us override what Live sees and
 // change behaviour.
 LRESULT CALLBACK OurWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
-	WindowData data;
-	{
-		std::lock_guard<std::recursive_mutex> lock(*gStateLock);
-		auto findIt = gWindowMap->find(hwnd);
-		if (findIt == gWindowMap->end()) {
-			return 0L;
-		}
-		data = findIt->second;
+	uintptr_t oldWndProc = 0;
+	int slot = gWindowMap.Find((uintptr_t) hwnd, &oldWndProc);
+	if (slot < 0) {
+		return 0L;
+	}
+	SlotHandler handler(&gSlotUse[slot].handlers);
+	if (gWindowMap.KeyAt(slot) != (uintptr_t) hwnd) {
+		// Unmapped, and the slot handed on, between the lookup and claiming it.
+		return ::CallWindowProc((WNDPROC) oldWndProc, hwnd, msg, wParam, lParam);
+	}
+	WindowData data = { hwnd, (LONG_PTR) oldWndProc, slot, &gWindowStates[slot] };
+	amm::StatsThread* stats = ThreadStats();
+	LARGE_INTEGER start;
+	::QueryPerformanceCounter(&start);
+	amm::StatsMessage kind = amm::ClassifyMessage(msg);
+	stats->messages[(int) kind].fetch_add(1, std::memory_order_relaxed);
+	bool repaintInput = gRepaintLatency && IsRepaintInput(kind, wParam);
+	if (repaintInput) {
+		data.state->repaint.Input(kind, TicksToNanos(start.QuadPart), gRepaintLatency);
 	}
 
-	WORD loword = LOWORD(wParam);
 	switch (msg) {
-	case WM_LBUTTONDOWN:
-		if (kEnableDigitizerFix) {
-			POINT mpos = { GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
-			bool isPenEvent = IS_PEN_EVENT(::GetMessageExtraInfo());
-			if (isPenEvent) {
-				DEBUG_TRACE(_T("BUTTONDOWN: [%d, %d]\n"), mpos.x, mpos.y);
-				gHadDigitizerClick = true;
-				gHadDigitizerEvent = true;
-				gDragPenDown = true;
-			} else {
-				gDragPenDown = false;
-			}
-			gDragDown = true;
-			gDragDownPoint = mpos;
-			gWasDigitizerClick = false;
-			gDragDigitizerDelta.x = 0;
-			gDragDigitizerDelta.y = 0;
+	case WM_ACTIVATEAPP:
+		if (wParam) {
+			ReloadSettings();
 		}
 		break;
-	case WM_LBUTTONUP:
-		gDragDown = false;
-		gDragPenDown = false;
-		break;
-	case WM_LBUTTONDBLCLK:
-		if (kEnableDigitizerFix) {
-			bool isPenEvent = IS_PEN_EVENT(::GetMessageExtraInfo());
-			if (isPenEvent) {
-				// _TODO_ Initial fix for jumping around when Windows thinks we double clicked (but still broken).
-				DEBUG_TRACE(_T("DBLCLK Reset: [%d, %d]\n"), gDragPrevDigitizerPoint.x, gDragPrevDigitizerPoint.y);
-				lParam = MAKELONG((short) gDragPrevDigitizerPoint.x, (short) gDragPrevDigitizerPoint.y);
-				gHadDoubleClick = 3;
-			}
+	case WM_ENDSESSION:
+		// Windows may end the process without another message.
+		if (wParam) {
+			SaveMeasurements();
 		}
 		break;
-	case WM_MOUSEMOVE:
-		if (kEnableTouchPanGesture) {
-			if (!gInPanGesture && gPanGestureDown) {
-				// Cancel pan because the mouse is moving.
-				gPanGestureDown = false;
-				DEBUG_TRACE(_T("MOUSEMOVE: Force Pan Gesture Up\n"));
-				::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_LBUTTONUP, 0, MAKELONG(gPanGestureLastPos.x, gPanGestureLastPos.y));
-				::SetCursorPos(gPanGestureBestRealPos.x, gPanGestureBestRealPos.y);
-				return 0L;
-			} else if (gPanGestureDown && !gPanGestureInInertia && !(gPanGestureLastPos.x == GET_X_LPARAM(lParam) && gPanGestureLastPos.y == GET_Y_LPARAM(lParam))) {
-				// The mouse moved while panning. Ignore it.
-				return 0L;
-			} else {
-				// We get one WM_MOUSEMOVE event just after the gesture begins. We need to treat it as a
-				// non-mouse event, and skip canceling the pan.
-				gInPanGesture = false;
-				if (!gPanGestureDown) {
-					POINT realScreenPoint;
-					::GetCursorPos(&realScreenPoint);
-					gPanGestureBestRealPos = realScreenPoint;
-				}
-			}
-		}
-		if (kEnableDigitizerFix) {
-			CURSORINFO cursorInfo;
-			::memset(&cursorInfo, 0, sizeof(cursorInfo));
-			cursorInfo.cbSize = sizeof(CURSORINFO);
-			::GetCursorInfo(&cursorInfo);
-			bool cursorShown = (cursorInfo.flags & CURSOR_SHOWING);
-			int mx = GET_X_LPARAM(lParam);
-			int my = GET_Y_LPARAM(lParam);
-			bool isPenEvent = IS_PEN_EVENT(::GetMessageExtraInfo());
-			bool isDoubleClick = gHadDoubleClick > 0;
-			if (isDoubleClick) {
-				gHadDoubleClick--;
-			}
-			DEBUG_TRACE(_T("MOUSEMOVE [%d, %d] Cursor: %s Pen: %s\n"), mx, my, cursorShown ? _T("true") : _T("false"), isPenEvent ? _T("true") : _T("false"));
-			if (!cursorShown) {
-				bool isCtrlOrShift = (wParam & MK_CONTROL) || (wParam & MK_SHIFT);
-				bool isErrantEvent = isPenEvent && gHadDigitizerEvent && mx == gDragDownPoint.x && my == gDragDownPoint.y;
-				if (isPenEvent && !isErrantEvent) {
-					bool wasAcknowledged = !gHadDigitizerEvent;
-					gHadDigitizerEvent = true;
-					gWasDigitizerClick = true;
-					if (isCtrlOrShift && !wasAcknowledged) {
-						lParam = MAKELONG((short) gDragDownPoint.x, (short) gDragDownPoint.y);
-						break;
-					}
-					int dx = mx - gDragPrevDigitizerPoint.x;
-					int dy = my - gDragPrevDigitizerPoint.y;
-					gDragPrevDigitizerPoint.x = mx;
-					gDragPrevDigitizerPoint.y = my;
-					gDragDigitizerDelta.x += dx;
-					gDragDigitizerDelta.y += dy;
-					int targetDX = gDragDigitizerDelta.x;
-					int targetDY = gDragDigitizerDelta.y;
-					if (!wasAcknowledged && ((std::abs(targetDX) < 3 && std::abs(targetDY) < 3) || (rand() % 100) > 70)) {
-						lParam = MAKELONG((short) gDragDownPoint.x, (short) gDragDownPoint.y);
-						break;
-					}
-					//if (wParam & MK_CONTROL) {
-					//	targetDX = 0;
-					//	targetDY = 0;
-					//}
-					int targetX = gDragDownPoint.x + targetDX;
-					int targetY = gDragDownPoint.y + targetDY;
-					// Tell Live the mouse moved a small distance from where the button was originally pressed.
-					DEBUG_TRACE(_T("[%d, %d] -> [%d, %d]\n"), gDragDownPoint.x, gDragDownPoint.y, targetDX, targetDY);
-					lParam = MAKELONG((short) targetX, (short) targetY);
-					gDragDigitizerDelta.x = 0;
-					gDragDigitizerDelta.y = 0;
-				} else {
-					if (gHadDigitizerEvent || gDragPenDown) {
-						DEBUG_TRACE(_T("Reset: [%d, %d] Errant: %s\n"), gDragDownPoint.x, gDragDownPoint.y, isErrantEvent ? _T("true") : _T("false"));
-						if (gHadDigitizerClick) {
-							// Record the location Live thinks the mouse button was pressed.
-							gHadDigitizerClick = false;
-							gDragDownPoint.x = mx;
-							gDragDownPoint.y = my;
-						}
-						// Live has acknowledged the mouse move, and forced the cursor back to where
-						// it thinks the button went down. That means we can reset our running
-						// delta.
-						if (isCtrlOrShift) {
-							gDragDigitizerDelta.x = 0;
-							gDragDigitizerDelta.y = 0;
-						//	gDragDownPoint.x = mx;
-						//	gDragDownPoint.y = my;
-							lParam = MAKELONG((short) gDragDownPoint.x, (short) gDragDownPoint.y);
-						}
-						gHadDigitizerEvent = false;
-					//	lParam = MAKELONG((short) gDragDownPoint.x, (short) gDragDownPoint.y);
-					} else {
-						//gDragDownPoint.x = mx;
-						//gDragDownPoint.y = my;
-						//if (isCtrlOrShift) {
-						//	gDragDigitizerDelta.x = 0;
-						//	gDragDigitizerDelta.y = 0;
-						//	//gDragDownPoint.x = mx;
-						//	//gDragDownPoint.y = my;
-						//	lParam = MAKELONG((short) gDragDownPoint.x, (short) gDragDownPoint.y);
-						//}
-					}
-				}
-			} else {
-				if (isPenEvent) {
-					if (!isDoubleClick) {
-						gDragPrevDigitizerPoint.x = mx;
-						gDragPrevDigitizerPoint.y = my;
-					}
-				}
-			}
-		}
-		break;
-	case WM_KEYDOWN:
-		if (kEnableCtrlShiftZ && wParam == 'Z' && HIBYTE(::GetKeyState(VK_CONTROL)) && HIBYTE(::GetKeyState(VK_SHIFT))) {
-			INPUT input[] = {
-				MakeKeyboardEvent(VK_SHIFT, true),
-				MakeKeyboardEvent('Y', false),
-				MakeKeyboardEvent('Y', true),
-				MakeKeyboardEvent(VK_SHIFT, false),
-			};
-			::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
-		}
+	case WM_WINDOWPOSCHANGED:
+	case WM_MOVE:
+	case WM_SIZE:
+	case WM_DPICHANGED:
+	case WM_DPICHANGED_AFTERPARENT:
+	case WM_DISPLAYCHANGE:
+		InvalidateCoordinates(data, msg);
 		break;
+	}
+	const SettingsSnapshot* settings = gSettings.load(std::memory_order_acquire);
+	if (settings && settings->generation != data.state->settingsGeneration) {
+		ApplySettings(*settings, data);
+	}
 
-	case WM_CHAR:
-	// The following conflicts with text editing, so turn it off if you like typing equals.
-		if (kEnablePlusKeyWithoutShift && wParam == '=') {
-			// Allow zooming without needing to hold shift.
-			wParam = '+';
-		}
-		break;
+	amm::InputMessage in;
+	GatherInputMessage(data, msg, wParam, lParam, &in);
+	amm::TranslatedInput out;
+	amm::InputTranslator& translator = data.state->translator;
+	amm::EmissionStats before = translator.Stats();
+	translator.Translate(in, &out);
+	if (uint64_t coalesced = translator.Stats().coalescedEvents - before.coalescedEvents) {
+		stats->keysCoalesced.fetch_add(coalesced, std::memory_order_relaxed);
+	}
+	if (uint64_t gestures = translator.Stats().touchGestures - before.touchGestures) {
+		stats->touchGestures.fetch_add(gestures, std::memory_order_relaxed);
+	}
+	// The extra info only if the translator fetched it: fetching it for the trace would cost a user32
+	// call on every message.
+	DWORD extraInfo = (in.present & amm::kInputExtraInfo) ? in.extraInfo : 0;
+	amm::Trace(amm::TraceEvent::kMessage, (int32_t) msg, (int32_t) wParam, (int32_t) lParam, (int32_t) extraInfo);
+	if (gRecorder) {
+		gRecorder->Append(in, out, slot);
+	}
+	if (amm::gGestureParameters.Listening()) {
+		PublishGestureParameters(translator, in.time);
+	}
+	LONGLONG forwardTicks = 0;
+	LRESULT result = EmitTranslatedInput(hwnd, data, lParam, out, &forwardTicks);
+
+	// Our own time is everything but Live's handler. A nested OurWndProc, for a message Live sent
+	// while handling ours, counts towards Live's.
+	LARGE_INTEGER end;
+	::QueryPerformanceCounter(&end);
+	uint64_t hookNanos = TicksToNanos(end.QuadPart - start.QuadPart - forwardTicks);
+	stats->hookNanos.fetch_add(hookNanos, std::memory_order_relaxed);
+	stats->hookLatency.Record(hookNanos);
+	if (repaintInput) {
+		data.state->repaint.Handled(TicksToNanos(start.QuadPart), TicksToNanos(forwardTicks));
+	} else if (gRepaintLatency && msg == WM_PAINT) {
+		data.state->repaint.Painted(TicksToNanos(end.QuadPart), gRepaintLatency);
+	}
+	return result;
+}
 
-	case WM_GESTURENOTIFY:
-		if (kEnableTouchPanGesture) {
-			GESTURECONFIG gc;
-			::memset(&gc, 0, sizeof(gc));
-			gc.dwID = GID_PAN;
-			gc.dwWant = GC_PAN | GC_PAN_WITH_INERTIA | GC_PAN_WITH_SINGLE_FINGER_HORIZONTALLY | GC_PAN_WITH_SINGLE_FINGER_VERTICALLY;
-			gc.dwBlock = 0;
-			::SetGestureConfig(hwnd, 0, 1, &gc, sizeof(GESTURECONFIG));
+// Whether a message counts as input for the repaint measurement: anything from the user, and our
+// own timers, which pace scrolling, zooming and inertia. Live's timers aren't input.
+bool IsRepaintInput(amm::StatsMessage kind, WPARAM wParam) {
+	switch (kind) {
+	case amm::StatsMessage::kTimer:
+		return wParam == amm::kZoomFrameTimerId || wParam == amm::kScrollFrameTimerId || wParam == amm::kPanInertiaTimerId;
+	case amm::StatsMessage::kOther:
+		return false;
+	default:
+		return true;
+	}
+}
+
+// Append what has been measured since gRepaintSince to the AMM_REPAINT_LATENCY report, and start
+// afresh.
+void ExportRepaintLatency() {
+	LARGE_INTEGER now;
+	::QueryPerformanceCounter(&now);
+	double seconds = (double) (now.QuadPart - gRepaintSince) / gPerformanceFrequency;
+	gRepaintSince = now.QuadPart;
+	FILE* out = gRepaintLatency->TotalCount() > 0 ? ::fopen(gRepaintLatencyPath, "a") : nullptr;
+	if (out) {
+		std::fprintf(out, "# Input-to-repaint latency over %.0f s: from an input reaching the hook to the end of its\n"
+			"# window's next WM_PAINT. Measured with:\n\n%s\n", seconds, gRepaintSettings);
+		gRepaintLatency->Write(out);
+		std::fprintf(out, "\n");
+		::fclose(out);
+	}
+	gRepaintLatency->Reset();
+}
+
+// Write out what has been measured while it is still safe to: when Live's last window goes, or the
+// session ends. By the time the process detaches us, other threads may have died holding the CRT's
+// locks, so nothing is written then.
+void SaveMeasurements() {
+	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
+	if (gRepaintLatency) {
+		ExportRepaintLatency();
+	}
+	// Point AMM_TRACE_DUMP at a file to keep the trace ring for tools/TraceDecode.
+	if (const char* tracePath = ::getenv("AMM_TRACE_DUMP")) {
+		amm::WriteTraceDump(tracePath);
+	}
+}
+
+// Hand the plugin whatever gesture parameters have changed since last time.
+void PublishGestureParameters(const amm::InputTranslator& translator, DWORD time) {
+	DWORD threadId = ::GetCurrentThreadId();
+	DWORD producer = 0;
+	if (!gParameterThread.compare_exchange_strong(producer, threadId) && producer != threadId) {
+		return;
+	}
+	amm::GestureSignals signals = translator.Signals(time);
+	float values[amm::kGestureParameters];
+	values[(int) amm::GestureParameter::kPanSpeed] = signals.panSpeed;
+	values[(int) amm::GestureParameter::kPinchScale] = signals.pinchScale;
+	values[(int) amm::GestureParameter::kPenPressure] = gPenPressure;
+	values[(int) amm::GestureParameter::kScrollRate] = signals.scrollRate;
+	uint64_t nanos = amm::GestureClockNanos();
+	for (int i = 0; i < amm::kGestureParameters; ++i) {
+		amm::GestureParameter parameter = (amm::GestureParameter) i;
+		float normalized = amm::NormalizeGestureParameter(parameter, values[i]);
+		// About what a host's automation lane can show, so slow drifts don't flood the ring. Coming
+		// to rest always goes out.
+		float change = normalized - gPublishedParameters[i];
+		if (change < 1.0f / 512 && change > -1.0f / 512 && (normalized != 0 || gPublishedParameters[i] == 0)) {
+			continue;
 		}
-		break;
+		if (amm::gGestureParameters.Publish(parameter, normalized, nanos)) {
+			gPublishedParameters[i] = normalized;
+		}
+	}
+}
+
+// This thread's live statistics.
+amm::StatsThread* ThreadStats() {
+	if (!tThreadStats) {
+		tThreadStats = gStats->ForThread(::GetCurrentThreadId());
+	}
+	return tThreadStats;
+}
 
+// Publish the statistics block under this process's mapping name. Called once at attach, before any
+// thread has picked its counters.
+void CreateStatsMapping() {
+	wchar_t name[64];
+	swprintf_s(name, AMM_STATS_MAPPING_NAME, ::GetCurrentProcessId());
+	gStatsMapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD) sizeof(amm::StatsBlock), name);
+	if (!gStatsMapping) {
+		return;
+	}
+	void* view = ::MapViewOfFile(gStatsMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(amm::StatsBlock));
+	if (!view) {
+		::CloseHandle(gStatsMapping);
+		gStatsMapping = nullptr;
+		return;
+	}
+	gStats = amm::InitStatsBlock(view, ::GetCurrentProcessId(), (uint64_t) gPerformanceFrequency);
+}
+
+uint64_t TicksToNanos(LONGLONG ticks) {
+	return ticks > 0 ? (uint64_t) (ticks * 1000000000.0 / gPerformanceFrequency) : 0;
+}
+
+// Fill in the cheap parts of the message. Everything else is fetched by gInputSource only if the
+// translator asks for it.
+void GatherInputMessage(const WindowData& data, UINT msg, WPARAM wParam, LPARAM lParam, amm::InputMessage* in) {
+	::memset(in, 0, sizeof(*in));
+	in->msg = msg;
+	in->wParam = wParam;
+	in->lParam = lParam;
+	in->time = (DWORD) ::GetMessageTime();
+	in->inTrackpadScroll = data.state->inTrackpadScroll;
+	in->source = &gInputSource;
+
+	switch (msg) {
 	case WM_GESTURE:
-		if (kEnableTouchPanGesture) {
+		{
 			GESTUREINFO gesture;
 			::memset(&gesture, 0, sizeof(gesture));
 			gesture.cbSize = sizeof(gesture);
-			bool consumed = false;
 			if (::GetGestureInfo((HGESTUREINFO) lParam, &gesture)) {
-				if (gesture.dwID == GID_PAN) {
-					// Fake a smooth pan by Ctrl+Alt clicking and dragging.
-					DEBUG_TRACE(_T("GID_PAN: %d %ld, [%d, %d]\n"), gesture.dwFlags, gesture.ullArguments, gesture.ptsLocation.x, gesture.ptsLocation.y);
-					bool restartedGesture = gPanGestureInInertia && gesture.dwFlags == 0;
-					if (restartedGesture || (gesture.dwFlags & GF_BEGIN)) {
-						// Cancel our current Ctrl+Alt click if it was already down.
-						if (gPanGestureDown) {
-							::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_LBUTTONUP, 0, MAKELONG(gPanGestureLastPos.x, gPanGestureLastPos.y));
-						}
-						// Simulate a Ctrl+Alt click.
-						gInPanGesture = true;
-						gPanGestureDown = true;
-						gPanGestureInInertia = false;
-						{
-							INPUT input[] = {
-								MakeKeyboardEvent(VK_CONTROL, false),
-								MakeKeyboardEvent(VK_MENU, false),
-							};
-							::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
-						}
-						POINT screenTouchPoint = { gesture.ptsLocation.x, gesture.ptsLocation.y };
-						::ClientToScreen(hwnd, &screenTouchPoint);
-						::SetCursorPos(screenTouchPoint.x, screenTouchPoint.y);
-						::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_MOUSEMOVE, 0, MAKELONG(gesture.ptsLocation.x, gesture.ptsLocation.y));
-						::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_LBUTTONDOWN, 0, MAKELONG(gesture.ptsLocation.x, gesture.ptsLocation.y));
-						{
-							INPUT input[] = {
-								MakeKeyboardEvent(VK_CONTROL, true),
-								MakeKeyboardEvent(VK_MENU, true),
-							};
-							::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
-						}
-						gPanGestureLastPos.x = gesture.ptsLocation.x;
-						gPanGestureLastPos.y = gesture.ptsLocation.y;
-					}
-					if (gesture.dwFlags & GF_INERTIA) {
-						gPanGestureInInertia = true;
-						gInPanGesture = false;
-					}
-					if (gesture.dwFlags & GF_END) {
-						// Cancel our current Ctrl+Alt click because the gesture is completely over.
-						gPanGestureInInertia = false;
-						if (gPanGestureDown) {
-							gPanGestureDown = false;
-							::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_LBUTTONUP, 0, MAKELONG(gesture.ptsLocation.x, gesture.ptsLocation.y));
-							::SetCursorPos(gPanGestureBestRealPos.x, gPanGestureBestRealPos.y);
-						}
-					}
-
-					if (!(gesture.dwFlags & GF_BEGIN) && gPanGestureDown) {
-						::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, WM_MOUSEMOVE, 0, MAKELONG(gesture.ptsLocation.x, gesture.ptsLocation.y));
-						gPanGestureLastPos.x = gesture.ptsLocation.x;
-						gPanGestureLastPos.y = gesture.ptsLocation.y;
-					}
-					consumed = true;
+				in->hasGesture = true;
+				in->gestureId = gesture.dwID;
+				in->gestureFlags = gesture.dwFlags;
+				// Windows reports gestures in the monitor's physical pixels, from the screen's origin;
+				// the translator works in the window's client space.
+				POINT location = { gesture.ptsLocation.x, gesture.ptsLocation.y };
+				in->gestureLocation = Coordinates(data).PhysicalToClient(location);
+				in->gestureArguments = gesture.ullArguments;
+				if (gesture.dwID == GID_PAN && (gesture.dwFlags & GF_BEGIN)) {
+					ThreadStats()->panGestures.fetch_add(1, std::memory_order_relaxed);
 				}
 			}
-			if (consumed) {
-				::CloseGestureInfoHandle((HGESTUREINFO) lParam);
-				return 0L;
+		}
+		break;
+	case WM_POINTERDOWN:
+	case WM_POINTERUPDATE:
+	case WM_POINTERUP:
+		bool multiTouch = (data.state->translator.Features() & amm::kFeatureMultiTouch) != 0;
+		if (multiTouch || amm::gGestureParameters.Listening()) {
+			POINTER_INPUT_TYPE type = 0;
+			UINT32 pointerId = GET_POINTERID_WPARAM(wParam);
+			if (!::GetPointerType(pointerId, &type)) {
+				break;
+			}
+			if (multiTouch && type == PT_TOUCH) {
+				in->touchFrameCount = GatherTouchFrames(Coordinates(data), pointerId);
+				in->touchFrames = gTouchFrames;
+			} else if (type == PT_PEN) {
+				POINTER_PEN_INFO penInfo;
+				if (msg == WM_POINTERUP) {
+					gPenPressure = 0;
+				} else if (::GetPointerPenInfo(pointerId, &penInfo) && (penInfo.penMask & PEN_MASK_PRESSURE)) {
+					gPenPressure = penInfo.pressure / 1024.0f;
+				}
 			}
 		}
 		break;
+	}
+}
+
+// Collect every frame since the last pointer message, including ones Windows coalesced, oldest
+// first, then skip the rest of this frame's messages since we've seen all its contacts. Returns the
+// number of frames in gTouchFrames.
+int GatherTouchFrames(const amm::CoordinateSpace& coordinates, UINT32 pointerId) {
+	UINT32 entries = amm::kMaxTouchHistory;
+	UINT32 pointers = amm::kMaxTouchContacts;
+	if (!::GetPointerFrameTouchInfoHistory(pointerId, &entries, &pointers, gPointerHistory)) {
+		// More history than we have room for; the latest frame will have to do.
+		entries = 1;
+		pointers = amm::kMaxTouchContacts;
+		if (!::GetPointerFrameTouchInfo(pointerId, &pointers, gPointerHistory)) {
+			return 0;
+		}
+	}
+	int frameCount = 0;
+	for (int entry = (int) entries - 1; entry >= 0; --entry) {
+		amm::TouchFrame& frame = gTouchFrames[frameCount++];
+		const POINTER_TOUCH_INFO* row = &gPointerHistory[entry * pointers];
+		frame.time = row[0].pointerInfo.dwTime;
+		frame.count = pointers;
+		for (UINT32 p = 0; p < pointers; ++p) {
+			const POINTER_INFO& info = row[p].pointerInfo;
+			amm::TouchContact& contact = frame.contacts[p];
+			POINT point = coordinates.ScreenToClient(info.ptPixelLocation);
+			contact.id = info.pointerId;
+			contact.x = point.x;
+			contact.y = point.y;
+			contact.flags = ((info.pointerFlags & POINTER_FLAG_DOWN) ? amm::kTouchDown : 0) |
+				((info.pointerFlags & (POINTER_FLAG_UP | POINTER_FLAG_CANCELED)) ? amm::kTouchUp : 0);
+		}
+	}
+	::SkipPointerFrameMessages(pointerId);
+	if (gTouchRecorder) {
+		gTouchRecorder->Append(gTouchFrames, frameCount);
+	}
+	return frameCount;
+}
+
+// The window's coordinate space, refreshed from user32 if it has moved since it was last used. The
+// only system calls coordinate conversions make are here, once per move.
+const amm::CoordinateSpace& Coordinates(const WindowData& data) {
+	amm::CoordinateSpace& coordinates = data.state->coordinates;
+	if (!coordinates.Valid()) {
+		RefreshCoordinates(data.hwnd, &coordinates);
+	}
+	return coordinates;
+}
+
+void RefreshCoordinates(HWND hwnd, amm::CoordinateSpace* coordinates) {
+	uint32_t generation = coordinates->Generation();
+	amm::WindowGeometry geometry;
+	::memset(&geometry, 0, sizeof(geometry));
+	::ClientToScreen(hwnd, &geometry.clientOrigin);
+	geometry.mirrored = (::GetWindowLongPtr(hwnd, GWL_EXSTYLE) & WS_EX_LAYOUTRTL) != 0;
+	HMONITOR monitor = ::MonitorFromWindow(hwnd, MONITOR_DEFAULTTONEAREST);
+	MONITORINFO monitorInfo;
+	::memset(&monitorInfo, 0, sizeof(monitorInfo));
+	monitorInfo.cbSize = sizeof(monitorInfo);
+	if (::GetMonitorInfo(monitor, &monitorInfo)) {
+		geometry.monitor = monitorInfo.rcMonitor;
+	}
+	const DpiFunctions& dpi = Dpi();
+	if (dpi.getDpiForWindow) {
+		geometry.dpi = (int) dpi.getDpiForWindow(hwnd);
+	}
+	if (dpi.getDpiForMonitor && dpi.setThreadDpiAwarenessContext) {
+		// Asked from a window Windows scales, the monitor would claim the window's DPI too.
+		DPI_AWARENESS_CONTEXT previous = dpi.setThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE);
+		UINT dpiX = 0;
+		UINT dpiY = 0;
+		if (SUCCEEDED(dpi.getDpiForMonitor(monitor, 0 /* MDT_EFFECTIVE_DPI */, &dpiX, &dpiY))) {
+			geometry.monitorDpi = (int) dpiX;
+		}
+		if (previous) {
+			dpi.setThreadDpiAwarenessContext(previous);
+		}
+	}
+	coordinates->Update(geometry, generation);
+	ThreadStats()->queries.fetch_add(4, std::memory_order_relaxed);
+	amm::Trace(amm::TraceEvent::kCoordinatesRefreshed, geometry.clientOrigin.x, geometry.clientOrigin.y,
+		coordinates->Geometry().dpi, coordinates->Geometry().monitorDpi);
+}
+
+// A window moving, resizing or changing DPI moves every window inside it as well, and those don't
+// hear about it, so everything under the same top-level window is invalidated. Monitor changes
+// affect everything.
+void InvalidateCoordinates(const WindowData& data, UINT msg) {
+	for (WindowState& state : gWindowStates) {
+		if (msg == WM_DISPLAYCHANGE || &state == data.state || (state.root && state.root == data.state->root)) {
+			state.coordinates.Invalidate();
+		}
+	}
+}
+
+const DpiFunctions& Dpi() {
+	static const DpiFunctions functions = [] {
+		DpiFunctions found = {};
+		if (HMODULE user32 = ::GetModuleHandleW(L"user32.dll")) {
+			found.getDpiForWindow = (GetDpiForWindowFn) ::GetProcAddress(user32, "GetDpiForWindow");
+			found.setThreadDpiAwarenessContext = (SetThreadDpiAwarenessContextFn) ::GetProcAddress(user32, "SetThreadDpiAwarenessContext");
+		}
+		if (HMODULE shcore = ::LoadLibraryW(L"shcore.dll")) {
+			found.getDpiForMonitor = (GetDpiForMonitorFn) ::GetProcAddress(shcore, "GetDpiForMonitor");
+		}
+		return found;
+	}();
+	return functions;
+}
+
+void Win32InputSource::Fetch(const amm::InputMessage& in, BYTE fields) const {
+	if (fields & amm::kInputExtraInfo) {
+		in.extraInfo = (DWORD) ::GetMessageExtraInfo();
+		ThreadStats()->queries.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (fields & amm::kInputCursorShown) {
+		int shown = gCursorShown.load(std::memory_order_relaxed);
+		if (shown < 0) {
+			CURSORINFO cursorInfo;
+			::memset(&cursorInfo, 0, sizeof(cursorInfo));
+			cursorInfo.cbSize = sizeof(CURSORINFO);
+			::GetCursorInfo(&cursorInfo);
+			ThreadStats()->queries.fetch_add(1, std::memory_order_relaxed);
+			shown = (cursorInfo.flags & CURSOR_SHOWING) ? 1 : 0;
+		}
+		in.cursorShown = shown != 0;
+	}
+	if (fields & amm::kInputKeyState) {
+		in.keyState = 0;
+		if (HIBYTE(::GetKeyState(VK_CONTROL))) {
+			in.keyState |= amm::kKeyStateControl;
+		}
+		if (HIBYTE(::GetKeyState(VK_SHIFT))) {
+			in.keyState |= amm::kKeyStateShift;
+		}
+		if (HIBYTE(::GetKeyState(VK_MENU))) {
+			in.keyState |= amm::kKeyStateAlt;
+		}
+		ThreadStats()->queries.fetch_add(3, std::memory_order_relaxed);
+	}
+	if (fields & amm::kInputCursorPos) {
+		::GetCursorPos(&in.cursorPos);
+		ThreadStats()->queries.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (fields & amm::kInputTextEntry) {
+		// Live's text fields (renaming, the browser search, BPM entry) are the only places it shows a
+		// caret, so owning one is as good as being in a text field.
+		GUITHREADINFO threadInfo;
+		::memset(&threadInfo, 0, sizeof(threadInfo));
+		threadInfo.cbSize = sizeof(GUITHREADINFO);
+		in.textEntry = ::GetGUIThreadInfo(::GetCurrentThreadId(), &threadInfo) && threadInfo.hwndCaret != nullptr;
+		ThreadStats()->queries.fetch_add(1, std::memory_order_relaxed);
+	}
+	in.present |= fields;
+}
 
-	case WM_MOUSEWHEEL:
-		if (kEnableTrackpadZoom && !gInTrackpadScroll && (loword == MK_CONTROL)) {
-			// Either we got sent a touchpad zoom emulation event, or the user is scrolling while holding
-			// control. We can't tell the difference, so just assume it's a zoom event.
-			int delta = GET_WHEEL_DELTA_WPARAM(wParam);
-			int deltaAcc = gWheelZoomDeltaAcc + delta;
-			int outDelta = deltaAcc / WHEEL_DELTA;
-			deltaAcc -= outDelta * WHEEL_DELTA;
-			gWheelZoomDeltaAcc = deltaAcc;
-			if (outDelta != 0) {
-				int deltas = std::abs(outDelta);
-				DWORD zoomVKey = outDelta > 0 ? VK_OEM_PLUS : VK_OEM_MINUS;
-				{ 
-					INPUT input[] = {
-						MakeKeyboardEvent(VK_CONTROL, true),
-					};
-					::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
+// Carry out the translator's decisions, in order, and return what OurWndProc should return. With
+// the input worker on, synthetic input is queued instead, and every forward waits until nothing is
+// left queued, so Live sees the same state it would have synchronously.
+LRESULT EmitTranslatedInput(HWND hwnd, const WindowData& data, LPARAM lParam, const amm::TranslatedInput& out, LONGLONG* forwardTicks) {
+	amm::InputWorker* worker = gAsyncSynthesis.load(std::memory_order_relaxed) ? StartedInputWorker() : nullptr;
+	WindowState* state = data.state;
+	amm::StatsThread* stats = ThreadStats();
+	LRESULT result = 0L;
+	for (int i = 0; i < out.actionCount; ++i) {
+		const amm::OutputAction& action = out.actions[i];
+		switch (action.type) {
+		case amm::ActionType::kForward:
+			{
+				// Whatever is still queued, even from an earlier message: Live mustn't handle a real
+				// click before the key ups that ended a pan have gone out.
+				CatchUpWithInputWorker();
+				bool timed = action.coalescable && gCoalesceMoves.load(std::memory_order_relaxed);
+				if (timed && NewerMovePending() && state->moveCoalescer.ShouldDrop()) {
+					// Leave the result at 0, as if Live had handled it.
+					amm::Trace(amm::TraceEvent::kMoveCoalesced, GET_X_LPARAM(action.lParam), GET_Y_LPARAM(action.lParam),
+						(int32_t) (state->moveCoalescer.CostNanos() / 1000), (int32_t) state->moveCoalescer.Dropped());
+					stats->movesDropped.fetch_add(1, std::memory_order_relaxed);
+					break;
 				}
-				for (int i = 0 ; i < deltas; i++) {
-					INPUT input[] = {
-						MakeKeyboardEvent(zoomVKey, false),
-						MakeKeyboardEvent(zoomVKey, true),
-					};
-					::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
+				LARGE_INTEGER start;
+				::QueryPerformanceCounter(&start);
+				bool wasInTrackpadScroll = state->inTrackpadScroll;
+				if (action.trackpadScroll) {
+					state->inTrackpadScroll = true;
 				}
-				{
-					INPUT input[] = {
-						MakeKeyboardEvent(VK_CONTROL, false),
-					};
-					::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
+				LRESULT ret = ::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, action.msg, action.wParam, action.lParam);
+				state->inTrackpadScroll = wasInTrackpadScroll;
+				LARGE_INTEGER end;
+				::QueryPerformanceCounter(&end);
+				*forwardTicks += end.QuadPart - start.QuadPart;
+				uint64_t nanos = TicksToNanos(end.QuadPart - start.QuadPart);
+				stats->forwardNanos.fetch_add(nanos, std::memory_order_relaxed);
+				stats->forwardLatency.Record(nanos);
+				if (timed) {
+					state->moveCoalescer.RecordCost(nanos);
+				}
+				if (action.isResult) {
+					result = ret;
 				}
 			}
-
-			return 0L;
-		} if (kEnableScrollingOverride) {
-			int delta = GET_WHEEL_DELTA_WPARAM(wParam);
-			int outDelta = 0;
-			int deltaAcc = gWheelDeltaAcc.y;
-			deltaAcc += (delta * kWheelYScaleNumerator) / kWheelYScaleDenominator;
-			outDelta = (deltaAcc / kMinWheelDelta) * kMinWheelDelta;
-			gWheelDeltaAcc.y = deltaAcc - outDelta;
-
-			if (outDelta == 0) {
-				return 0L;
-			}
-			msg = WM_MOUSEWHEEL;
-			wParam = MAKEWPARAM(loword, (short) outDelta);
-		}
-		break;
-	case WM_MOUSEHWHEEL:
-		if (kEnableScrollingOverride) {
-			WORD loword = LOWORD(wParam);
-			int delta = GET_WHEEL_DELTA_WPARAM(wParam);
-			int outDelta = 0;
-			int deltaAcc = gWheelDeltaAcc.x;
-			deltaAcc += (delta * -kWheelXScaleNumerator) / kWheelXScaleDenominator;
-			outDelta = (deltaAcc / kMinWheelDelta) * kMinWheelDelta;
-			gWheelDeltaAcc.x = deltaAcc - outDelta;
-
-			if (outDelta == 0) {
-				return 0L;
-			}
-			msg = WM_MOUSEWHEEL;
-			wParam = MAKEWPARAM(MK_CONTROL, (short) outDelta);
+			break;
+		case amm::ActionType::kSendInput:
+			EmitKeys(worker, &out.keys[action.keyBegin], action.keyCount);
+			break;
+		case amm::ActionType::kSetCursorPos:
+			EmitCursorPos(worker, action.point);
+			break;
+		case amm::ActionType::kSetCursorPosClient:
 			{
-				INPUT input[] = {
-					MakeKeyboardEvent(VK_CONTROL, false),
-				};
-				::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
+				const amm::CoordinateSpace& coordinates = Coordinates(data);
+				EmitCursorPos(worker, coordinates.ClampToMonitor(coordinates.ClientToScreen(action.point)));
 			}
-			gInTrackpadScroll = true;
-			LRESULT ret = ::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, msg, wParam, lParam);
-			gInTrackpadScroll = false;
+			break;
+		case amm::ActionType::kConfigurePanGesture:
 			{
-				INPUT input[] = {
-					MakeKeyboardEvent(VK_CONTROL, true),
-				};
-				::SendInput(sizeof(input) / sizeof(INPUT), input, sizeof(INPUT));
+				GESTURECONFIG gc;
+				::memset(&gc, 0, sizeof(gc));
+				gc.dwID = GID_PAN;
+				gc.dwWant = GC_PAN | GC_PAN_WITH_INERTIA | GC_PAN_WITH_SINGLE_FINGER_HORIZONTALLY | GC_PAN_WITH_SINGLE_FINGER_VERTICALLY;
+				gc.dwBlock = 0;
+				::SetGestureConfig(hwnd, 0, 1, &gc, sizeof(GESTURECONFIG));
 			}
-			return ret;
+			break;
+		case amm::ActionType::kCloseGestureInfo:
+			::CloseGestureInfoHandle((HGESTUREINFO) lParam);
+			break;
+		case amm::ActionType::kSetTimer:
+			::SetTimer(hwnd, (UINT_PTR) action.wParam, (UINT) action.lParam, nullptr);
+			break;
+		case amm::ActionType::kKillTimer:
+			::KillTimer(hwnd, (UINT_PTR) action.wParam);
+			break;
+		case amm::ActionType::kSetVirtualInput:
+			SetVirtualInput(Coordinates(data).ClientToScreen(action.point), (BYTE) action.wParam);
+			break;
+		case amm::ActionType::kClearVirtualInput:
+			ClearVirtualInput();
+			break;
+		}
+	}
+	return result;
+}
+
+// Send keys, through the worker if this thread has it. If its queue is full, or another thread
+// has it, catch up with it and send them here, which keeps everything in order.
+void EmitKeys(amm::InputWorker* worker, const amm::SyntheticKey* keys, int count) {
+	if (worker) {
+		if (worker->EnqueueKeys(keys, count)) {
+			return;
+		}
+	}
+	CatchUpWithInputWorker();
+	INPUT input[amm::TranslatedInput::kMaxKeys];
+	for (int k = 0; k < count; ++k) {
+		input[k] = MakeKeyboardEvent(keys[k].vk, keys[k].keyUp);
+	}
+	::SendInput(count, input, sizeof(INPUT));
+	amm::StatsThread* stats = ThreadStats();
+	stats->sendInputCalls.fetch_add(1, std::memory_order_relaxed);
+	stats->sendInputEvents.fetch_add(count, std::memory_order_relaxed);
+}
+
+void EmitCursorPos(amm::InputWorker* worker, POINT point) {
+	if (worker) {
+		if (worker->EnqueueCursor(point)) {
+			return;
 		}
-		break;
 	}
+	CatchUpWithInputWorker();
+	::SetCursorPos(point.x, point.y);
+}
 
-	// Forward the message.
-	return ::CallWindowProc((WNDPROC) data.oldWndProc, hwnd, msg, wParam, lParam);
+// True if a newer mouse move is already waiting for this thread, and no button message is, so the
+// current move can be skipped without Live missing where a click happened.
+bool NewerMovePending() {
+	DWORD queued = HIWORD(::GetQueueStatus(QS_MOUSEMOVE | QS_MOUSEBUTTON));
+	return (queued & QS_MOUSEMOVE) && !(queued & QS_MOUSEBUTTON);
+}
+
+void StoreVirtualCursor(int x, int y) {
+	gVirtualCursor.store((uint64_t) (uint32_t) x | (uint64_t) (uint32_t) y << 32, std::memory_order_relaxed);
+}
+
+POINT LoadVirtualCursor() {
+	uint64_t packed = gVirtualCursor.load(std::memory_order_relaxed);
+	return { (LONG) (int32_t) (uint32_t) packed, (LONG) (int32_t) (uint32_t) (packed >> 32) };
+}
+
+void SetVirtualInput(POINT screenPoint, BYTE keyState) {
+	StoreVirtualCursor(screenPoint.x, screenPoint.y);
+	gVirtualKeyState.store(keyState, std::memory_order_relaxed);
+	gVirtualInput.store(true, std::memory_order_release);
+}
+
+void ClearVirtualInput() {
+	gVirtualInput.store(false, std::memory_order_release);
+	gVirtualKeyState.store(0, std::memory_order_relaxed);
+}
+
+// True if the virtual pan is holding down the modifier vk.
+bool VirtualKeyDown(int vk) {
+	if (!gVirtualInput.load(std::memory_order_acquire)) {
+		return false;
+	}
+	BYTE keyState = gVirtualKeyState.load(std::memory_order_relaxed);
+	switch (vk) {
+	case VK_CONTROL:
+	case VK_LCONTROL:
+		return (keyState & amm::kKeyStateControl) != 0;
+	case VK_MENU:
+	case VK_LMENU:
+		return (keyState & amm::kKeyStateAlt) != 0;
+	case VK_SHIFT:
+	case VK_LSHIFT:
+		return (keyState & amm::kKeyStateShift) != 0;
+	default:
+		return false;
+	}
+}
+
+SHORT WINAPI OurGetKeyState(int vk) {
+	SHORT state = reinterpret_cast<decltype(&::GetKeyState)>(gRealGetKeyState)(vk);
+	return VirtualKeyDown(vk) ? (SHORT) (state | 0x8000) : state;
+}
+
+SHORT WINAPI OurGetAsyncKeyState(int vk) {
+	SHORT state = reinterpret_cast<decltype(&::GetAsyncKeyState)>(gRealGetAsyncKeyState)(vk);
+	return VirtualKeyDown(vk) ? (SHORT) (state | 0x8000) : state;
+}
+
+BOOL WINAPI OurGetCursorPos(LPPOINT point) {
+	if (point && gVirtualInput.load(std::memory_order_acquire)) {
+		*point = LoadVirtualCursor();
+		return TRUE;
+	}
+	return reinterpret_cast<decltype(&::GetCursorPos)>(gRealGetCursorPos)(point);
+}
+
+// Live warps the cursor around during some drags. During a virtual pan that only moves the cursor
+// it thinks it has.
+BOOL WINAPI OurSetCursorPos(int x, int y) {
+	if (gVirtualInput.load(std::memory_order_acquire)) {
+		StoreVirtualCursor(x, y);
+		return TRUE;
+	}
+	return reinterpret_cast<decltype(&::SetCursorPos)>(gRealSetCursorPos)(x, y);
+}
+
+// Route Live's key state and cursor queries through us. Virtual pan is useless without at least the
+// key state ones, so returns false if those couldn't be patched.
+bool PatchLiveImports() {
+	if (gImportsPatched) {
+		return gRealGetKeyState || gRealGetAsyncKeyState;
+	}
+	gImportsPatched = true;
+	gPatchedModule = ::GetModuleHandle(nullptr);
+	gRealGetKeyState = amm::PatchImport(gPatchedModule, "user32.dll", "GetKeyState", (void*) &OurGetKeyState);
+	gRealGetAsyncKeyState = amm::PatchImport(gPatchedModule, "user32.dll", "GetAsyncKeyState", (void*) &OurGetAsyncKeyState);
+	gRealGetCursorPos = amm::PatchImport(gPatchedModule, "user32.dll", "GetCursorPos", (void*) &OurGetCursorPos);
+	gRealSetCursorPos = amm::PatchImport(gPatchedModule, "user32.dll", "SetCursorPos", (void*) &OurSetCursorPos);
+	return gRealGetKeyState || gRealGetAsyncKeyState;
+}
+
+void RestoreLiveImports() {
+	if (!gImportsPatched) {
+		return;
+	}
+	ClearVirtualInput();
+	amm::RestoreImport(gPatchedModule, (void*) &OurGetKeyState, gRealGetKeyState);
+	amm::RestoreImport(gPatchedModule, (void*) &OurGetAsyncKeyState, gRealGetAsyncKeyState);
+	amm::RestoreImport(gPatchedModule, (void*) &OurGetCursorPos, gRealGetCursorPos);
+	amm::RestoreImport(gPatchedModule, (void*) &OurSetCursorPos, gRealSetCursorPos);
+	gImportsPatched = false;
+}
+
+// Pick up the user's settings, publishing them for every window if they have changed.
+void ReloadSettings() {
+	amm::Settings loaded;
+	amm::LoadSettings(gModule, &loaded);
+	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
+	if ((loaded.features & amm::kFeatureVirtualPan) && !PatchLiveImports()) {
+		// Live doesn't ask user32 for key state the way we can intercept; fall back to real input.
+		loaded.features &= ~amm::kFeatureVirtualPan;
+	}
+	const SettingsSnapshot* current = gSettings.load(std::memory_order_relaxed);
+	if (current && amm::SameSettings(current->settings, loaded)) {
+		return;
+	}
+	SettingsSnapshot* snapshot = new SettingsSnapshot();
+	snapshot->settings = loaded;
+	snapshot->generation = current ? current->generation + 1 : 1;
+	const amm::Settings& settings = snapshot->settings;
+	if (gRepaintLatency) {
+		// Each report covers one set of settings, so two can be compared.
+		char formatted[sizeof(gRepaintSettings)];
+		amm::FormatSettings(settings, formatted, sizeof(formatted));
+		if (::strcmp(formatted, gRepaintSettings) != 0) {
+			ExportRepaintLatency();
+			::strcpy(gRepaintSettings, formatted);
+		}
+	}
+
+	// The worker itself waits for the first input to need it: this also runs in DllMain, where
+	// starting a thread under the loader lock is asking for a deadlock. Switching back to
+	// synchronous input needs no wait here, since synchronous input catches up with the worker.
+	gAsyncSynthesis.store(settings.asyncSynthesis, std::memory_order_relaxed);
+	gCoalesceMoves.store(settings.coalesceMoves, std::memory_order_relaxed);
+	gSettings.store(snapshot, std::memory_order_release);
+	if (current) {
+		gRetiredSettings.push_back(current);
+	}
+}
+
+// The input worker, started if this is the first time it's needed. nullptr if it can't be, in
+// which case input goes back to being synchronous, or if another thread is its producer.
+amm::InputWorker* StartedInputWorker() {
+	if (!gInputWorkerReady.load(std::memory_order_acquire)) {
+		std::lock_guard<std::recursive_mutex> lock(*gStateLock);
+		if (!gInputWorker.Started() && !gInputWorker.Start(gStats)) {
+			gAsyncSynthesis.store(false, std::memory_order_relaxed);
+			return nullptr;
+		}
+		gInputWorkerReady.store(true, std::memory_order_release);
+	}
+	DWORD threadId = ::GetCurrentThreadId();
+	DWORD producer = 0;
+	if (!gInputThread.compare_exchange_strong(producer, threadId) && producer != threadId) {
+		return nullptr;
+	}
+	return &gInputWorker;
+}
+
+// Before forwarding a message or sending input synchronously, let the worker finish whatever is
+// queued, from any thread, so nothing overtakes it. Free when nothing is.
+void CatchUpWithInputWorker() {
+	if (gInputWorkerReady.load(std::memory_order_acquire)) {
+		gInputWorker.WaitForEmitted();
+	}
+}
+
+// The latest settings. Only for code holding gStateLock, or running before any window is hooked.
+const amm::Settings& CurrentSettings() {
+	return gSettings.load(std::memory_order_acquire)->settings;
+}
+
+// The part of the settings a translator is set up with.
+void RecordSettings(const amm::Settings& settings, amm::RecordedSettings* recorded) {
+	recorded->features = settings.features;
+	recorded->predictionLeadMs = settings.predictionLeadMs;
+	recorded->inertiaFriction = settings.inertiaFriction;
+	recorded->zoomStepsPerFrame = settings.zoomStepsPerFrame;
+	recorded->pen = settings.pen;
+	recorded->remap = settings.remap;
+}
+
+// Set a window's translator up with a settings snapshot, the same way a replay of the recording
+// will. Only on the thread running its window procedure.
+void ApplySettings(const SettingsSnapshot& snapshot, const WindowData& data) {
+	amm::RecordedSettings applied;
+	RecordSettings(snapshot.settings, &applied);
+	amm::ApplyRecordedSettings(applied, &data.state->translator);
+	data.state->settingsGeneration = snapshot.generation;
+	if (gRecorder) {
+		gRecorder->AppendSettings(data.slot, applied);
+	}
+}
+
+// Every snapshot, once no window procedure of ours can run any more.
+void FreeSettings() {
+	for (const SettingsSnapshot* snapshot : gRetiredSettings) {
+		delete snapshot;
+	}
+	gRetiredSettings.clear();
+	delete gSettings.exchange(nullptr);
+}
+
+// Give a newly hooked window a clean slate, so nothing carries over from the last window in its
+// slot. Called before the window's messages can reach OurWndProc, and only once no frame of it is
+// still running for the slot's last window. The settings are applied with its first message.
+void ResetWindowState(WindowState* state) {
+	state->~WindowState();
+	new (state) WindowState();
 }
 
 // Construct a keyboard event suitable for use with SendInput, to simulate key presses.
@@ -444,36 +972,118 @@ INPUT MakeKeyboardEvent(int vk, bool keyUp) {
 // OurWndProc first.
 void MapWindow(HWND hwnd) {
 	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
-	auto findIt = gWindowMap->find(hwnd);
-	if (findIt != gWindowMap->end()) {
+	uintptr_t existing = 0;
+	if (gWindowMap.Find((uintptr_t) hwnd, &existing) >= 0) {
 		return;
 	}
 	LONG_PTR oldWndProc = ::GetWindowLongPtr(hwnd, GWLP_WNDPROC);
-	WindowData data = { hwnd, oldWndProc };
-	(*gWindowMap)[hwnd] = data;
+	int slot = gWindowMap.Insert((uintptr_t) hwnd, (uintptr_t) oldWndProc, [](int index) {
+		return gSlotUse[index].handlers.load(std::memory_order_seq_cst) == 0;
+	});
+	if (slot < 0) {
+		// Out of slots. Leave the window alone rather than hooking it without a way back.
+		uint32_t skipped = gStats->windowsSkipped.fetch_add(1, std::memory_order_relaxed) + 1;
+		amm::Trace(amm::TraceEvent::kRegistryFull, (int32_t) (uintptr_t) hwnd, amm::WindowRegistry::kCapacity, (int32_t) skipped);
+		return;
+	}
+	ResetWindowState(&gWindowStates[slot]);
+	gWindowStates[slot].root = ::GetAncestor(hwnd, GA_ROOT);
 
 	::SetWindowLongPtr(hwnd, GWLP_WNDPROC, (LONG_PTR) OurWndProc);
+	gStats->windowsMapped.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Hook a window if it is one of Live's own.
+void MapLiveWindow(HWND hwnd) {
+	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
+	if (!IsLiveWindowClass(hwnd)) {
+		gStats->windowsSkipped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	MapWindow(hwnd);
+}
+
+// Whether Live's executable registered the window's class, as opposed to the system, a plugin or
+// an IME. Needs gStateLock.
+bool IsLiveWindowClass(HWND hwnd) {
+	ATOM atom = (ATOM) ::GetClassWord(hwnd, GCW_ATOM);
+	for (int i = 0; i < gWindowClassCount; ++i) {
+		if (gWindowClasses[i].atom == atom) {
+			return gWindowClasses[i].live;
+		}
+	}
+	bool live = atom != 0 && (HMODULE) ::GetClassLongPtr(hwnd, GCLP_HMODULE) == gLiveModule;
+	if (atom != 0 && gWindowClassCount < kMaxWindowClasses) {
+		gWindowClasses[gWindowClassCount++] = { atom, live };
+	}
+	return live;
+}
+
+// Hook every window Live already has, top-level and child, so input is handled from the start.
+void MapExistingWindows() {
+	::EnumWindows(EnumLiveWindow, 0);
+}
+
+BOOL CALLBACK EnumLiveWindow(HWND hwnd, LPARAM lParam) {
+	DWORD processId = 0;
+	::GetWindowThreadProcessId(hwnd, &processId);
+	if (processId != ::GetCurrentProcessId()) {
+		return TRUE;
+	}
+	MapLiveWindow(hwnd);
+	if (lParam == 0) {
+		// EnumChildWindows already walks every descendant.
+		::EnumChildWindows(hwnd, EnumLiveWindow, 1);
+	}
+	return TRUE;
 }
 
 // Stop overriding a window's WndProc.
 void UnmapWindow(HWND hwnd) {
 	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
-	auto findIt = gWindowMap->find(hwnd);
-	if (findIt == gWindowMap->end()) {
+	uintptr_t oldWndProc = 0;
+	if (gWindowMap.Find((uintptr_t) hwnd, &oldWndProc) < 0) {
 		return;
 	}
-	auto data = findIt->second;
-	gWindowMap->erase(findIt);
+	gWindowMap.Erase((uintptr_t) hwnd);
 
 	// This might be incorrect by the time it gets to us.
-	::SetWindowLongPtr(data.hwnd, GWLP_WNDPROC, data.oldWndProc);
+	::SetWindowLongPtr(hwnd, GWLP_WNDPROC, (LONG_PTR) oldWndProc);
+	if (!gWindowMap.AnyKey()) {
+		SaveMeasurements();
+	}
 }
 
 // Stop overriding all known window WndProcs.
 void UnmapAllWindows() {
 	std::lock_guard<std::recursive_mutex> lock(*gStateLock);
-	while (!gWindowMap->empty()) {
-		UnmapWindow(gWindowMap->begin()->first);
+	while (uintptr_t hwnd = gWindowMap.AnyKey()) {
+		UnmapWindow((HWND) hwnd);
+	}
+}
+
+// Keeps gCursorShown up to date as Live shows and hides the cursor, so moves don't have to poll.
+// Only in-process events reach us; until one does, Fetch polls.
+void CALLBACK OurCursorEventProc(
+		HWINEVENTHOOK hWinEventHook,
+		DWORD         event,
+		HWND          hwnd,
+		LONG          idObject,
+		LONG          idChild,
+		DWORD         dwEventThread,
+		DWORD         dwmsEventTime) {
+	if (idObject != OBJID_CURSOR) {
+		return;
+	}
+	switch (event) {
+	case EVENT_OBJECT_SHOW:
+		gCursorShown.store(1, std::memory_order_relaxed);
+		break;
+	case EVENT_OBJECT_HIDE:
+		gCursorShown.store(0, std::memory_order_relaxed);
+		break;
+	default:
+		break;
 	}
 }
 
@@ -487,12 +1097,16 @@ void CALLBACK OurWinEventProc(
 		LONG          idChild,
 		DWORD         dwEventThread,
 		DWORD         dwmsEventTime) {
+	gStats->windowEvents.fetch_add(1, std::memory_order_relaxed);
+	if (idObject != OBJID_WINDOW || idChild != CHILDID_SELF || !hwnd) {
+		return;
+	}
 	switch (event) {
-	case WM_DESTROY:
-		UnmapWindow(hwnd);
+	case EVENT_OBJECT_CREATE:
+		MapLiveWindow(hwnd);
 		break;
-	case WM_KILLFOCUS:
-		MapWindow(hwnd);
+	case EVENT_OBJECT_DESTROY:
+		UnmapWindow(hwnd);
 		break;
 	default:
 		break;
@@ -504,21 +1118,76 @@ void CALLBACK OurWinEventProc(
 // DLL entry point, which is called when Live scans the plugin. Since we don't actually export any
 // VST functions, Live unloads us immediately, but this gives us a chance to install a window hook.
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD ulReasonForCall, LPVOID lpReserved) {
-	HWINEVENTHOOK hHook = nullptr;
 	switch (ulReasonForCall) {
 	case DLL_PROCESS_ATTACH:
 		if (!gStateLock) {
 			gStateLock = new std::recursive_mutex();
 		}
-		if (!gWindowMap) {
-			gWindowMap = new std::unordered_map<HWND, WindowData>();
+		if (!gModule) {
+			gModule = hModule;
+			gLiveModule = ::GetModuleHandle(nullptr);
+			LARGE_INTEGER frequency;
+			if (::QueryPerformanceFrequency(&frequency) && frequency.QuadPart > 0) {
+				gPerformanceFrequency = frequency.QuadPart;
+			}
+			CreateStatsMapping();
+			ReloadSettings();
+			if (const char* recordPath = ::getenv("AMM_RECORD_INPUT")) {
+				amm::RecordedSettings settings;
+				RecordSettings(CurrentSettings(), &settings);
+				gRecorder = new amm::InputRecorder();
+				if (!gRecorder->Open(recordPath, settings)) {
+					delete gRecorder;
+					gRecorder = nullptr;
+				}
+			}
+			if (const char* repaintPath = ::getenv("AMM_REPAINT_LATENCY")) {
+				gRepaintLatency = new amm::RepaintHistograms();
+				gRepaintLatencyPath = repaintPath;
+				amm::FormatSettings(CurrentSettings(), gRepaintSettings, sizeof(gRepaintSettings));
+				LARGE_INTEGER now;
+				::QueryPerformanceCounter(&now);
+				gRepaintSince = now.QuadPart;
+			}
+			if (const char* touchPath = ::getenv("AMM_RECORD_TOUCH")) {
+				gTouchRecorder = new amm::TouchRecorder();
+				if (!gTouchRecorder->Open(touchPath)) {
+					delete gTouchRecorder;
+					gTouchRecorder = nullptr;
+				}
+			}
+		}
+		if (!gWindowHook) {
+			LARGE_INTEGER start;
+			::QueryPerformanceCounter(&start);
+			// Hook creation first, so a window created while we enumerate can't slip between the two.
+			gWindowHook = ::SetWinEventHook(EVENT_OBJECT_CREATE, EVENT_OBJECT_DESTROY, hModule, OurWinEventProc, ::GetCurrentProcessId(), 0, WINEVENT_INCONTEXT);
+			MapExistingWindows();
+			LARGE_INTEGER end;
+			::QueryPerformanceCounter(&end);
+			uint64_t coverageMicros = (uint64_t) ((end.QuadPart - start.QuadPart) * 1000000 / gPerformanceFrequency);
+			gStats->coverageMicros.store(coverageMicros, std::memory_order_relaxed);
+			amm::Trace(amm::TraceEvent::kHookCoverage, (int32_t) gStats->windowsMapped.load(std::memory_order_relaxed),
+				(int32_t) gStats->windowsSkipped.load(std::memory_order_relaxed), (int32_t) coverageMicros);
+		}
+		if (!gCursorHook) {
+			gCursorHook = ::SetWinEventHook(EVENT_OBJECT_SHOW, EVENT_OBJECT_HIDE, hModule, OurCursorEventProc, ::GetCurrentProcessId(), 0, WINEVENT_INCONTEXT);
 		}
-		hHook = ::SetWinEventHook(WM_CREATE, WM_KILLFOCUS, hModule, OurWinEventProc, ::GetCurrentProcessId(), 0, WINEVENT_INCONTEXT);
 		break;
 	case DLL_PROCESS_DETACH:
+		if (gWindowHook) {
+			::UnhookWinEvent(gWindowHook);
+			gWindowHook = nullptr;
+		}
+		if (gCursorHook) {
+			::UnhookWinEvent(gCursorHook);
+			gCursorHook = nullptr;
+		}
 		if (!lpReserved) {
 			// DLL detaching, process stays around.
 			UnmapAllWindows();
+			RestoreLiveImports();
+			FreeSettings();
 		}
 		break;
 	case DLL_THREAD_ATTACH:
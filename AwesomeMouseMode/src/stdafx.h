@@ -8,6 +8,8 @@
 
 #include <stdio.h>
 #include <tchar.h>
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <windowsx.h>
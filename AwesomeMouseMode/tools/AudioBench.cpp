@@ -0,0 +1,140 @@
+// Microbenchmark for the plugin's audio pass-through (see AudioPassThrough.h): cost per stereo block
+// for every kernel the CPU supports, across the buffer sizes hosts commonly use, with buffers laid
+// out the way hosts tend to (separate, aligned), offset by a sample, and processed in place.
+//
+//   AudioBench [iterations]
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -O2 -I../src AudioBench.cpp ../src/AudioPassThrough.cpp
+
+#include "AudioPassThrough.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr int kChannels = 2;
+constexpr int kBlockSizes[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+constexpr int kMaxFrames = 4096;
+
+enum class Layout {
+	kAligned,
+	kOffset,   // Output one sample past alignment, as hosts with interleaved scratch space may give.
+	kInPlace,
+};
+
+// Buffers with room to misalign, filled with a quiet signal that includes some denormals.
+template <typename T>
+struct Buffers {
+	std::vector<T> storage[kChannels * 2];
+	T* in[kChannels];
+	T* out[kChannels];
+
+	explicit Buffers(Layout layout) {
+		for (int c = 0; c < kChannels * 2; ++c) {
+			storage[c].assign(kMaxFrames + 64, T(0));
+		}
+		for (int c = 0; c < kChannels; ++c) {
+			in[c] = Align(storage[c].data());
+			out[c] = Align(storage[kChannels + c].data()) + (layout == Layout::kOffset ? 1 : 0);
+			if (layout == Layout::kInPlace) {
+				out[c] = in[c];
+			}
+			for (int i = 0; i < kMaxFrames; ++i) {
+				in[c][i] = (i % 97 == 0) ? T(1e-40) : T((i % 200) - 100) / T(1000);
+			}
+		}
+	}
+
+	static T* Align(T* p) {
+		uintptr_t address = ((uintptr_t) p + 63) & ~(uintptr_t) 63;
+		return (T*) address;
+	}
+};
+
+const char* const layoutNames[] = { "aligned", "offset", "inplace" };
+
+template <typename T>
+double NanosPerBlock(amm::PassThroughKernel kernel, Layout layout, int frames, int iterations) {
+	Buffers<T> buffers(layout);
+	// Warm the caches and the branch predictors first.
+	for (int i = 0; i < 100; ++i) {
+		amm::PassThroughWith(kernel, buffers.in, buffers.out, kChannels, frames);
+	}
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		amm::PassThroughWith(kernel, buffers.in, buffers.out, kChannels, frames);
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+template <typename T>
+void Run(const char* type, int iterations) {
+	std::printf("%s, %d channels, ns per block\n", type, kChannels);
+	std::printf("%-8s %-8s", "kernel", "layout");
+	for (int frames : kBlockSizes) {
+		std::printf(" %8d", frames);
+	}
+	std::printf("\n");
+	for (int k = 0; k < (int) amm::PassThroughKernel::kCount; ++k) {
+		amm::PassThroughKernel kernel = (amm::PassThroughKernel) k;
+		if (!amm::PassThroughKernelSupported(kernel)) {
+			continue;
+		}
+		for (int l = 0; l < 3; ++l) {
+			std::printf("%-8s %-8s", amm::PassThroughKernelName(kernel), layoutNames[l]);
+			for (int frames : kBlockSizes) {
+				std::printf(" %8.1f", NanosPerBlock<T>(kernel, (Layout) l, frames, iterations));
+			}
+			std::printf("\n");
+		}
+	}
+	std::printf("\n");
+}
+
+// The kernels must agree with each other, denormals and all, in place too.
+template <typename T>
+bool Check() {
+	Buffers<T> reference(Layout::kAligned);
+	amm::PassThroughWith(amm::PassThroughKernel::kScalar, reference.in, reference.out, kChannels, kMaxFrames - 1);
+	for (int k = 0; k < (int) amm::PassThroughKernel::kCount; ++k) {
+		amm::PassThroughKernel kernel = (amm::PassThroughKernel) k;
+		if (!amm::PassThroughKernelSupported(kernel)) {
+			continue;
+		}
+		for (int l = 0; l < 3; ++l) {
+			Buffers<T> buffers((Layout) l);
+			amm::PassThroughWith(kernel, buffers.in, buffers.out, kChannels, kMaxFrames - 1);
+			for (int c = 0; c < kChannels; ++c) {
+				for (int i = 0; i < kMaxFrames - 1; ++i) {
+					if (buffers.out[c][i] != reference.out[c][i]) {
+						std::fprintf(stderr, "%s %s differs at channel %d frame %d\n", amm::PassThroughKernelName(kernel),
+							layoutNames[l], c, i);
+						return false;
+					}
+				}
+			}
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int iterations = argc > 1 ? std::atoi(argv[1]) : 20000;
+	if (iterations <= 0) {
+		std::fprintf(stderr, "usage: AudioBench [iterations]\n");
+		return 2;
+	}
+	if (!Check<float>() || !Check<double>()) {
+		return 1;
+	}
+	std::printf("Best kernel: %s\n\n", amm::PassThroughKernelName(amm::BestPassThroughKernel()));
+	Run<float>("float", iterations);
+	Run<double>("double", iterations);
+	return 0;
+}
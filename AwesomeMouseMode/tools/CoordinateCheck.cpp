@@ -0,0 +1,183 @@
+// Property checks for the cached coordinate transforms (see CoordinateSpace.h), over random window
+// geometries at every common DPI pairing, mirrored and not, on monitors all over the virtual screen:
+//
+//   - client and screen convert back and forth exactly;
+//   - a round trip from the coarser of screen and physical space lands where it started, and one
+//     from the finer within one coarse pixel, never past the starting point;
+//   - scaling is monotonic, exact at the monitor's corner and within a pixel of the real ratio;
+//   - cursor warps clamped to the monitor stay on it, and points already on it don't move.
+//
+//   CoordinateCheck [geometries] [seed]
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -O2 -I../src CoordinateCheck.cpp
+
+#include "CoordinateSpace.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+constexpr int kDpis[] = { 96, 120, 144, 168, 192, 216, 240, 288 };
+constexpr int kPointsPerGeometry = 2000;
+
+class Random {
+public:
+	explicit Random(uint32_t seed) : state_(seed ? seed : 1) {}
+
+	uint32_t Next() {
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 17;
+		state_ ^= state_ << 5;
+		return state_;
+	}
+	int Between(int low, int high) { return low + (int) (Next() % (uint32_t) (high - low + 1)); }
+
+private:
+	uint32_t state_;
+};
+
+int gFailures = 0;
+
+void Fail(const amm::WindowGeometry& geometry, const char* property, POINT from, POINT to) {
+	if (++gFailures <= 10) {
+		std::fprintf(stderr, "%s: [%d, %d] -> [%d, %d] (origin [%d, %d]%s, %d DPI on %d, monitor at [%d, %d])\n",
+			property, (int) from.x, (int) from.y, (int) to.x, (int) to.y, (int) geometry.clientOrigin.x,
+			(int) geometry.clientOrigin.y, geometry.mirrored ? " mirrored" : "", geometry.dpi, geometry.monitorDpi,
+			(int) geometry.monitor.left, (int) geometry.monitor.top);
+	}
+}
+
+amm::WindowGeometry RandomGeometry(Random* random) {
+	amm::WindowGeometry geometry = {};
+	geometry.monitor.left = random->Between(-7680, 7680);
+	geometry.monitor.top = random->Between(-4320, 4320);
+	geometry.monitor.right = geometry.monitor.left + random->Between(640, 7680);
+	geometry.monitor.bottom = geometry.monitor.top + random->Between(480, 4320);
+	geometry.clientOrigin.x = random->Between(geometry.monitor.left - 500, geometry.monitor.right);
+	geometry.clientOrigin.y = random->Between(geometry.monitor.top - 500, geometry.monitor.bottom);
+	geometry.mirrored = random->Between(0, 3) == 0;
+	geometry.dpi = kDpis[random->Between(0, (int) (sizeof(kDpis) / sizeof(kDpis[0])) - 1)];
+	// Mostly per-monitor aware windows, otherwise scaled by Windows either way.
+	geometry.monitorDpi = random->Between(0, 2) == 0 ? geometry.dpi : kDpis[random->Between(0, (int) (sizeof(kDpis) / sizeof(kDpis[0])) - 1)];
+	return geometry;
+}
+
+bool Same(POINT a, POINT b) {
+	return a.x == b.x && a.y == b.y;
+}
+
+// How far a round trip from the finer space may fall short: under one coarse pixel, measured in
+// fine ones.
+bool WithinCoarsePixel(LONG start, LONG end, int fine, int coarse) {
+	return end <= start && (int64_t) (start - end) * coarse < fine;
+}
+
+void CheckGeometry(const amm::WindowGeometry& geometry, Random* random) {
+	amm::CoordinateSpace space;
+	space.Update(geometry, space.Generation());
+	if (!space.Valid()) {
+		Fail(geometry, "valid after update", {}, {});
+	}
+	const RECT& monitor = geometry.monitor;
+	bool screenCoarser = geometry.dpi < geometry.monitorDpi;
+	int fine = screenCoarser ? geometry.monitorDpi : geometry.dpi;
+	int coarse = screenCoarser ? geometry.dpi : geometry.monitorDpi;
+
+	POINT corner = { monitor.left, monitor.top };
+	if (!Same(space.PhysicalToScreen(corner), corner) || !Same(space.ScreenToPhysical(corner), corner)) {
+		Fail(geometry, "monitor corner fixed", corner, space.PhysicalToScreen(corner));
+	}
+	for (int i = 0; i < kPointsPerGeometry; ++i) {
+		POINT point = { random->Between(monitor.left - 4000, monitor.right + 4000), random->Between(monitor.top - 4000, monitor.bottom + 4000) };
+
+		POINT client = space.ScreenToClient(point);
+		if (!Same(space.ClientToScreen(client), point)) {
+			Fail(geometry, "screen -> client -> screen", point, space.ClientToScreen(client));
+		}
+		POINT screen = space.ClientToScreen(point);
+		if (!Same(space.ScreenToClient(screen), point)) {
+			Fail(geometry, "client -> screen -> client", point, space.ScreenToClient(screen));
+		}
+		LONG expectedX = geometry.mirrored ? geometry.clientOrigin.x - point.x : geometry.clientOrigin.x + point.x;
+		if (screen.x != expectedX || screen.y != geometry.clientOrigin.y + point.y) {
+			Fail(geometry, "client -> screen offset", point, screen);
+		}
+
+		// Screen <-> physical, both ways round.
+		POINT physical = space.ScreenToPhysical(point);
+		POINT back = space.PhysicalToScreen(physical);
+		POINT logical = space.PhysicalToScreen(point);
+		POINT forth = space.ScreenToPhysical(logical);
+		if (screenCoarser) {
+			if (!Same(back, point)) {
+				Fail(geometry, "screen -> physical -> screen", point, back);
+			}
+			if (!WithinCoarsePixel(point.x, forth.x, fine, coarse) || !WithinCoarsePixel(point.y, forth.y, fine, coarse)) {
+				Fail(geometry, "physical -> screen -> physical", point, forth);
+			}
+		} else {
+			if (!Same(forth, point)) {
+				Fail(geometry, "physical -> screen -> physical", point, forth);
+			}
+			if (!WithinCoarsePixel(point.x, back.x, fine, coarse) || !WithinCoarsePixel(point.y, back.y, fine, coarse)) {
+				Fail(geometry, "screen -> physical -> screen", point, back);
+			}
+		}
+		double idealX = monitor.left + (point.x - monitor.left) * (double) geometry.dpi / geometry.monitorDpi;
+		double idealY = monitor.top + (point.y - monitor.top) * (double) geometry.dpi / geometry.monitorDpi;
+		if (std::fabs(logical.x - idealX) >= 1 || std::fabs(logical.y - idealY) >= 1) {
+			Fail(geometry, "physical -> screen scale", point, logical);
+		}
+		POINT next = { point.x + 1, point.y + 1 };
+		POINT logicalNext = space.PhysicalToScreen(next);
+		POINT physicalNext = space.ScreenToPhysical(next);
+		if (logicalNext.x < logical.x || logicalNext.y < logical.y || physicalNext.x < physical.x || physicalNext.y < physical.y) {
+			Fail(geometry, "monotonic", point, next);
+		}
+		if (geometry.dpi == geometry.monitorDpi && (!Same(physical, point) || !Same(logical, point))) {
+			Fail(geometry, "same DPI is identity", point, physical);
+		}
+		if (!Same(space.PhysicalToClient(point), space.ScreenToClient(logical)) ||
+				!Same(space.ClientToPhysical(point), space.ScreenToPhysical(screen))) {
+			Fail(geometry, "composed conversions", point, space.PhysicalToClient(point));
+		}
+
+		POINT clamped = space.ClampToMonitor(point);
+		bool inside = point.x >= monitor.left && point.x < monitor.right && point.y >= monitor.top && point.y < monitor.bottom;
+		if (clamped.x < monitor.left || clamped.x >= monitor.right || clamped.y < monitor.top || clamped.y >= monitor.bottom ||
+				(inside && !Same(clamped, point)) || !Same(space.ClampToMonitor(clamped), clamped)) {
+			Fail(geometry, "clamp to monitor", point, clamped);
+		}
+	}
+
+	space.Invalidate();
+	if (space.Valid()) {
+		Fail(geometry, "invalid after invalidate", {}, {});
+	}
+	// An invalidation racing a refresh must win.
+	uint32_t generation = space.Generation();
+	space.Invalidate();
+	space.Update(geometry, generation);
+	if (space.Valid()) {
+		Fail(geometry, "invalidation during refresh kept", {}, {});
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int geometries = argc > 1 ? std::atoi(argv[1]) : 20000;
+	uint32_t seed = argc > 2 ? (uint32_t) std::strtoul(argv[2], nullptr, 0) : 0x414D4D24u;
+	if (geometries <= 0) {
+		std::fprintf(stderr, "usage: CoordinateCheck [geometries] [seed]\n");
+		return 2;
+	}
+	Random random(seed);
+	for (int i = 0; i < geometries; ++i) {
+		CheckGeometry(RandomGeometry(&random), &random);
+	}
+	std::printf("%d geometries, %d points each: %d failures\n", geometries, kPointsPerGeometry, gFailures);
+	return gFailures == 0 ? 0 : 1;
+}
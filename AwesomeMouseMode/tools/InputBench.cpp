@@ -0,0 +1,254 @@
+// Microbenchmark for the message handler's hot path (see InputBenchmark.h): runs each synthetic
+// load through the translator against stand-ins for user32, and reports per-message latency
+// percentiles and throughput. With a baseline, fails if any load got slower than it by more than
+// the tolerance, so hot-path regressions are caught before they reach a stage.
+//
+//   InputBench [--check baseline] [--write baseline] [--tolerance percent] [--seconds n]
+//              [--repetitions n] [--features hex]
+//   InputBench --combinations [--seconds n] [--repetitions n]
+//
+// --combinations runs every load under each combination of the specialized features, one row per
+// combination, to show what each feature costs per message.
+//
+// Baselines are per machine: write one on the box that will do the checking, from a known-good
+// build. p50, p99 and throughput are checked; p99.9 and the worst case are too much at the mercy of
+// the scheduler, and are only reported. A baseline records how many messages each load timed, and
+// a shorter run isn't checked against it: its percentiles are too noisy to call a regression.
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src InputBench.cpp ../src/InputBenchmark.cpp ../src/InputTranslator.cpp
+//       ../src/KeyRemap.cpp ../src/MotionPredictor.cpp ../src/PanInertia.cpp ../src/PenFilter.cpp
+//       ../src/ScrollEngine.cpp ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp ../src/ZoomScheduler.cpp
+
+#include "InputBenchmark.h"
+#include "InputTranslator.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+constexpr int kLoads = (int) amm::SyntheticLoad::kCount;
+
+struct Baseline {
+	bool present[kLoads] = {};
+	double p50Nanos[kLoads] = {};
+	double p99Nanos[kLoads] = {};
+	double messagesPerSecond[kLoads] = {};
+	unsigned long long samples[kLoads] = {};  // 0 for baselines from before they were recorded.
+};
+
+// One line per load: name, p50 and p99 in ns, messages per second, messages timed over every
+// repetition. '#' starts a comment.
+bool ReadBaseline(const char* path, Baseline* baseline) {
+	FILE* file = std::fopen(path, "r");
+	if (!file) {
+		std::fprintf(stderr, "Can't read baseline %s\n", path);
+		return false;
+	}
+	char line[256];
+	while (std::fgets(line, sizeof(line), file)) {
+		char name[64];
+		double p50 = 0;
+		double p99 = 0;
+		double throughput = 0;
+		unsigned long long samples = 0;
+		if (line[0] == '#' || std::sscanf(line, "%63s %lf %lf %lf %llu", name, &p50, &p99, &throughput, &samples) < 4) {
+			continue;
+		}
+		for (int i = 0; i < kLoads; ++i) {
+			if (std::strcmp(name, amm::SyntheticLoadName((amm::SyntheticLoad) i)) == 0) {
+				baseline->present[i] = true;
+				baseline->p50Nanos[i] = p50;
+				baseline->p99Nanos[i] = p99;
+				baseline->messagesPerSecond[i] = throughput;
+				baseline->samples[i] = samples;
+			}
+		}
+	}
+	std::fclose(file);
+	return true;
+}
+
+bool WriteBaseline(const char* path, const amm::LoadBenchmark* results, uint32_t features, int seconds, int repetitions) {
+	FILE* file = std::fopen(path, "w");
+	if (!file) {
+		std::fprintf(stderr, "Can't write baseline %s\n", path);
+		return false;
+	}
+	std::fprintf(file, "# InputBench baseline, features %#x, --seconds %d --repetitions %d: load, p50 ns, p99 ns, "
+		"messages per second, messages timed\n", features, seconds, repetitions);
+	for (int i = 0; i < kLoads; ++i) {
+		std::fprintf(file, "%s %.0f %.0f %.0f %llu\n", amm::SyntheticLoadName((amm::SyntheticLoad) i),
+			results[i].p50Nanos, results[i].p99Nanos, results[i].messagesPerSecond,
+			(unsigned long long) results[i].messages * repetitions);
+	}
+	std::fclose(file);
+	return true;
+}
+
+// Checks a latency against its baseline, printing what regressed. Latencies of a few ns are all
+// clock noise, so there's a floor under the allowance.
+bool WithinLatency(const char* load, const char* what, double value, double baseline, double tolerance) {
+	double allowed = baseline * (1 + tolerance) + 5;
+	if (value <= allowed) {
+		return true;
+	}
+	std::printf("REGRESSION %s %s: %.0f ns, baseline %.0f ns\n", load, what, value, baseline);
+	return false;
+}
+
+int Usage() {
+	std::fprintf(stderr, "usage: InputBench [--check baseline] [--write baseline] [--tolerance percent] "
+		"[--seconds n] [--repetitions n] [--features hex]\n"
+		"       InputBench --combinations [--seconds n] [--repetitions n]\n");
+	return 2;
+}
+
+// p50 per load for every specialization of the handler, and how much slower than with no features
+// each combination is overall.
+int ReportCombinations(int seconds, int repetitions) {
+	std::printf("every combination of features %#x, %d s of input per load, best of %d runs: p50 ns\n\n",
+		amm::kSpecializedFeatures, seconds, repetitions);
+	std::printf("%-8s", "features");
+	for (int i = 0; i < kLoads; ++i) {
+		std::printf(" %16s", amm::SyntheticLoadName((amm::SyntheticLoad) i));
+	}
+	std::printf(" %8s %8s\n", "msg/s", "vs none");
+	// Warm caches and clocks up first, or the first row pays for it.
+	for (int i = 0; i < kLoads; ++i) {
+		amm::LoadBenchmark result;
+		if (!amm::BenchmarkSyntheticLoad((amm::SyntheticLoad) i, 0, seconds, 1, &result)) {
+			return 2;
+		}
+	}
+	double noneSeconds = 0;
+	for (uint32_t features = 0; features < amm::kFeatureCombinations; ++features) {
+		std::printf("%#-8x", features);
+		// Time for one pass over every load, back to back.
+		double passSeconds = 0;
+		uint64_t messages = 0;
+		for (int i = 0; i < kLoads; ++i) {
+			amm::LoadBenchmark result;
+			if (!amm::BenchmarkSyntheticLoad((amm::SyntheticLoad) i, features, seconds, repetitions, &result)) {
+				return 2;
+			}
+			std::printf(" %16.0f", result.p50Nanos);
+			passSeconds += result.messagesPerSecond > 0 ? result.messages / result.messagesPerSecond : 0;
+			messages += result.messages;
+		}
+		if (features == 0) {
+			noneSeconds = passSeconds;
+		}
+		std::printf(" %7.2fM %+7.0f%%\n", passSeconds > 0 ? messages / passSeconds / 1e6 : 0.0,
+			noneSeconds > 0 ? (passSeconds / noneSeconds - 1) * 100 : 0.0);
+	}
+	return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	const char* checkPath = nullptr;
+	const char* writePath = nullptr;
+	double tolerance = 0.25;
+	int seconds = 60;
+	int repetitions = 5;
+	uint32_t features = amm::kDefaultFeatures;
+	bool combinations = false;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--combinations") == 0) {
+			combinations = true;
+			continue;
+		}
+		if (i + 1 >= argc) {
+			return Usage();
+		}
+		const char* value = argv[++i];
+		if (std::strcmp(argv[i - 1], "--check") == 0) {
+			checkPath = value;
+		} else if (std::strcmp(argv[i - 1], "--write") == 0) {
+			writePath = value;
+		} else if (std::strcmp(argv[i - 1], "--tolerance") == 0) {
+			tolerance = std::atof(value) / 100;
+		} else if (std::strcmp(argv[i - 1], "--seconds") == 0) {
+			seconds = std::atoi(value);
+		} else if (std::strcmp(argv[i - 1], "--repetitions") == 0) {
+			repetitions = std::atoi(value);
+		} else if (std::strcmp(argv[i - 1], "--features") == 0) {
+			features = (uint32_t) std::strtoul(value, nullptr, 16);
+		} else {
+			return Usage();
+		}
+	}
+	if (seconds <= 0 || repetitions <= 0 || tolerance < 0) {
+		return Usage();
+	}
+	if (combinations) {
+		// A baseline is for one set of features.
+		return checkPath || writePath ? Usage() : ReportCombinations(seconds, repetitions);
+	}
+	Baseline baseline;
+	if (checkPath && !ReadBaseline(checkPath, &baseline)) {
+		return 2;
+	}
+
+	std::printf("features %#x, %d s of input per load, best of %d runs\n\n", features, seconds, repetitions);
+	std::printf("%-16s %8s %7s %7s %8s %8s %8s %11s %8s %8s\n", "load", "messages", "timers", "queries",
+		"p50 ns", "p99 ns", "p99.9 ns", "max ns", "msg/s", "vs base");
+	amm::LoadBenchmark results[kLoads];
+	bool ok = true;
+	for (int i = 0; i < kLoads; ++i) {
+		amm::SyntheticLoad load = (amm::SyntheticLoad) i;
+		amm::LoadBenchmark& result = results[i];
+		if (!amm::BenchmarkSyntheticLoad(load, features, seconds, repetitions, &result)) {
+			return 2;
+		}
+		const char* name = amm::SyntheticLoadName(load);
+		char versus[16] = "-";
+		if (baseline.present[i] && baseline.messagesPerSecond[i] > 0) {
+			std::snprintf(versus, sizeof(versus), "%+.0f%%", (result.messagesPerSecond / baseline.messagesPerSecond[i] - 1) * 100);
+		}
+		std::printf("%-16s %8llu %7llu %7llu %8.0f %8.0f %8.0f %11.0f %8.2fM %8s\n", name,
+			(unsigned long long) result.messages, (unsigned long long) result.timerMessages,
+			(unsigned long long) result.queries, result.p50Nanos, result.p99Nanos, result.p999Nanos,
+			result.maxNanos, result.messagesPerSecond / 1e6, versus);
+	}
+	std::printf("\n");
+
+	if (checkPath) {
+		for (int i = 0; i < kLoads; ++i) {
+			const char* name = amm::SyntheticLoadName((amm::SyntheticLoad) i);
+			unsigned long long timed = results[i].messages * repetitions;
+			if (baseline.present[i] && timed < baseline.samples[i]) {
+				std::printf("Not checking against %s: %s timed %llu messages, the baseline %llu. Run at least as long as "
+					"the baseline did.\n", checkPath, name, timed, baseline.samples[i]);
+				return 2;
+			}
+			if (baseline.present[i] && baseline.samples[i] == 0) {
+				std::printf("Not checking against %s: it doesn't say how long a run it came from. Write it again.\n", checkPath);
+				return 2;
+			}
+		}
+		for (int i = 0; i < kLoads; ++i) {
+			const char* name = amm::SyntheticLoadName((amm::SyntheticLoad) i);
+			if (!baseline.present[i]) {
+				std::printf("%s isn't in the baseline\n", name);
+				continue;
+			}
+			ok &= WithinLatency(name, "p50", results[i].p50Nanos, baseline.p50Nanos[i], tolerance);
+			ok &= WithinLatency(name, "p99", results[i].p99Nanos, baseline.p99Nanos[i], tolerance);
+			if (results[i].messagesPerSecond * (1 + tolerance) < baseline.messagesPerSecond[i]) {
+				std::printf("REGRESSION %s throughput: %.0f messages/s, baseline %.0f\n", name,
+					results[i].messagesPerSecond, baseline.messagesPerSecond[i]);
+				ok = false;
+			}
+		}
+		std::printf("%s against %s, %.0f%% tolerance\n", ok ? "PASS" : "FAIL", checkPath, tolerance * 100);
+	}
+	if (writePath && !WriteBaseline(writePath, results, features, seconds, repetitions)) {
+		return 2;
+	}
+	return ok ? 0 : 1;
+}
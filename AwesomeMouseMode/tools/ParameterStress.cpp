@@ -0,0 +1,148 @@
+// Stress test for the gesture parameter bridge (see GestureParameters.h): a UI-like producer
+// publishing at 1 kHz against an audio-like consumer taking 256-frame blocks at 48 kHz, with the
+// consumer stalling now and then like a host under load. Checks that every update arrives exactly
+// once and in order, that nothing was dropped, and reports how long the worst Publish and TakeBlock
+// took.
+//
+//   ParameterStress [seconds] [stall-ms]
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -pthread -I../src ParameterStress.cpp ../src/GestureParameters.cpp
+
+#include "GestureParameters.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+constexpr int kFrames = 256;
+constexpr float kSampleRate = 48000.0f;
+constexpr int kMaxEvents = 64;
+// Every this many blocks the consumer stalls, as a host does when a project loads or a plugin
+// window opens.
+constexpr int kStallEvery = 200;
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+	uint64_t updates = 0;
+	uint64_t failedPublishes = 0;
+	uint64_t maxPublishNanos = 0;
+	uint64_t blocks = 0;
+	uint64_t received = 0;
+	uint64_t outOfOrder = 0;
+	uint64_t maxTakeNanos = 0;
+	uint64_t maxBacklog = 0;
+};
+
+void Produce(int seconds, std::atomic<bool>* done, Result* result) {
+	amm::GestureParameterBridge& bridge = amm::gGestureParameters;
+	while (!bridge.Listening()) {
+		std::this_thread::yield();
+	}
+	auto next = Clock::now();
+	const uint64_t total = (uint64_t) seconds * 1000;
+	for (uint64_t sequence = 0; sequence < total; ++sequence) {
+		next += std::chrono::milliseconds(1);
+		std::this_thread::sleep_until(next);
+		amm::GestureParameter parameter = (amm::GestureParameter) (sequence % amm::kGestureParameters);
+		uint64_t start = amm::GestureClockNanos();
+		// The sequence number rides in the value; floats hold it exactly well past what we send.
+		bool published = bridge.Publish(parameter, (float) sequence, start);
+		uint64_t elapsed = amm::GestureClockNanos() - start;
+		if (!published) {
+			++result->failedPublishes;
+		}
+		if (elapsed > result->maxPublishNanos) {
+			result->maxPublishNanos = elapsed;
+		}
+		++result->updates;
+	}
+	done->store(true, std::memory_order_release);
+}
+
+void Consume(int stallMs, const std::atomic<bool>* done, Result* result) {
+	amm::GestureParameterBridge& bridge = amm::gGestureParameters;
+	int consumer = 0;
+	if (!bridge.Claim(&consumer)) {
+		return;
+	}
+	const auto blockLength = std::chrono::nanoseconds((int64_t) (kFrames * 1e9 / kSampleRate));
+	auto next = Clock::now();
+	uint64_t expected = 0;
+	amm::GestureParameterEvent events[kMaxEvents];
+	for (;;) {
+		bool finished = done->load(std::memory_order_acquire);
+		next += blockLength;
+		std::this_thread::sleep_until(next);
+		if (stallMs > 0 && result->blocks % kStallEvery == kStallEvery - 1) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(stallMs));
+			next = Clock::now();
+		}
+		uint64_t backlog = bridge.Published() - bridge.Taken();
+		if (backlog > result->maxBacklog) {
+			result->maxBacklog = backlog;
+		}
+		uint64_t start = amm::GestureClockNanos();
+		int count = bridge.TakeBlock(start, events, kMaxEvents);
+		uint64_t elapsed = amm::GestureClockNanos() - start;
+		if (elapsed > result->maxTakeNanos) {
+			result->maxTakeNanos = elapsed;
+		}
+		++result->blocks;
+		for (int i = 0; i < count; ++i) {
+			uint64_t sequence = (uint64_t) events[i].value;
+			if (sequence != expected || (int) events[i].parameter != (int) (sequence % amm::kGestureParameters)) {
+				++result->outOfOrder;
+			}
+			expected = sequence + 1;
+			++result->received;
+		}
+		if (count == kMaxEvents) {
+			// The rest of a long backlog only updated the values; pick the count up from there.
+			expected = bridge.Taken();
+			result->received = bridge.Taken();
+		}
+		if (finished && bridge.Taken() == bridge.Published()) {
+			break;
+		}
+	}
+	bridge.Release(&consumer);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int seconds = argc > 1 ? std::atoi(argv[1]) : 10;
+	int stallMs = argc > 2 ? std::atoi(argv[2]) : 50;
+	if (seconds <= 0 || stallMs < 0) {
+		std::fprintf(stderr, "usage: ParameterStress [seconds] [stall-ms]\n");
+		return 2;
+	}
+	Result produced;
+	Result consumed;
+	std::atomic<bool> done{ false };
+	std::thread consumer(Consume, stallMs, &done, &consumed);
+	std::thread producer(Produce, seconds, &done, &produced);
+	producer.join();
+	consumer.join();
+
+	amm::GestureParameterBridge& bridge = amm::gGestureParameters;
+	std::printf("updates     %llu published, %llu taken, %llu dropped, %llu failed publishes\n",
+		(unsigned long long) bridge.Published(), (unsigned long long) bridge.Taken(),
+		(unsigned long long) bridge.Dropped(), (unsigned long long) produced.failedPublishes);
+	std::printf("consumer    %llu blocks, %llu events, %llu out of order, max backlog %llu\n",
+		(unsigned long long) consumed.blocks, (unsigned long long) consumed.received,
+		(unsigned long long) consumed.outOfOrder, (unsigned long long) consumed.maxBacklog);
+	std::printf("worst case  Publish %.1f us, TakeBlock %.1f us\n",
+		produced.maxPublishNanos / 1000.0, consumed.maxTakeNanos / 1000.0);
+
+	bool ok = bridge.Dropped() == 0 && produced.failedPublishes == 0 && bridge.Taken() == produced.updates &&
+		consumed.received == produced.updates && consumed.outOfOrder == 0;
+	std::printf("%s\n", ok ? "PASS" : "FAIL");
+	return ok ? 0 : 1;
+}
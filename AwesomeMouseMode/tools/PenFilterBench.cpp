@@ -0,0 +1,82 @@
+// Benchmark for the pen motion filter (see PenFilter.h) on real pen strokes: replays the pen moves
+// in a recording captured with AMM_RECORD_INPUT through the filter, once per configuration given,
+// and reports the cost per sample and how far the motion handed to Live trails the pen.
+//
+//   PenFilterBench <recording> [deadZone,gain,minCutoff,beta ...]
+//
+// Configurations use the units of the [Pen] settings; without any, the built-in defaults are run.
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src PenFilterBench.cpp ../src/InputReplay.cpp ../src/InputRecording.cpp
+//       ../src/InputTranslator.cpp ../src/KeyRemap.cpp ../src/MotionPredictor.cpp ../src/PanInertia.cpp
+//       ../src/PenFilter.cpp ../src/ScrollEngine.cpp ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp
+//       ../src/ZoomScheduler.cpp
+
+#include "InputReplay.h"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+int Usage() {
+	std::fprintf(stderr, "usage: PenFilterBench <recording> [deadZone,gain,minCutoff,beta ...]\n");
+	return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		return Usage();
+	}
+	std::vector<amm::PenFilter::Config> configs;
+	for (int i = 2; i < argc; ++i) {
+		amm::PenFilter::Config config;
+		if (std::sscanf(argv[i], "%d,%d,%d,%d", &config.deadZone, &config.gainPercent, &config.minCutoffTenthsHz,
+				&config.betaThousandths) != 4) {
+			return Usage();
+		}
+		configs.push_back(config);
+	}
+	if (configs.empty()) {
+		configs.push_back(amm::PenFilter::Config());
+	}
+	std::vector<char> recording;
+	if (!ReadFile(argv[1], &recording)) {
+		std::fprintf(stderr, "Can't read %s\n", argv[1]);
+		return 2;
+	}
+
+	std::printf("%-20s %8s %7s %8s %11s %10s %10s\n", "config", "samples", "strokes", "ns/smp", "mean lag ms",
+		"max lag ms", "mean px");
+	for (const amm::PenFilter::Config& config : configs) {
+		amm::PenFilterBenchmark result;
+		if (!amm::BenchmarkPenFilter(recording.data(), recording.size(), config, &result)) {
+			std::fprintf(stderr, "%s isn't a recording this build understands\n", argv[1]);
+			return 1;
+		}
+		char name[32];
+		std::snprintf(name, sizeof(name), "%d,%d,%d,%d", config.deadZone, config.gainPercent, config.minCutoffTenthsHz,
+			config.betaThousandths);
+		double lagged = result.lagSamples ? (double) result.lagSamples : 1;
+		std::printf("%-20s %8llu %7llu %8.1f %11.2f %10.2f %10.2f\n", name, (unsigned long long) result.samples,
+			(unsigned long long) result.strokes, result.nanosPerSample, result.lagTotalMs / lagged, result.lagMaxMs,
+			result.errorTotalPx / lagged);
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+// Benchmark for drag motion prediction (see MotionPredictor.h) on real drags: replays the
+// left-button drags in a recording captured with AMM_RECORD_INPUT through the predictor at each
+// lead given, and scores every prediction against where the drag really was that much later.
+// Reports the error with and without prediction, and the latency the prediction hid.
+//
+//   PredictionBench <recording> [lead-ms ...]
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src PredictionBench.cpp ../src/InputReplay.cpp ../src/InputRecording.cpp
+//       ../src/InputTranslator.cpp ../src/KeyRemap.cpp ../src/MotionPredictor.cpp ../src/PanInertia.cpp
+//       ../src/PenFilter.cpp ../src/ScrollEngine.cpp ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp
+//       ../src/ZoomScheduler.cpp
+
+#include "InputReplay.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr int kDefaultLeads[] = { 4, 8, 12, 16, 24, 32 };
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: PredictionBench <recording> [lead-ms ...]\n");
+		return 2;
+	}
+	std::vector<int> leads;
+	for (int i = 2; i < argc; ++i) {
+		leads.push_back(std::atoi(argv[i]));
+	}
+	if (leads.empty()) {
+		leads.assign(kDefaultLeads, kDefaultLeads + sizeof(kDefaultLeads) / sizeof(kDefaultLeads[0]));
+	}
+	std::vector<char> recording;
+	if (!ReadFile(argv[1], &recording)) {
+		std::fprintf(stderr, "Can't read %s\n", argv[1]);
+		return 2;
+	}
+
+	std::printf("%7s %8s %12s %11s %14s %13s\n", "lead ms", "samples", "predicted px", "max px", "unpredicted px",
+		"saved ms");
+	for (int lead : leads) {
+		amm::MotionPredictionBenchmark result;
+		if (!amm::BenchmarkMotionPredictor(recording.data(), recording.size(), lead, &result)) {
+			std::fprintf(stderr, "%s isn't a recording this build understands\n", argv[1]);
+			return 1;
+		}
+		double samples = result.samples ? (double) result.samples : 1;
+		std::printf("%7d %8llu %12.2f %11.2f %14.2f %13.2f\n", lead, (unsigned long long) result.samples,
+			result.predictedErrorTotalPx / samples, result.predictedErrorMaxPx, result.unpredictedErrorTotalPx / samples,
+			result.latencySavedTotalMs / samples);
+	}
+	return 0;
+}
@@ -0,0 +1,191 @@
+// Contention benchmark for the window lookup on OurWndProc's path (see WindowRegistry.h): reader
+// threads look hooked windows up as fast as they can while a writer maps and unmaps a window every
+// millisecond, once against the seqlock registry and once against the recursive_mutex and
+// unordered_map it replaced. Reports the cost per lookup at each thread count, and fails if any
+// lookup returned a value that wasn't the window's.
+//
+//   RegistryBench [seconds-per-run] [windows]
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -O2 -pthread -I../src RegistryBench.cpp
+
+#include "WindowRegistry.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const int kThreadCounts[] = { 1, 2, 4, 8 };
+constexpr uintptr_t kFirstWindow = 0x10010;
+constexpr uintptr_t kWindowStride = 0x20;
+// Mapped and unmapped over and over, as Live's popups come and go.
+constexpr uintptr_t kChurnWindow = 0x90010;
+
+using Clock = std::chrono::steady_clock;
+
+// Every window's value is derived from its handle, so readers can tell a wrong one.
+uintptr_t ValueOf(uintptr_t window) {
+	return window * 3 + 1;
+}
+
+// What OurWndProc did before the registry: every lookup under the state lock.
+class MutexMap {
+public:
+	bool Find(uintptr_t key, uintptr_t* value) {
+		std::lock_guard<std::recursive_mutex> guard(lock_);
+		auto found = map_.find(key);
+		if (found == map_.end()) {
+			return false;
+		}
+		*value = found->second;
+		return true;
+	}
+	void Insert(uintptr_t key, uintptr_t value) {
+		std::lock_guard<std::recursive_mutex> guard(lock_);
+		map_[key] = value;
+	}
+	void Erase(uintptr_t key) {
+		std::lock_guard<std::recursive_mutex> guard(lock_);
+		map_.erase(key);
+	}
+
+private:
+	std::recursive_mutex lock_;
+	std::unordered_map<uintptr_t, uintptr_t> map_;
+};
+
+// The registry, with writers serialized as MapWindow and UnmapWindow do.
+class Registry {
+public:
+	bool Find(uintptr_t key, uintptr_t* value) { return registry_.Find(key, value) >= 0; }
+	void Insert(uintptr_t key, uintptr_t value) {
+		std::lock_guard<std::recursive_mutex> guard(lock_);
+		registry_.Insert(key, value);
+	}
+	void Erase(uintptr_t key) {
+		std::lock_guard<std::recursive_mutex> guard(lock_);
+		registry_.Erase(key);
+	}
+
+private:
+	std::recursive_mutex lock_;
+	amm::WindowRegistry registry_;
+};
+
+struct ReaderResult {
+	uint64_t lookups = 0;
+	uint64_t wrong = 0;
+};
+
+template <typename Map>
+void Read(Map* map, int windows, const std::atomic<bool>* start, const std::atomic<bool>* stop, ReaderResult* result) {
+	while (!start->load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+	uint64_t lookups = 0;
+	uint64_t wrong = 0;
+	int next = 0;
+	while (!stop->load(std::memory_order_relaxed)) {
+		// Mostly the main window, as Live's messages are, with the churning one now and then.
+		for (int i = 0; i < 64; ++i) {
+			uintptr_t window = kFirstWindow + kWindowStride * (uintptr_t) (next++ % windows);
+			uintptr_t value = 0;
+			if (!map->Find(window, &value) || value != ValueOf(window)) {
+				++wrong;
+			}
+		}
+		uintptr_t value = 0;
+		if (map->Find(kChurnWindow, &value) && value != ValueOf(kChurnWindow)) {
+			++wrong;
+		}
+		lookups += 65;
+	}
+	result->lookups = lookups;
+	result->wrong = wrong;
+}
+
+template <typename Map>
+void Churn(Map* map, const std::atomic<bool>* start, const std::atomic<bool>* stop) {
+	while (!start->load(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+	auto next = Clock::now();
+	bool mapped = false;
+	while (!stop->load(std::memory_order_relaxed)) {
+		next += std::chrono::milliseconds(1);
+		std::this_thread::sleep_until(next);
+		if (mapped) {
+			map->Erase(kChurnWindow);
+		} else {
+			map->Insert(kChurnWindow, ValueOf(kChurnWindow));
+		}
+		mapped = !mapped;
+	}
+}
+
+// Nanoseconds per lookup, as seen by each reader.
+template <typename Map>
+double Run(int threads, int windows, double seconds, uint64_t* wrong) {
+	Map map;
+	for (int i = 0; i < windows; ++i) {
+		uintptr_t window = kFirstWindow + kWindowStride * (uintptr_t) i;
+		map.Insert(window, ValueOf(window));
+	}
+	std::atomic<bool> start{ false };
+	std::atomic<bool> stop{ false };
+	std::vector<ReaderResult> results(threads);
+	std::vector<std::thread> readers;
+	for (int i = 0; i < threads; ++i) {
+		readers.emplace_back(Read<Map>, &map, windows, &start, &stop, &results[i]);
+	}
+	std::thread writer(Churn<Map>, &map, &start, &stop);
+	start.store(true, std::memory_order_release);
+	auto begin = Clock::now();
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	stop.store(true, std::memory_order_relaxed);
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+	writer.join();
+	double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - begin).count();
+
+	uint64_t lookups = 0;
+	for (const ReaderResult& result : results) {
+		lookups += result.lookups;
+		*wrong += result.wrong;
+	}
+	return lookups > 0 ? elapsed * threads / lookups : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	double seconds = argc > 1 ? std::atof(argv[1]) : 1.0;
+	int windows = argc > 2 ? std::atoi(argv[2]) : 4;
+	// One slot stays free for the churning window.
+	if (seconds <= 0 || windows <= 0 || windows >= amm::WindowRegistry::kCapacity) {
+		std::fprintf(stderr, "usage: RegistryBench [seconds-per-run] [windows, 1 to %d]\n", amm::WindowRegistry::kCapacity - 1);
+		return 2;
+	}
+	std::printf("%d windows, one more mapped and unmapped every ms\n", windows);
+	std::printf("threads  mutex+map ns/lookup  registry ns/lookup  speedup\n");
+	uint64_t wrong = 0;
+	for (int threads : kThreadCounts) {
+		double mutexNanos = Run<MutexMap>(threads, windows, seconds, &wrong);
+		double registryNanos = Run<Registry>(threads, windows, seconds, &wrong);
+		std::printf("%7d  %19.1f  %18.1f  %6.1fx\n", threads, mutexNanos, registryNanos,
+			registryNanos > 0 ? mutexNanos / registryNanos : 0.0);
+	}
+	if (wrong > 0) {
+		std::printf("FAIL: %llu lookups returned the wrong value\n", (unsigned long long) wrong);
+		return 1;
+	}
+	std::printf("PASS\n");
+	return 0;
+}
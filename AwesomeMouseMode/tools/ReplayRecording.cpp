@@ -0,0 +1,104 @@
+// Golden check for the input translator (see InputReplay.h): replays a recording captured with
+// AMM_RECORD_INPUT through fresh translators, set up and reconfigured as the recording says the hook
+// did them, and compares every decision against a golden file, or against the decisions the
+// recording itself holds. Fails if any differ, so a change in behaviour shows up before it reaches
+// Live. Also reports replay throughput and scroll latency.
+//
+//   ReplayRecording <recording> [--golden file] [--write file]
+//
+// --write saves the replayed decisions as a recording, ready to become the next golden file once a
+// behaviour change is intended.
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src ReplayRecording.cpp ../src/InputReplay.cpp ../src/InputRecording.cpp
+//       ../src/InputTranslator.cpp ../src/KeyRemap.cpp ../src/MotionPredictor.cpp ../src/PanInertia.cpp
+//       ../src/PenFilter.cpp ../src/ScrollEngine.cpp ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp
+//       ../src/ZoomScheduler.cpp
+
+#include "InputReplay.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		std::fprintf(stderr, "Can't read %s\n", path);
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+int Usage() {
+	std::fprintf(stderr, "usage: ReplayRecording <recording> [--golden file] [--write file]\n");
+	return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		return Usage();
+	}
+	const char* recordingPath = argv[1];
+	const char* goldenPath = nullptr;
+	const char* writePath = nullptr;
+	for (int i = 2; i < argc; ++i) {
+		if (i + 1 >= argc) {
+			return Usage();
+		}
+		const char* value = argv[++i];
+		if (std::strcmp(argv[i - 1], "--golden") == 0) {
+			goldenPath = value;
+		} else if (std::strcmp(argv[i - 1], "--write") == 0) {
+			writePath = value;
+		} else {
+			return Usage();
+		}
+	}
+
+	std::vector<char> recording;
+	std::vector<char> golden;
+	if (!ReadFile(recordingPath, &recording) || (goldenPath && !ReadFile(goldenPath, &golden))) {
+		return 2;
+	}
+	FILE* out = nullptr;
+	if (writePath && !(out = std::fopen(writePath, "wb"))) {
+		std::fprintf(stderr, "Can't write %s\n", writePath);
+		return 2;
+	}
+	amm::ReplayResult result;
+	bool valid = amm::ReplayRecording(recording.data(), recording.size(), goldenPath ? golden.data() : nullptr,
+		golden.size(), out, &result);
+	if (out) {
+		std::fclose(out);
+	}
+	if (!valid) {
+		std::fprintf(stderr, "%s isn't a recording this build understands\n", goldenPath ? "Recording or golden" : recordingPath);
+		return 2;
+	}
+
+	std::printf("%llu messages in %.3f s (%.2fM messages/s)\n", (unsigned long long) result.messages, result.seconds,
+		result.seconds > 0 ? result.messages / result.seconds / 1e6 : 0.0);
+	if (result.scrollResponses > 0) {
+		std::printf("scroll latency: mean %.1f ms, max %u ms over %llu responses\n",
+			(double) result.scrollLatencyTotalMs / result.scrollResponses, result.scrollLatencyMaxMs,
+			(unsigned long long) result.scrollResponses);
+	}
+	if (result.mismatches > 0) {
+		std::printf("FAIL: %llu decisions differ from %s, first at message %lld\n", (unsigned long long) result.mismatches,
+			goldenPath ? goldenPath : "the recording", (long long) result.firstMismatch);
+		return 1;
+	}
+	std::printf("PASS: every decision matches %s\n", goldenPath ? goldenPath : "the recording");
+	return 0;
+}
@@ -0,0 +1,277 @@
+// Input-to-output latency test for the scroll engine (see ScrollEngine.h): plays wheel gestures
+// through a ScrollAxis ticked at the frame cadence, as the translator drives it, and through the
+// whole-notch accumulator it replaced. For each gesture it reports how long until Live sees any
+// scroll, and until it has seen 90% of it. Fails if the engine takes more than a frame from the
+// input adding up to a granule to respond, or doesn't deliver all of a gesture to within half a
+// granule.
+//
+//   ScrollLatency [recording]
+//
+// Without a recording it plays a fixed set of gestures: a notch, trackpad flicks and crawls, a tiny
+// swipe and a reversal. With one captured with AMM_RECORD_INPUT, it plays the recording's wheel
+// input instead, split into gestures at pauses.
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src ScrollLatency.cpp ../src/InputReplay.cpp ../src/InputRecording.cpp
+//       ../src/InputTranslator.cpp ../src/KeyRemap.cpp ../src/MotionPredictor.cpp ../src/PanInertia.cpp
+//       ../src/PenFilter.cpp ../src/ScrollEngine.cpp ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp
+//       ../src/ZoomScheduler.cpp
+
+#include "InputReplay.h"
+#include "ScrollEngine.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Vertical scale, as the translator applies it.
+constexpr int kScaleNumerator = 4;
+constexpr int kScaleDenominator = 3;
+// A pause this long between wheel messages in a recording starts a new gesture.
+constexpr DWORD kGestureGapMs = 250;
+// How long after its last input a gesture is followed, for the engine to flush it.
+constexpr DWORD kSettleMs = 200;
+
+struct WheelInput {
+	DWORD time;
+	int delta;
+};
+
+struct Gesture {
+	std::string name;
+	std::vector<WheelInput> inputs;
+};
+
+struct Latency {
+	int64_t total = 0;       // Wheel units delivered.
+	int firstMs = -1;        // From the first input to the first scroll, or -1 if none came.
+	int ninetyMs = -1;       // To 90% of the input's scroll, or -1 if it never got there.
+};
+
+// Records outputs as they come, relative to the gesture's start.
+class Delivery {
+public:
+	Delivery(DWORD start, int64_t expected) : start_(start), expected_(expected) {}
+
+	void Output(DWORD time, int delta) {
+		if (delta == 0) {
+			return;
+		}
+		latency_.total += delta;
+		int ms = (int) (time - start_);
+		if (latency_.firstMs < 0) {
+			latency_.firstMs = ms;
+		}
+		if (latency_.ninetyMs < 0 && expected_ != 0 && std::llabs(latency_.total) * 10 >= std::llabs(expected_) * 9) {
+			latency_.ninetyMs = ms;
+		}
+	}
+
+	const Latency& Result() const { return latency_; }
+
+private:
+	DWORD start_;
+	int64_t expected_;
+	Latency latency_;
+};
+
+// Scroll the input amounts to after scaling, in wheel units.
+int64_t ExpectedScroll(const Gesture& gesture) {
+	int64_t fixed = 0;
+	for (const WheelInput& input : gesture.inputs) {
+		fixed += amm::ScrollAxis::Scale(input.delta, kScaleNumerator, kScaleDenominator);
+	}
+	return fixed / amm::ScrollAxis::kOne;
+}
+
+// From the gesture's start until its input first adds up to a granule, or -1 if it never does.
+int GranuleMs(const Gesture& gesture) {
+	int64_t fixed = 0;
+	for (const WheelInput& input : gesture.inputs) {
+		fixed += amm::ScrollAxis::Scale(input.delta, kScaleNumerator, kScaleDenominator);
+		if (std::llabs(fixed) >= (int64_t) amm::kScrollGranule * amm::ScrollAxis::kOne) {
+			return (int) (input.time - gesture.inputs.front().time);
+		}
+	}
+	return -1;
+}
+
+// The engine, with the frame timer running while the axis is active, as the translator runs it.
+Latency PlayEngine(const Gesture& gesture) {
+	amm::ScrollAxis axis;
+	DWORD start = gesture.inputs.front().time;
+	Delivery delivery(start, ExpectedScroll(gesture));
+	DWORD nextTick = 0;
+	bool ticking = false;
+	size_t next = 0;
+	DWORD end = gesture.inputs.back().time + kSettleMs;
+	for (DWORD now = start; now <= end; ++now) {
+		for (; next < gesture.inputs.size() && gesture.inputs[next].time == now; ++next) {
+			int32_t scaled = amm::ScrollAxis::Scale(gesture.inputs[next].delta, kScaleNumerator, kScaleDenominator);
+			delivery.Output(now, axis.Add(scaled, now));
+			if (!ticking && axis.Active()) {
+				ticking = true;
+				nextTick = now + amm::kScrollFrameMs;
+			}
+		}
+		if (ticking && now == nextTick) {
+			delivery.Output(now, axis.Tick(now));
+			ticking = axis.Active();
+			nextTick = now + amm::kScrollFrameMs;
+		}
+	}
+	return delivery.Result();
+}
+
+// What the hook did before the engine: forward only whole notches, as soon as they add up.
+Latency PlayNotches(const Gesture& gesture) {
+	DWORD start = gesture.inputs.front().time;
+	Delivery delivery(start, ExpectedScroll(gesture));
+	int accumulated = 0;
+	for (const WheelInput& input : gesture.inputs) {
+		accumulated += input.delta * kScaleNumerator / kScaleDenominator;
+		int notches = accumulated / WHEEL_DELTA;
+		accumulated -= notches * WHEEL_DELTA;
+		delivery.Output(input.time, notches * WHEEL_DELTA);
+	}
+	return delivery.Result();
+}
+
+Gesture Constant(const char* name, int hz, int delta, int count) {
+	Gesture gesture;
+	gesture.name = name;
+	for (int i = 0; i < count; ++i) {
+		gesture.inputs.push_back({ (DWORD) (1000 + i * 1000 / hz), delta });
+	}
+	return gesture;
+}
+
+// A trackpad flick at 240 Hz: a fast start decaying to nothing.
+Gesture Flick(const char* name, int startDelta, int sign) {
+	Gesture gesture;
+	gesture.name = name;
+	double delta = startDelta;
+	for (int i = 0; delta >= 1; ++i) {
+		gesture.inputs.push_back({ (DWORD) (1000 + i * 1000 / 240), sign * (int) delta });
+		delta *= 0.96;
+	}
+	return gesture;
+}
+
+std::vector<Gesture> BuiltinGestures() {
+	std::vector<Gesture> gestures;
+	gestures.push_back(Constant("notch", 1, WHEEL_DELTA, 1));
+	gestures.push_back(Flick("flick-down", 40, -1));
+	gestures.push_back(Flick("flick-up", 24, 1));
+	gestures.push_back(Constant("crawl", 120, 4, 40));
+	gestures.push_back(Constant("tiny-swipe", 240, 6, 6));
+	Gesture reversal = Constant("reversal", 240, 10, 20);
+	for (int i = 0; i < 20; ++i) {
+		reversal.inputs.push_back({ reversal.inputs.back().time + 4, -10 });
+	}
+	gestures.push_back(reversal);
+	return gestures;
+}
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+// The recording's vertical scrolling, one gesture per burst. Ctrl+wheel is zoom, not scroll.
+bool RecordedGestures(const char* path, std::vector<Gesture>* gestures) {
+	std::vector<char> data;
+	amm::Recording recording;
+	if (!ReadFile(path, &data) || !amm::ReadRecording(data.data(), data.size(), &recording)) {
+		return false;
+	}
+	DWORD lastTime = 0;
+	for (const amm::Recording::Message& message : recording.messages) {
+		const amm::RecordedMessage& record = message.record;
+		if (record.msg != WM_MOUSEWHEEL || LOWORD(record.wParam) == MK_CONTROL) {
+			continue;
+		}
+		if (gestures->empty() || record.time - lastTime >= kGestureGapMs) {
+			gestures->emplace_back();
+			gestures->back().name = "recorded-" + std::to_string(gestures->size());
+		}
+		gestures->back().inputs.push_back({ record.time, GET_WHEEL_DELTA_WPARAM(record.wParam) });
+		lastTime = record.time;
+	}
+	return true;
+}
+
+void PrintMs(int ms) {
+	if (ms < 0) {
+		std::printf(" %7s", "-");
+	} else {
+		std::printf(" %7d", ms);
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 2) {
+		std::fprintf(stderr, "usage: ScrollLatency [recording]\n");
+		return 2;
+	}
+	std::vector<Gesture> gestures;
+	if (argc == 2) {
+		if (!RecordedGestures(argv[1], &gestures)) {
+			std::fprintf(stderr, "%s isn't a recording this build understands\n", argv[1]);
+			return 2;
+		}
+	} else {
+		gestures = BuiltinGestures();
+	}
+
+	std::printf("%-14s %6s %7s | %26s | %26s\n", "", "", "", "engine", "whole notches");
+	std::printf("%-14s %6s %7s | %7s %7s %10s | %7s %7s %10s\n", "gesture", "inputs", "scroll",
+		"first", "90%", "delivered", "first", "90%", "delivered");
+	int failures = 0;
+	for (const Gesture& gesture : gestures) {
+		int64_t expected = ExpectedScroll(gesture);
+		Latency engine = PlayEngine(gesture);
+		Latency notches = PlayNotches(gesture);
+		std::printf("%-14s %6zu %7lld |", gesture.name.c_str(), gesture.inputs.size(), (long long) expected);
+		PrintMs(engine.firstMs);
+		PrintMs(engine.ninetyMs);
+		std::printf(" %10lld |", (long long) engine.total);
+		PrintMs(notches.firstMs);
+		PrintMs(notches.ninetyMs);
+		std::printf(" %10lld\n", (long long) notches.total);
+
+		// A reversal drops what was still owed the old way, by design.
+		bool reverses = false;
+		for (const WheelInput& input : gesture.inputs) {
+			reverses |= (input.delta < 0) != (gesture.inputs.front().delta < 0);
+		}
+		int granuleMs = GranuleMs(gesture);
+		bool slow = granuleMs >= 0 && (engine.firstMs < 0 || engine.firstMs > granuleMs + (int) amm::kScrollFrameMs);
+		bool lost = !reverses && std::llabs(engine.total - expected) > amm::kScrollGranule / 2;
+		if (slow || lost) {
+			std::printf("FAIL %s:%s%s\n", gesture.name.c_str(), slow ? " first scroll too late" : "",
+				lost ? " scroll lost" : "");
+			++failures;
+		}
+	}
+	if (failures > 0) {
+		std::printf("FAIL: %d of %zu gestures\n", failures, gestures.size());
+		return 1;
+	}
+	std::printf("PASS\n");
+	return 0;
+}
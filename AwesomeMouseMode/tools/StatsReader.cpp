@@ -0,0 +1,198 @@
+// Standalone viewer for the hook's live statistics (see LiveStats.h). Reads the shared block while
+// Live runs, without stopping it, and prints per-second rates.
+//
+//   StatsReader <pid> [interval-ms]          Windows: attach to a running Live.
+//   StatsReader <file> [interval-ms]         A file-backed block, e.g. a stand-in on Linux.
+//   StatsReader --once <pid|file>            Print totals once and exit.
+//   StatsReader --write-sample <file>        Write a stand-in block with made-up counters.
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -I../src StatsReader.cpp ../src/LiveStats.cpp
+
+#include "LiveStats.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// A read-only view of a stats block, from a process's mapping or from a file.
+class StatsView {
+public:
+	~StatsView() {
+#if defined(_WIN32)
+		if (view_) {
+			::UnmapViewOfFile(view_);
+		}
+		if (mapping_) {
+			::CloseHandle(mapping_);
+		}
+#else
+		if (view_) {
+			::munmap(view_, size_);
+		}
+#endif
+	}
+
+	bool Open(const char* target) {
+#if defined(_WIN32)
+		char* end = nullptr;
+		unsigned long pid = ::strtoul(target, &end, 10);
+		if (end && *end == '\0' && pid != 0) {
+			wchar_t name[64];
+			swprintf_s(name, AMM_STATS_MAPPING_NAME, pid);
+			mapping_ = ::OpenFileMappingW(FILE_MAP_READ, FALSE, name);
+		} else {
+			HANDLE file = ::CreateFileA(target, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+			if (file != INVALID_HANDLE_VALUE) {
+				mapping_ = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				::CloseHandle(file);
+			}
+		}
+		if (!mapping_) {
+			return false;
+		}
+		view_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, sizeof(amm::StatsBlock));
+		size_ = sizeof(amm::StatsBlock);
+#else
+		int fd = ::open(target, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (::fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(amm::StatsBlock)) {
+			size_ = sizeof(amm::StatsBlock);
+			view_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+			if (view_ == MAP_FAILED) {
+				view_ = nullptr;
+			}
+		}
+		::close(fd);
+#endif
+		return view_ != nullptr;
+	}
+
+	const amm::StatsBlock* Block() const { return amm::ValidateStatsBlock(view_, size_); }
+
+private:
+#if defined(_WIN32)
+	HANDLE mapping_ = nullptr;
+#endif
+	void* view_ = nullptr;
+	size_t size_ = 0;
+};
+
+// Fills a block with plausible counters, so the reader can be exercised without Live.
+bool WriteSample(const char* path) {
+	std::vector<char> memory(sizeof(amm::StatsBlock) + 64);
+	void* aligned = memory.data() + (64 - (reinterpret_cast<uintptr_t>(memory.data()) & 63)) % 64;
+	amm::StatsBlock* block = amm::InitStatsBlock(aligned, 1234, 10000000);
+	for (uint32_t t = 0; t < 2; ++t) {
+		amm::StatsThread* thread = block->ForThread(100 + t);
+		for (int i = 0; i < amm::kStatsMessageKinds; ++i) {
+			thread->messages[i].store((uint64_t) (1000 >> i) * (t + 1), std::memory_order_relaxed);
+		}
+		for (int i = 0; i < 1000; ++i) {
+			uint64_t hook = 800 + (uint64_t) i * 3;
+			uint64_t live = 20000 + (uint64_t) i * 40;
+			thread->hookNanos.fetch_add(hook, std::memory_order_relaxed);
+			thread->hookLatency.Record(hook);
+			thread->forwardNanos.fetch_add(live, std::memory_order_relaxed);
+			thread->forwardLatency.Record(live);
+		}
+		thread->sendInputCalls.store(40, std::memory_order_relaxed);
+		thread->sendInputEvents.store(160, std::memory_order_relaxed);
+		thread->movesDropped.store(12, std::memory_order_relaxed);
+		thread->keysCoalesced.store(6, std::memory_order_relaxed);
+		thread->panGestures.store(3, std::memory_order_relaxed);
+		thread->touchGestures.store(2, std::memory_order_relaxed);
+	}
+	block->windowsMapped.store(5, std::memory_order_relaxed);
+	block->windowsSkipped.store(9, std::memory_order_relaxed);
+	block->coverageMicros.store(850, std::memory_order_relaxed);
+	block->windowEvents.store(42, std::memory_order_relaxed);
+
+	FILE* out = ::fopen(path, "wb");
+	if (!out) {
+		return false;
+	}
+	bool ok = ::fwrite(aligned, sizeof(amm::StatsBlock), 1, out) == 1;
+	return ::fclose(out) == 0 && ok;
+}
+
+int Usage() {
+	::fprintf(stderr, "usage: StatsReader [--once] <pid|file> [interval-ms]\n       StatsReader --write-sample <file>\n");
+	return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int arg = 1;
+	bool once = false;
+	if (arg < argc && ::strcmp(argv[arg], "--write-sample") == 0) {
+		if (arg + 1 >= argc) {
+			return Usage();
+		}
+		if (!WriteSample(argv[arg + 1])) {
+			::fprintf(stderr, "couldn't write %s\n", argv[arg + 1]);
+			return 1;
+		}
+		return 0;
+	}
+	if (arg < argc && ::strcmp(argv[arg], "--once") == 0) {
+		once = true;
+		++arg;
+	}
+	if (arg >= argc) {
+		return Usage();
+	}
+	const char* target = argv[arg++];
+	int intervalMs = arg < argc ? ::atoi(argv[arg]) : 1000;
+	if (intervalMs <= 0) {
+		intervalMs = 1000;
+	}
+
+	StatsView view;
+	if (!view.Open(target)) {
+		::fprintf(stderr, "couldn't open statistics for %s\n", target);
+		return 1;
+	}
+	const amm::StatsBlock* block = view.Block();
+	if (!block) {
+		::fprintf(stderr, "%s isn't a version %u statistics block\n", target, (unsigned) amm::StatsBlock::kVersion);
+		return 1;
+	}
+
+	amm::StatsSnapshot before;
+	amm::TakeStatsSnapshot(*block, &before);
+	if (once) {
+		amm::PrintStatsSnapshot(before, nullptr, 0, stdout);
+		return 0;
+	}
+	auto beforeTime = std::chrono::steady_clock::now();
+	for (;;) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+		amm::StatsSnapshot now;
+		amm::TakeStatsSnapshot(*block, &now);
+		auto nowTime = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(nowTime - beforeTime).count();
+		::printf("--- process %u\n", block->processId);
+		amm::PrintStatsSnapshot(now, &before, seconds, stdout);
+		::fflush(stdout);
+		before = now;
+		beforeTime = nowTime;
+	}
+}
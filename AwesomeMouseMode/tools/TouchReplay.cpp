@@ -0,0 +1,113 @@
+// Replays a contact stream captured with AMM_RECORD_TOUCH (see TouchRecognizer.h) through a fresh
+// recognizer, and reports what it made of it: pans begun, zoom steps, and how long recognition took
+// from two contacts being down, in frame time. With --events, every recognized event is listed.
+//
+//   TouchReplay [--events] <stream>
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -O2 -I../src TouchReplay.cpp ../src/TouchRecognizer.cpp
+
+#include "TouchRecognizer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+struct TouchReplayResult {
+	uint64_t frames = 0;
+	uint64_t pans = 0;
+	uint64_t zoomSteps = 0;
+	// From two contacts being down to the pan or pinch being recognized, in frame time.
+	uint32_t recognitionTotalMs = 0;
+	uint32_t recognitionMaxMs = 0;
+	uint32_t recognitions = 0;
+};
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+// If out is set, every recognized event is written there. Returns false if the stream is malformed.
+bool ReplayTouchStream(const std::vector<char>& data, FILE* out, TouchReplayResult* result) {
+	amm::TouchStreamHeader header;
+	if (data.size() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != amm::TouchStreamHeader::kMagic || header.version != amm::TouchStreamHeader::kVersion ||
+			header.frameSize != sizeof(amm::TouchFrame)) {
+		return false;
+	}
+	size_t count = (data.size() - sizeof(header)) / sizeof(amm::TouchFrame);
+	const char* bytes = data.data() + sizeof(header);
+
+	amm::TouchRecognizer recognizer;
+	for (size_t i = 0; i < count; ++i) {
+		amm::TouchFrame frame;
+		std::memcpy(&frame, bytes + i * sizeof(amm::TouchFrame), sizeof(frame));
+		amm::TouchGesture gesture = recognizer.Process(&frame, 1);
+		++result->frames;
+		if (gesture.panFlags & GF_BEGIN) {
+			++result->pans;
+		}
+		result->zoomSteps += std::abs(gesture.zoomSteps);
+		if (gesture.recognitionMs >= 0) {
+			++result->recognitions;
+			result->recognitionTotalMs += gesture.recognitionMs;
+			if ((uint32_t) gesture.recognitionMs > result->recognitionMaxMs) {
+				result->recognitionMaxMs = gesture.recognitionMs;
+			}
+		}
+		if (out && (gesture.panFlags || gesture.zoomSteps || gesture.recognitionMs >= 0)) {
+			std::fprintf(out, "%10u ms  contacts %d  pan 0x%x [%d, %d]  zoom %+d  recognized %d ms\n", frame.time,
+				recognizer.ActiveCount(), (unsigned) gesture.panFlags, (int) gesture.panLocation.x,
+				(int) gesture.panLocation.y, gesture.zoomSteps, gesture.recognitionMs);
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int arg = 1;
+	bool events = false;
+	if (arg < argc && std::strcmp(argv[arg], "--events") == 0) {
+		events = true;
+		++arg;
+	}
+	if (arg + 1 != argc) {
+		std::fprintf(stderr, "usage: TouchReplay [--events] <stream>\n");
+		return 2;
+	}
+	std::vector<char> data;
+	if (!ReadFile(argv[arg], &data)) {
+		std::fprintf(stderr, "Can't read %s\n", argv[arg]);
+		return 2;
+	}
+	TouchReplayResult result;
+	if (!ReplayTouchStream(data, events ? stdout : nullptr, &result)) {
+		std::fprintf(stderr, "%s isn't a contact stream this build understands\n", argv[arg]);
+		return 1;
+	}
+	std::printf("%llu frames: %llu pans, %llu zoom steps", (unsigned long long) result.frames,
+		(unsigned long long) result.pans, (unsigned long long) result.zoomSteps);
+	if (result.recognitions > 0) {
+		std::printf(", recognized in %.1f ms on average, %u ms at worst", (double) result.recognitionTotalMs / result.recognitions,
+			result.recognitionMaxMs);
+	}
+	std::printf("\n");
+	return 0;
+}
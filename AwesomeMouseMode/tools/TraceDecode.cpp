@@ -0,0 +1,122 @@
+// Offline decoder for the hook's trace dumps (see TraceRecorder.h): turns the file AMM_TRACE_DUMP
+// pointed at into readable text, one record per line with times relative to the first, or CSV.
+//
+//   TraceDecode [--csv] <dump> [output]
+//
+// Build alongside the DLL sources, e.g.: g++ -std=c++14 -O2 -I../src TraceDecode.cpp
+
+#include "TraceRecorder.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const char* const kTraceEventNames[] = {
+#define AMM_TRACE_NAME(name, format) #name,
+	AMM_TRACE_EVENTS(AMM_TRACE_NAME)
+#undef AMM_TRACE_NAME
+};
+
+const char* const kTraceEventFormats[] = {
+#define AMM_TRACE_FORMAT(name, format) format,
+	AMM_TRACE_EVENTS(AMM_TRACE_FORMAT)
+#undef AMM_TRACE_FORMAT
+};
+
+bool ReadFile(const char* path, std::vector<char>* data) {
+	FILE* file = std::fopen(path, "rb");
+	if (!file) {
+		return false;
+	}
+	char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data->insert(data->end(), buffer, buffer + read);
+	}
+	std::fclose(file);
+	return true;
+}
+
+// Returns false if the dump is malformed.
+bool Decode(const std::vector<char>& data, bool csv, FILE* out) {
+	amm::TraceDumpHeader header;
+	if (data.size() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.magic != amm::TraceDumpHeader::kMagic || header.version != amm::TraceDumpHeader::kVersion ||
+			header.recordSize != sizeof(amm::TraceDumpRecord) ||
+			(data.size() - sizeof(header)) / sizeof(amm::TraceDumpRecord) < header.recordCount) {
+		return false;
+	}
+
+	const char* bytes = data.data() + sizeof(header);
+	double microsPerTick = header.ticksPerSecond > 0 ? 1e6 / header.ticksPerSecond : 0;
+	uint64_t baseTicks = 0;
+	if (csv) {
+		std::fprintf(out, "sequence,time_us,event,a0,a1,a2,a3\n");
+	} else {
+		std::fprintf(out, "# %u records, %u dropped, %.0f ticks/s\n", header.recordCount, header.droppedCount, header.ticksPerSecond);
+	}
+	for (uint32_t i = 0; i < header.recordCount; ++i) {
+		amm::TraceDumpRecord record;
+		std::memcpy(&record, bytes + i * sizeof(amm::TraceDumpRecord), sizeof(record));
+		if (i == 0) {
+			baseTicks = record.timestamp;
+		}
+		double micros = (double) (int64_t) (record.timestamp - baseTicks) * microsPerTick;
+		bool known = record.event < (uint16_t) amm::TraceEvent::kCount;
+		const char* name = known ? kTraceEventNames[record.event] : "kUnknown";
+		if (csv) {
+			std::fprintf(out, "%u,%.3f,%s,%d,%d,%d,%d\n", record.sequence, micros, name + 1,
+				record.args[0], record.args[1], record.args[2], record.args[3]);
+			continue;
+		}
+		char text[256];
+		if (known) {
+			std::snprintf(text, sizeof(text), kTraceEventFormats[record.event],
+				record.args[0], record.args[1], record.args[2], record.args[3]);
+		} else {
+			std::snprintf(text, sizeof(text), "event %u: %d %d %d %d", record.event,
+				record.args[0], record.args[1], record.args[2], record.args[3]);
+		}
+		std::fprintf(out, "%12.3f us  %-18s %s\n", micros, name + 1, text);
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int arg = 1;
+	bool csv = false;
+	if (arg < argc && std::strcmp(argv[arg], "--csv") == 0) {
+		csv = true;
+		++arg;
+	}
+	if (arg >= argc || argc - arg > 2) {
+		std::fprintf(stderr, "usage: TraceDecode [--csv] <dump> [output]\n");
+		return 2;
+	}
+	std::vector<char> data;
+	if (!ReadFile(argv[arg], &data)) {
+		std::fprintf(stderr, "Can't read %s\n", argv[arg]);
+		return 2;
+	}
+	FILE* out = stdout;
+	if (arg + 1 < argc && !(out = std::fopen(argv[arg + 1], "w"))) {
+		std::fprintf(stderr, "Can't write %s\n", argv[arg + 1]);
+		return 2;
+	}
+	bool ok = Decode(data, csv, out);
+	if (out != stdout) {
+		std::fclose(out);
+	}
+	if (!ok) {
+		std::fprintf(stderr, "%s isn't a trace dump this decoder understands\n", argv[arg]);
+		return 1;
+	}
+	return 0;
+}
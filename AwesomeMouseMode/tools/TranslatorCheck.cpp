@@ -0,0 +1,292 @@
+// Scenario checks for the input translator (see InputTranslator.h), runnable anywhere the neutral
+// sources build: short scripted message sequences, each with the actions the hook must take for it.
+// Covers pass-through with every feature off, the key remaps, whole-notch and smooth scrolling,
+// horizontal scrolling, trackpad zoom and the touch pan gesture. ReplayRecording covers whole
+// sessions; this pins down the behaviour they rely on.
+//
+//   TranslatorCheck [--verbose]
+//
+// Build alongside the DLL sources, e.g.:
+//   g++ -std=c++14 -O2 -I../src TranslatorCheck.cpp ../src/InputTranslator.cpp ../src/KeyRemap.cpp
+//       ../src/MotionPredictor.cpp ../src/PanInertia.cpp ../src/PenFilter.cpp ../src/ScrollEngine.cpp
+//       ../src/TouchRecognizer.cpp ../src/TraceRecorder.cpp ../src/ZoomScheduler.cpp
+
+#include "InputTranslator.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+bool gVerbose = false;
+int gFailures = 0;
+
+// One translator fed a scripted sequence, checking what it does with each message.
+class Scenario {
+public:
+	Scenario(const char* name, uint32_t features) : name_(name) {
+		translator_.SetFeatures(features);
+	}
+
+	~Scenario() {
+		if (!failed_) {
+			std::printf("PASS %s\n", name_);
+		}
+	}
+
+	// Everything the hook would have fetched is already present; the cursor is showing, no keys
+	// are held, and Live isn't taking text unless a step says so.
+	static amm::InputMessage Message(UINT msg, WPARAM wParam, LPARAM lParam) {
+		amm::InputMessage in;
+		std::memset(&in, 0, sizeof(in));
+		in.msg = msg;
+		in.wParam = wParam;
+		in.lParam = lParam;
+		in.present = amm::kInputAll;
+		in.cursorShown = true;
+		return in;
+	}
+
+	const amm::TranslatedInput& Send(amm::InputMessage in) {
+		in.time = time_;
+		out_ = amm::TranslatedInput();
+		translator_.Translate(in, &out_);
+		if (gVerbose) {
+			std::printf("  %s: msg %#x at %u ms:", name_, in.msg, in.time);
+			for (int i = 0; i < out_.actionCount; ++i) {
+				const amm::OutputAction& action = out_.actions[i];
+				std::printf(" [%d %#x %lld %lld%s]", (int) action.type, action.msg, (long long) action.wParam,
+					(long long) action.lParam, action.isResult ? " result" : "");
+			}
+			std::printf("\n");
+		}
+		return out_;
+	}
+	const amm::TranslatedInput& Send(UINT msg, WPARAM wParam, LPARAM lParam) {
+		return Send(Message(msg, wParam, lParam));
+	}
+
+	void Advance(DWORD ms) { time_ += ms; }
+
+	void Expect(bool condition, const char* what) {
+		if (!condition) {
+			std::printf("FAIL %s at %u ms: %s\n", name_, time_, what);
+			failed_ = true;
+			++gFailures;
+		}
+	}
+
+	// The action forwarded as OurWndProc's result, or nullptr if the message was consumed.
+	const amm::OutputAction* Result() const {
+		for (int i = 0; i < out_.actionCount; ++i) {
+			if (out_.actions[i].type == amm::ActionType::kForward && out_.actions[i].isResult) {
+				return &out_.actions[i];
+			}
+		}
+		return nullptr;
+	}
+
+	int Count(amm::ActionType type) const {
+		int count = 0;
+		for (int i = 0; i < out_.actionCount; ++i) {
+			count += out_.actions[i].type == type;
+		}
+		return count;
+	}
+
+	int Forwarded(UINT msg) const {
+		int count = 0;
+		for (int i = 0; i < out_.actionCount; ++i) {
+			count += out_.actions[i].type == amm::ActionType::kForward && out_.actions[i].msg == msg;
+		}
+		return count;
+	}
+
+	// Whether the batched keys are exactly these, in order.
+	bool Keys(const amm::SyntheticKey* keys, int count) const {
+		if (out_.keyCount != count) {
+			return false;
+		}
+		for (int i = 0; i < count; ++i) {
+			if (out_.keys[i].vk != keys[i].vk || out_.keys[i].keyUp != keys[i].keyUp) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Wheel delta of the forwarded wheel messages, results or not.
+	int WheelForwarded() const {
+		int total = 0;
+		for (int i = 0; i < out_.actionCount; ++i) {
+			const amm::OutputAction& action = out_.actions[i];
+			if (action.type == amm::ActionType::kForward && action.msg == WM_MOUSEWHEEL) {
+				total += GET_WHEEL_DELTA_WPARAM(action.wParam);
+			}
+		}
+		return total;
+	}
+
+private:
+	const char* name_;
+	amm::InputTranslator translator_;
+	amm::TranslatedInput out_;
+	DWORD time_ = 1000;
+	bool failed_ = false;
+};
+
+WPARAM Wheel(int delta, WORD keys = 0) {
+	return MAKEWPARAM(keys, (short) delta);
+}
+
+void CheckPassThrough() {
+	Scenario s("pass-through", 0);
+	LPARAM point = MAKELPARAM(120, 80);
+	s.Send(WM_MOUSEMOVE, 0, point);
+	s.Expect(s.Result() && s.Result()->lParam == point, "a move is forwarded as is");
+	s.Expect(s.Result() && s.Result()->coalescable, "a plain move may be coalesced");
+	s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+	s.Expect(s.Result() && s.Result()->wParam == Wheel(30), "a wheel message is forwarded as is");
+	amm::InputMessage key = Scenario::Message(WM_KEYDOWN, 'Z', 0);
+	key.keyState = amm::kKeyStateControl | amm::kKeyStateShift;
+	s.Send(key);
+	s.Expect(s.Result() && s.Count(amm::ActionType::kSendInput) == 0, "Ctrl+Shift+Z is left alone");
+	s.Send(WM_CHAR, '=', 0);
+	s.Expect(s.Result() && s.Result()->wParam == '=', "'=' is left alone");
+}
+
+void CheckCtrlShiftZ() {
+	Scenario s("ctrl-shift-z", amm::kFeatureCtrlShiftZ);
+	amm::InputMessage key = Scenario::Message(WM_KEYDOWN, 'Z', 0);
+	key.keyState = amm::kKeyStateControl | amm::kKeyStateShift;
+	const amm::TranslatedInput& out = s.Send(key);
+	const amm::SyntheticKey redo[] = { { VK_SHIFT, true }, { 'Y', false }, { 'Y', true }, { VK_SHIFT, false } };
+	s.Expect(s.Count(amm::ActionType::kSendInput) == 1 && s.Keys(redo, 4), "Ctrl+Shift+Z sends Ctrl+Y, in one batch");
+	s.Expect(s.Result() == &out.actions[out.actionCount - 1], "and is still forwarded after it");
+	key.keyState = amm::kKeyStateControl;
+	s.Send(key);
+	s.Expect(s.Result() && s.Count(amm::ActionType::kSendInput) == 0, "Ctrl+Z is left alone");
+}
+
+void CheckPlusWithoutShift() {
+	Scenario s("plus-without-shift", amm::kFeaturePlusKeyWithoutShift);
+	s.Send(WM_CHAR, '=', 0);
+	s.Expect(s.Result() && s.Result()->wParam == '+', "'=' zooms in");
+	amm::InputMessage typing = Scenario::Message(WM_CHAR, '=', 0);
+	typing.textEntry = true;
+	s.Send(typing);
+	s.Expect(s.Result() && s.Result()->wParam == '=', "'=' is typed as is into a text field");
+}
+
+void CheckWholeNotches() {
+	Scenario s("whole-notches", amm::kFeatureScrollingOverride);
+	LPARAM point = MAKELPARAM(300, 200);
+	// Scaled by 4/3, three 30s make a notch.
+	s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+	s.Expect(!s.Result(), "a part notch is held back");
+	s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+	s.Expect(!s.Result(), "two part notches are held back");
+	s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+	s.Expect(s.Result() && s.Result()->wParam == Wheel(120), "a whole notch is forwarded");
+	s.Send(WM_MOUSEWHEEL, Wheel(-90, MK_SHIFT), point);
+	s.Expect(s.Result() && s.Result()->wParam == Wheel(-120, MK_SHIFT), "a notch back is forwarded with its keys");
+}
+
+void CheckSmoothScrolling() {
+	Scenario s("smooth-scrolling", amm::kFeatureScrollingOverride | amm::kFeatureSmoothScrolling);
+	LPARAM point = MAKELPARAM(300, 200);
+	s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+	s.Expect(s.WheelForwarded() == amm::kScrollGranule, "a gesture's first granule is forwarded at once");
+	s.Expect(s.Count(amm::ActionType::kSetTimer) == 1, "the frame timer starts");
+	int total = s.WheelForwarded();
+	for (int i = 0; i < 10; ++i) {
+		s.Advance(4);
+		s.Send(WM_MOUSEWHEEL, Wheel(30), point);
+		total += s.WheelForwarded();
+		s.Expect(s.Count(amm::ActionType::kSetTimer) == 0, "the frame timer is only started once");
+	}
+	bool stopped = false;
+	for (int frame = 0; frame < 20 && !stopped; ++frame) {
+		s.Advance(amm::kScrollFrameMs);
+		s.Send(WM_TIMER, amm::kScrollFrameTimerId, 0);
+		s.Expect(!s.Result(), "our frame timer doesn't reach Live");
+		total += s.WheelForwarded();
+		stopped = s.Count(amm::ActionType::kKillTimer) == 1;
+	}
+	s.Expect(stopped, "the frame timer stops once the gesture goes quiet");
+	// 11 inputs of 30, scaled by 4/3, is 440: rounded to the nearest granule.
+	s.Expect(total == 450, "all of the gesture is delivered");
+}
+
+void CheckHorizontal() {
+	Scenario s("horizontal", amm::kFeatureScrollingOverride);
+	s.Send(WM_MOUSEHWHEEL, Wheel(60), MAKELPARAM(300, 200));
+	const amm::SyntheticKey ctrl[] = { { VK_CONTROL, false }, { VK_CONTROL, true } };
+	s.Expect(s.Result() && s.Result()->msg == WM_MOUSEWHEEL && s.Result()->wParam == Wheel(-120, MK_CONTROL),
+		"a horizontal notch becomes a reversed Ctrl+wheel");
+	s.Expect(s.Result() && s.Result()->trackpadScroll, "which isn't taken for a zoom");
+	s.Expect(s.Keys(ctrl, 2), "with Ctrl held around it");
+}
+
+void CheckTrackpadZoom() {
+	Scenario s("trackpad-zoom", amm::kFeatureTrackpadZoom);
+	s.Send(WM_MOUSEWHEEL, Wheel(120, MK_CONTROL), MAKELPARAM(300, 200));
+	s.Expect(!s.Result(), "a pinch doesn't reach Live as a wheel");
+	s.Expect(s.Count(amm::ActionType::kSendInput) == 1 && s.Count(amm::ActionType::kSetTimer) == 1,
+		"its first zoom step goes out at once, and the zoom frame timer starts");
+	amm::InputMessage scrolling = Scenario::Message(WM_MOUSEWHEEL, Wheel(120, MK_CONTROL), MAKELPARAM(300, 200));
+	scrolling.inTrackpadScroll = true;
+	s.Send(scrolling);
+	s.Expect(s.Result() != nullptr, "our own horizontal scroll isn't taken for a pinch");
+}
+
+void CheckPanGesture() {
+	Scenario s("pan-gesture", amm::kFeatureTouchPanGesture);
+	amm::InputMessage gesture = Scenario::Message(WM_GESTURE, 0, 0x1234);
+	gesture.hasGesture = true;
+	gesture.gestureId = GID_PAN;
+	gesture.gestureFlags = GF_BEGIN;
+	gesture.gestureLocation = { 200, 150 };
+	s.Send(gesture);
+	const amm::SyntheticKey held[] = { { VK_CONTROL, false }, { VK_MENU, false }, { VK_CONTROL, true }, { VK_MENU, true } };
+	s.Expect(!s.Result(), "the gesture itself is consumed");
+	s.Expect(s.Keys(held, 4) && s.Count(amm::ActionType::kSetCursorPosClient) == 1,
+		"a pan starts with a Ctrl+Alt click where it began");
+	s.Expect(s.Count(amm::ActionType::kCloseGestureInfo) == 1, "the gesture info is closed");
+
+	s.Advance(8);
+	gesture.gestureFlags = 0;
+	gesture.gestureLocation = { 230, 170 };
+	s.Send(gesture);
+	s.Expect(s.Forwarded(WM_MOUSEMOVE) == 1, "a pan moves the click along");
+
+	s.Advance(8);
+	gesture.gestureFlags = GF_END;
+	s.Send(gesture);
+	s.Expect(s.Forwarded(WM_LBUTTONUP) == 1, "the click is released as the pan ends");
+	s.Expect(s.Count(amm::ActionType::kSetCursorPos) == 1, "the cursor goes back where the user left it");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc > 2 || (argc == 2 && std::strcmp(argv[1], "--verbose") != 0)) {
+		std::fprintf(stderr, "usage: TranslatorCheck [--verbose]\n");
+		return 2;
+	}
+	gVerbose = argc == 2;
+	CheckPassThrough();
+	CheckCtrlShiftZ();
+	CheckPlusWithoutShift();
+	CheckWholeNotches();
+	CheckSmoothScrolling();
+	CheckHorizontal();
+	CheckTrackpadZoom();
+	CheckPanGesture();
+	if (gFailures > 0) {
+		std::printf("FAIL: %d checks\n", gFailures);
+		return 1;
+	}
+	std::printf("PASS\n");
+	return 0;
+}